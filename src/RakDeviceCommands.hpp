@@ -11,9 +11,11 @@
 static constexpr char CMD_VER [] = "+VER", CMD_HWM [] = "+HWMODEL", CMD_SNO [] = "+SN", CMD_API [] = "+APIVER", CMD_TIM [] = "+LTIME", CMD_HID [] = "+HWID";
 
 static constexpr char CMD_SLEEP [] = "+SLEEP", CMD_RESET [] = "+RESET", CMD_LOWPOW [] = "+LPM", CMD_DEBUG [] = "+DEBUG";
+static constexpr char CMD_BAUD [] = "+BAUD";
 
+static constexpr char CMD_PGSLOT [] = "+PGSLOT";
 static constexpr char CMD_BAND [] = "+BAND", CMD_CLASS [] = "+CLASS", CMD_DR [] = "+DR", CMD_TXP [] = "+TXP", CMD_ADR [] = "+ADR", CMD_DCS [] = "+DCS", CMD_PNM [] = "+PNM";
-static constexpr char CMD_CFM [] = "+CFM", CMD_RETY [] = "+RETY";
+static constexpr char CMD_CFM [] = "+CFM", CMD_RETY [] = "+RETY", CMD_MASK [] = "+MASK";
 
 static constexpr char CMD_DEV_EUI [] = "+DEVEUI", CMD_APP_EUI [] = "+APPEUI", CMD_APP_KEY [] = "+APPKEY", CMD_DEV_ADDR [] = "+DEVADDR";
 static constexpr char CMD_NWM [] = "+NWM", CMD_NJM [] = "+NJM", CMD_NJS [] = "+NJS";
@@ -31,11 +33,14 @@ static constexpr char CMD_SEND_STATUS [] = "+CFS";
 static constexpr char CMD_SEND [] = "+SEND", CMD_RECV [] = "+RECV";
 static constexpr char CMD_TIMEREQUEST [] = "+TIMEREQ";
 
+static constexpr char CMD_P2P [] = "+P2P", CMD_PSEND [] = "+PSEND", CMD_PRECV [] = "+PRECV";
+
 // -----------------------------------------------------------------------------------------------
 
 static constexpr char ERR_BAND [] = "0 = EU433, 1 = CN470, 2 = RU864, 3 = IN865, 4 = EU868, 5 = US915, 6 = AU915, 7 = KR920, 8 = AS923-1, 9 = AS923-2, 10 = AS923-3, 11 = AS923-4, 12 = LA915";
-static constexpr char ERR_CLASS [] = "A = Class A, B = Class B, C = Class B";
-static constexpr char ERR_DR [] = "EU868: 0 = SF12, 1 = SF11, 2 = SF10, 3 = SF9, 4 = SF8, 5 = SF7";
+static constexpr char ERR_CLASS [] = "A = Class A, B = Class B, C = Class C";
+static constexpr char ERR_PGSLOT [] = "0 to 7, ping every 2^n seconds";
+static constexpr char ERR_DR [] = "0 to 15 by region, EU868: 0 = SF12 to 5 = SF7, US915: 0 = SF10 to 3 = SF7, 4 = SF8/500";
 static constexpr char ERR_TXP [] = "EU868: 0 = Highest, 7 = Lowest";
 static constexpr char ERR_RETY [] = "0 to 7 attempts";
 
@@ -44,10 +49,15 @@ static constexpr char ERR_NJM [] = "0 = ABP, 1 = OTAA";
 
 static constexpr char ERR_RX1_DELAY [] = "1 to 15 seconds";
 static constexpr char ERR_RX2_DELAY [] = "2 to 15 seconds";
-static constexpr char ERR_RX2_DR [] = "EU868: 0 = SF12, 1 = SF11, 2 = SF10, 3 = SF9, 4 = SF8, 5 = SF7";
+static constexpr char ERR_RX2_DR [] = "0 to 15 by region, EU868: 0 = SF12 to 5 = SF7, US915 and AU915: 8 = SF12/500 to 13 = SF7/500";
+static constexpr char ERR_MASK [] = "4 hexadecimal digits, a bit per sub-band of 8 channels, e.g. 0002 = sub-band 2 (US915, AU915)";
 static constexpr char ERR_JN1DL_DELAY [] = "1 to 14 seconds";
 static constexpr char ERR_JN2DL_DELAY [] = "2 to 15 seconds";
 
+static constexpr char ERR_BAUD [] = "4800, 9600, 19200, 38400, 57600, 115200, 230400, 460800, 921600";
+
+static constexpr char ERR_PRECV [] = "0 = stop, 1 to 65533 milliseconds, 65534 = until a packet, 65535 = continuous";
+
 static constexpr char ERR_LINKCHECK [] = "0 = disabled, 1 = once, 2 = everytime";
 
 // -----------------------------------------------------------------------------------------------
@@ -61,6 +71,8 @@ protected:
         return String (CMD) + (IS_QUERY ? "=?" : "");
     }
     RakDeviceResult responseSet (const String &response) override {
+        if (! IS_QUERY)
+            return RakDeviceCommand::responseSet (response);
         const String command ("AT" + String (CMD));
         RakDeviceResult result = RakDeviceAttributeValidator::validateIsCommandWithEquals (response, command);
         if (! result.success)
@@ -68,6 +80,11 @@ protected:
         _response = response.substring (command.length () + 1);
         return true;
     }
+
+public:
+    String responsePrefix () const override {
+        return IS_QUERY ? "AT" + String (CMD) + "=" : String ();
+    }
 };
 
 typedef RakDeviceCommand_Simple<CMD_VER, true> RakDeviceCommand_VERSION;
@@ -87,22 +104,42 @@ public:
         return String (year) + "-" + (month < 10 ? "0" : "") + String (month) + "-" + (day < 10 ? "0" : "") + String (day) + "T" +
                (hours < 10 ? "0" : "") + String (hours) + ":" + (minutes < 10 ? "0" : "") + String (minutes) + ":" + (seconds < 10 ? "0" : "") + String (seconds) + "Z";
     }
+    bool getTimeEpoch (uint64_t &epoch) const {    // milliseconds since 1970-01-01 UTC
+        int hours, minutes, seconds, month, day, year;
+        if (sscanf (_response.c_str (), "%2dh%2dm%2ds on %2d/%2d/%4d", &hours, &minutes, &seconds, &month, &day, &year) != 6 || year < 1970 || month < 1 || month > 12 || day < 1 || day > 31)
+            return false;
+        epoch = (static_cast<uint64_t> (RakDeviceClock::daysFromCivil (year, month, day)) * 86400 + hours * 3600 + minutes * 60 + seconds) * 1000;
+        return true;
+    }
 };
-typedef RakDeviceCommand_Simple<CMD_SLEEP, false> RakDeviceCommand_SLEEP;
 typedef RakDeviceCommand_Simple<CMD_RESET, false> RakDeviceCommand_RESET;
 class RakDeviceCommand_RSSI_ALL : public RakDeviceCommand_Simple<CMD_ARSSI, true> {
 public:
-    using ChannelsRSSI = std::vector<std::pair<int, Lora::RSSI>>;
+    struct ChannelsRSSI {    // indexed by channel, present has a bit set for each channel reported
+        std::array<Lora::RSSI, Lora::MAXIMUM_CHANNELS> RSSI {};
+        uint32_t present = 0;
+        bool has (const int channel) const { return present & (1UL << channel); }
+        int count () const { return __builtin_popcount (present); }
+    };
 
 protected:
     ChannelsRSSI channelsRSSI {};
-    RakDeviceResult responseSet (const String &response) override {
-        for (int offset = 0, next = 0; offset < response.length (); offset = next) {
-            const int colon = response.indexOf (':', offset), comma = response.indexOf (',', colon);
-            next = comma >= 0 ? comma + 1 : response.length ();
-            const int channel = response.substring (offset, colon).toInt (), value = response.substring (colon + 1, next).toInt ();
-            if (channel >= 0 && channel <= Lora::MAXIMUM_CHANNELS)
-                channelsRSSI.push_back (std::pair (channel, value));
+    RakDeviceResult responseSet (const String &response) override {    // AT+ARSSI=0:-110,1:-112,...
+        const RakDeviceResult result = RakDeviceCommand_Simple<CMD_ARSSI, true>::responseSet (response);
+        if (! result.success)
+            return result;
+        channelsRSSI = {};
+        for (const char *cursor = _response.c_str (); *cursor != '\0';) {
+            char *end;
+            const long channel = strtol (cursor, &end, 10);
+            if (end == cursor || *end != ':')
+                return RakDeviceResult (false, String (CMD_ARSSI).substring (1) + " response has malformed channel at '" + String (cursor) + "'");
+            const long value = strtol (cursor = end + 1, &end, 10);
+            if (channel >= 0 && channel < Lora::MAXIMUM_CHANNELS) {
+                channelsRSSI.RSSI [channel] = static_cast<Lora::RSSI> (value);
+                channelsRSSI.present |= 1UL << channel;
+            }
+            cursor = (*end == ',') ? end + 1 : end + strlen (end);
         }
         return true;
     }
@@ -164,6 +201,9 @@ public:
         _value (T ()),
         _isQuery (true) { }
     const T &getValue () const { return _value; }
+    String responsePrefix () const override {
+        return _isQuery ? "AT" + String (CMD) + "=" : String ();
+    }
 };
 
 // -----------------------------------------------------------------------------------------------
@@ -229,6 +269,8 @@ typedef RakDeviceCommand_Integer<CMD_RX2_DELAY, Lora::MINIMUM_RX2_DELAY, Lora::M
 typedef RakDeviceCommand_Integer<CMD_RX2_DR, Lora::MINIMUM_DATARATE, Lora::MAXIMUM_DATARATE, ERR_RX2_DR> RakDeviceCommand_RX2_DATARATE;
 typedef RakDeviceCommand_Integer<CMD_JN1DL_DELAY, Lora::MINIMUM_JN1_DELAY, Lora::MAXIMUM_JN1_DELAY, ERR_JN1DL_DELAY> RakDeviceCommand_JN1DL_DELAY;
 typedef RakDeviceCommand_Integer<CMD_JN2DL_DELAY, Lora::MINIMUM_JN2_DELAY, Lora::MAXIMUM_JN2_DELAY, ERR_JN2DL_DELAY> RakDeviceCommand_JN2DL_DELAY;
+typedef RakDeviceCommand_Integer<CMD_PGSLOT, Lora::MINIMUM_PINGSLOT, Lora::MAXIMUM_PINGSLOT, ERR_PGSLOT> RakDeviceCommand_PINGSLOT;
+typedef RakDeviceCommand_Integer<CMD_PRECV, Lora::P2P_RECEIVE_STOP, Lora::P2P_RECEIVE_CONTINUOUS, ERR_PRECV> RakDeviceCommand_PRECV;
 typedef RakDeviceCommand_Integer<CMD_RETY, Lora::MINIMUM_CONFIRMRETRY, Lora::MAXIMUM_CONFIRMRETRY, ERR_RETY> RakDeviceCOmmand_CONFIRM_RETRY;
 
 // -----------------------------------------------------------------------------------------------
@@ -258,8 +300,8 @@ class RakDeviceCommand_CLASS : public RakDeviceCommand_String<CMD_CLASS, 1, 1, E
     using Base = RakDeviceCommand_String<CMD_CLASS, 1, 1, ERR_CLASS>;
 
 protected:
-    Lora::Class classX;
-    Lora::ClassB_Status classBStatus;
+    Lora::Class classX { Lora::Class::CLASS_A };
+    Lora::ClassB_Status classBStatus { Lora::ClassB_Status::DEVICETIME_REQ };
     RakDeviceResult responseSet (const String &response) override {
         const String command ("AT" + String (CMD_CLASS));
         if (_isQuery) {
@@ -271,7 +313,7 @@ protected:
                 return RakDeviceResult (false, "unexpected class");
             classX = static_cast<Lora::Class> (_response [0]);
             if (classX == Lora::Class::CLASS_B && _response.length () == 4 && _response [1] == ':' && _response [2] == 'S')
-                classBStatus = static_cast<Lora::ClassB_Status> (_response [3]);
+                classBStatus = static_cast<Lora::ClassB_Status> (_response [3] - '0');
             return true;
         }
         return RakDeviceCommand::responseSet (response);
@@ -305,6 +347,50 @@ typedef RakDeviceCommand_HexString<CMD_DEV_EUI, 16, 16> RakDeviceCommand_DEVEUI;
 typedef RakDeviceCommand_HexString<CMD_APP_EUI, 16, 16> RakDeviceCommand_APPEUI;
 typedef RakDeviceCommand_HexString<CMD_APP_KEY, 32, 32> RakDeviceCommand_APPKEY;
 typedef RakDeviceCommand_HexString<CMD_DEV_ADDR, 8, 8> RakDeviceCommand_DEVADDR;
+typedef RakDeviceCommand_HexString<CMD_PSEND, Lora::MINIMUM_P2P_SEND_SIZE, Lora::MAXIMUM_P2P_SEND_SIZE> RakDeviceCommand_PSEND;
+typedef RakDeviceCommand_HexString<CMD_MASK, 4, 4, ERR_MASK> RakDeviceCommand_MASK;
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
+
+class RakDeviceCommand_BAUD : public RakDeviceCommand_Integer<CMD_BAUD, 4800, 921600, ERR_BAUD> {    // one of Lora::BAUDRATES, not anything in between
+    using Base = RakDeviceCommand_Integer<CMD_BAUD, 4800, 921600, ERR_BAUD>;
+
+protected:
+    RakDeviceResult requestValidate () const override {
+        if (! Base::_isQuery) {
+            RakDeviceResult result = RakDeviceAttributeValidator::validateIsValueOneOf (Base::_value, CMD_BAUD, "value", Lora::BAUDRATES, String (ERR_BAUD));
+            if (! result.success)
+                return result;
+        }
+        return Base::requestValidate ();
+    }
+    RakDeviceResult responseProcess (const String &value) override {
+        RakDeviceResult result = Base::responseProcess (value);
+        if (! result.success)
+            return result;
+        return RakDeviceAttributeValidator::validateIsValueOneOf (Base::_value, CMD_BAUD, "value", Lora::BAUDRATES, String (ERR_BAUD));
+    }
+
+public:
+    using Base::Base;
+};
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
+
+class RakDeviceCommand_SLEEP : public RakDeviceCommand {    // AT+SLEEP until woken over the UART, AT+SLEEP=<ms> until then at the latest
+protected:
+    uint32_t _duration;
+    String requestBuild () const override {
+        return String (CMD_SLEEP) + (_duration > 0 ? "=" + String (_duration) : String ());
+    }
+
+public:
+    explicit RakDeviceCommand_SLEEP (const uint32_t duration = 0) :
+        _duration (duration) { }
+    uint32_t duration () const { return _duration; }
+};
 
 // -----------------------------------------------------------------------------------------------
 // -----------------------------------------------------------------------------------------------
@@ -421,6 +507,46 @@ public:
 // -----------------------------------------------------------------------------------------------
 // -----------------------------------------------------------------------------------------------
 
+class RakDeviceCommand_P2P : public RakDeviceCommand {
+
+public:
+    struct Parameters {
+        Lora::Frequency frequency;
+        int spreadingFactor, bandwidth, codingRate, preamble, txPower;    // bandwidth in kHz: 125, 250 or 500
+    };
+
+protected:
+    Parameters _parameters;
+    String requestBuild () const override {
+        return String (CMD_P2P) + "=" + join (':', _parameters.frequency, _parameters.spreadingFactor, _parameters.bandwidth, _parameters.codingRate, _parameters.preamble, _parameters.txPower);
+    }
+    RakDeviceResult requestValidate () const override {
+        RakDeviceResult result;
+        if (_parameters.bandwidth != 125 && _parameters.bandwidth != 250 && _parameters.bandwidth != 500)
+            return RakDeviceResult (false, String (CMD_P2P).substring (1) + " bandwidth has value '" + String (_parameters.bandwidth) + "' but must be 125, 250 or 500");
+        result = RakDeviceAttributeValidator::validateIsValueWithinMinMax (_parameters.spreadingFactor, CMD_P2P, "spreading-factor", Lora::MINIMUM_P2P_SF, Lora::MAXIMUM_P2P_SF, String ());
+        if (! result.success)
+            return result;
+        result = RakDeviceAttributeValidator::validateIsValueWithinMinMax (_parameters.codingRate, CMD_P2P, "coding-rate", Lora::MINIMUM_P2P_CR, Lora::MAXIMUM_P2P_CR, String ());
+        if (! result.success)
+            return result;
+        result = RakDeviceAttributeValidator::validateIsValueWithinMinMax (_parameters.preamble, CMD_P2P, "preamble", Lora::MINIMUM_P2P_PREAMBLE, Lora::MAXIMUM_P2P_PREAMBLE, String ());
+        if (! result.success)
+            return result;
+        result = RakDeviceAttributeValidator::validateIsValueWithinMinMax (_parameters.txPower, CMD_P2P, "tx-power", Lora::MINIMUM_P2P_TXPOWER, Lora::MAXIMUM_P2P_TXPOWER, String ());
+        if (! result.success)
+            return result;
+        return true;
+    }
+
+public:
+    explicit RakDeviceCommand_P2P (const Parameters &parameters) :
+        _parameters (parameters) { }
+};
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
+
 class RakDeviceCommand_RECV : public RakDeviceCommand_Simple<CMD_RECV, true> {
     using Base = RakDeviceCommand_Simple<CMD_RECV, true>;
 
@@ -2,7 +2,22 @@
 // -----------------------------------------------------------------------------------------------
 // -----------------------------------------------------------------------------------------------
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <initializer_list>
+#include <limits>
+#ifndef RAKDEVICE_FIXED_CAPACITY
 #include <map>
+#endif
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
 
 #if defined(DEBUG_RAKDEVICE)
 #ifndef DEBUG_RAKDEVICE_SERIAL
@@ -32,6 +47,25 @@
     } while (0)
 #endif
 
+// With RAKDEVICE_FIXED_CAPACITY, driver containers have compile-time capacity and callbacks are plain
+// function pointers with a context: no std::map, std::vector or std::function is built. It is not
+// heap-free: AT requests, responses and EventArgs are Strings, so every exchange and event still
+// allocates and frees. test_footprint bounds what that reaches over a simulated day; on the device,
+// reportFootprint () in the example prints the high-water mark since boot.
+
+// With DEBUG_RAKDEVICE_LOG, diagnostics are recorded unformatted into RakDeviceLog and formatted
+// later by whoever drains it; arguments are only evaluated if the subsystem's level admits them.
+// Without it, they go straight to RAKDEVICE_DEBUG_PRINTF as before.
+#if defined(DEBUG_RAKDEVICE_LOG)
+#define RAKDEVICE_LOG(subsystem, level, ...)                                                                          \
+    do {                                                                                                              \
+        if (RakDeviceLog::enabled (RakDeviceLog::Subsystem::subsystem, RakDeviceLog::Level::level))                   \
+            RakDeviceLog::record (RakDeviceLog::Subsystem::subsystem, RakDeviceLog::Level::level, __VA_ARGS__);      \
+    } while (0)
+#else
+#define RAKDEVICE_LOG(subsystem, level, ...) RAKDEVICE_DEBUG_PRINTF (__VA_ARGS__)
+#endif
+
 // -----------------------------------------------------------------------------------------------
 // -----------------------------------------------------------------------------------------------
 
@@ -58,12 +92,16 @@ struct Lora {
     };
 
     enum class Band : int {
-        BAND_EU868 = 4
+        BAND_IN865 = 3,
+        BAND_EU868 = 4,
+        BAND_US915 = 5,
+        BAND_AU915 = 6,
+        BAND_AS923 = 8    // AS923-1
     };
     static constexpr int MINIMUM_BAND = 0, MAXIMUM_BAND = 12;
     static constexpr Band DEFAULT_BAND = Band::BAND_EU868;
 
-    enum class Datarate : int {
+    enum class Datarate : int {    // the index, named as in EU868: see RakDeviceRegion for what each means elsewhere
         SF12 = 0,
         SF11 = 1,
         SF10 = 2,
@@ -71,7 +109,7 @@ struct Lora {
         SF8 = 4,
         SF7 = 5
     };
-    static constexpr int MINIMUM_DATARATE = 0, MAXIMUM_DATARATE = 5;
+    static constexpr int MINIMUM_DATARATE = 0, MAXIMUM_DATARATE = 15;
 
     enum class Join : int {
         JOIN_ABP = 0,
@@ -112,10 +150,19 @@ struct Lora {
         Lora::SNR SNR = 0;
     };
 
+    enum class Window : int {
+        RX_1 = 1,
+        RX_2 = 2,
+        RX_B = 3,    // Class B ping slot, or multicast
+        RX_C = 4,    // Class C continuous
+        RX_P2P = 5
+    };
+
     static constexpr int MINIMUM_SEND_SIZE = 1, MAXIMUM_SEND_SIZE = 2500;    // 1256 hexadecimal numbers
     static constexpr int MINIMIM_SEND_PORT = 1, MAXIMUM_SEND_PORT = 233;
     static constexpr int MINIMUM_JOIN_ATTEMPTS_DELAY = 7, MAXIMUM_JOIN_ATTEMPTS_DELAY = 255, DEFAULT_JOIN_ATTEMPTS_DELAY = 8;
     static constexpr int MINIMUM_JOIN_ATTEMPTS = 0, MAXIMUM_JOIN_ATTEMPTS = 255, DEFAULT_JOIN_ATTEMPTS = 0;
+    static constexpr int MAXIMUM_RECEIVE_SIZE = 242;
     static constexpr int MAXIMUM_CHANNELS = 16;
     static constexpr int MINIMUM_RX1_DELAY = 1, MAXIMUM_RX1_DELAY = 15;
     static constexpr int MINIMUM_RX2_DELAY = 2, MAXIMUM_RX2_DELAY = 15;
@@ -124,6 +171,25 @@ struct Lora {
     static constexpr int MINIMUM_CONFIRMRETRY = 0, MAXIMUM_CONFIRMRETRY = 7;
     static constexpr int MINIMUM_NJM = 0, MAXIMUM_NJM = 2;
     static constexpr int MINIMUM_NWM = 0, MAXIMUM_NWM = 2;
+    static constexpr int MINIMUM_PINGSLOT = 0, MAXIMUM_PINGSLOT = 7;    // ping every 2^n seconds
+
+    static constexpr int MINIMUM_P2P_SEND_SIZE = 2, MAXIMUM_P2P_SEND_SIZE = 510;    // 255 hexadecimal numbers
+    static constexpr int MINIMUM_P2P_SF = 5, MAXIMUM_P2P_SF = 12;
+    static constexpr int MINIMUM_P2P_CR = 0, MAXIMUM_P2P_CR = 3;    // 4/5 to 4/8
+    static constexpr int MINIMUM_P2P_PREAMBLE = 5, MAXIMUM_P2P_PREAMBLE = 65535;
+    static constexpr int MINIMUM_P2P_TXPOWER = 5, MAXIMUM_P2P_TXPOWER = 22;    // dBm
+    static constexpr uint32_t BAUDRATES [] = { 4800, 9600, 19200, 38400, 57600, 115200, 230400, 460800, 921600 };    // AT+BAUD takes these, not the values between
+    static constexpr int P2P_RECEIVE_STOP = 0, P2P_RECEIVE_UNTIL_PACKET = 65534, P2P_RECEIVE_CONTINUOUS = 65535;
+
+    static constexpr int FRAME_OVERHEAD_SIZE = 13;    // MHDR, FHDR (no FOpts), FPort, MIC
+    static uint32_t timeOnAir (const int spreadingFactor, const int bandwidth, const size_t payloadSize) {    // milliseconds, bandwidth in kHz, CR 4/5, explicit header, CRC on
+        const int sf = spreadingFactor, lowDataRateOptimise = (static_cast<float> (1 << sf) / bandwidth) > 16.0f ? 1 : 0;
+        const float symbol = static_cast<float> (1 << sf) / static_cast<float> (bandwidth);
+        const int numerator = 8 * static_cast<int> (payloadSize + FRAME_OVERHEAD_SIZE) - 4 * sf + 28 + 16;
+        const int denominator = 4 * (sf - 2 * lowDataRateOptimise);
+        const int symbols = 8 + std::max (((numerator + denominator - 1) / denominator) * 5, 0);
+        return static_cast<uint32_t> ((8 + 4.25f + symbols) * symbol + 0.5f);
+    }
 
     static String toString (const Class c) {
         switch (c) {
@@ -137,6 +203,20 @@ struct Lora {
             return "UNDEFINED";
         }
     }
+    static String toString (const ClassB_Status s) {
+        switch (s) {
+        case ClassB_Status::DEVICETIME_REQ :
+            return "DEVICETIME_REQ";
+        case ClassB_Status::BEACON_SEARCHING :
+            return "BEACON_SEARCHING";
+        case ClassB_Status::BEACON_LOCKED :
+            return "BEACON_LOCKED";
+        case ClassB_Status::BEACON_FAILED :
+            return "BEACON_FAILED";
+        default :
+            return "UNDEFINED";
+        }
+    }
     static String toString (const Mode m) {
         switch (m) {
         case Mode::MODE_P2PLORA :
@@ -151,8 +231,16 @@ struct Lora {
     }
     static String toString (const Band b) {
         switch (b) {
+        case Band::BAND_IN865 :
+            return "3 (IN865)";
         case Band::BAND_EU868 :
             return "4 (EU868)";
+        case Band::BAND_US915 :
+            return "5 (US915)";
+        case Band::BAND_AU915 :
+            return "6 (AU915)";
+        case Band::BAND_AS923 :
+            return "8 (AS923-1)";
         default :
             return "UNDEFINED";
         }
@@ -178,6 +266,98 @@ struct Lora {
 // -----------------------------------------------------------------------------------------------
 // -----------------------------------------------------------------------------------------------
 
+// Regional parameters (RP002-1.0.3) for the bands that Lora::Band names: what each data rate index
+// means, the largest application payload at each (N: repeater compatible, no dwell time limit), the
+// RX2 defaults and, for the fixed 64 + 8 channel plans, the sub-bands of 8 channels AT+MASK selects.
+
+struct RakDeviceRegion {
+    static inline constexpr int DATARATES = Lora::MAXIMUM_DATARATE + 1, SUBBAND_CHANNELS = 8;
+
+    struct DataRate {
+        int spreadingFactor = 0, bandwidth = 0;    // kHz, both 0 where the index is FSK, LR-FHSS or RFU
+        int maximumPayload = 0;
+        constexpr bool defined () const { return spreadingFactor > 0; }
+    };
+
+    Lora::Band band;
+    const char *name;
+    std::array<DataRate, DATARATES> dataRates;
+    int uplinkMinimum, uplinkMaximum;        // the 125 kHz uplink data rates, over which ADR and join backoff step
+    int downlinkMinimum, downlinkMaximum;    // those valid for RX2
+    Lora::Frequency rx2Frequency;
+    int rx2DataRate;
+    Lora::Frequency p2pFrequency;    // a default P2P channel inside the band
+    int subBands;    // 0 = no channel mask, the network configures the channels
+
+    constexpr const DataRate &dataRate (const Lora::Datarate dataRate) const {
+        return dataRates [static_cast<int> (dataRate)];
+    }
+    constexpr bool isUplink (const Lora::Datarate dataRate) const {
+        return static_cast<int> (dataRate) >= uplinkMinimum && static_cast<int> (dataRate) <= uplinkMaximum;
+    }
+    constexpr bool isDownlink (const Lora::Datarate dataRate) const {
+        return static_cast<int> (dataRate) >= downlinkMinimum && static_cast<int> (dataRate) <= downlinkMaximum;
+    }
+    constexpr int maximumPayloadSize (const Lora::Datarate dataRate) const {
+        return this->dataRate (dataRate).maximumPayload;
+    }
+    uint32_t timeOnAir (const Lora::Datarate dataRate, const size_t payloadSize) const {
+        const DataRate &rate = this->dataRate (dataRate);
+        return Lora::timeOnAir (rate.spreadingFactor, rate.bandwidth, payloadSize);
+    }
+    String subBandMask (const int subBand) const {    // AT+MASK value enabling only sub-band 1..subBands, or empty
+        if (subBand < 1 || subBand > subBands)
+            return String ();
+        char mask [4 + 1];
+        snprintf (mask, sizeof (mask), "%04X", 1 << (subBand - 1));
+        return String (mask);
+    }
+    String toString (const Lora::Datarate dataRate) const {
+        const DataRate &rate = this->dataRate (dataRate);
+        return "DR" + String (static_cast<int> (dataRate)) + (rate.defined () ? " (SF" + String (rate.spreadingFactor) + "/" + String (rate.bandwidth) + ")" : String (" (undefined)"));
+    }
+
+    static const RakDeviceRegion REGIONS [5];
+    static constexpr const RakDeviceRegion *find (const Lora::Band band);
+    static const RakDeviceRegion &of (const Lora::Band band) {    // unknown bands fall back to EU868
+        const RakDeviceRegion *region = find (band);
+        return region != nullptr ? *region : *find (Lora::DEFAULT_BAND);
+    }
+    static constexpr int payloadMinimum ();    // across the uplink data rates of every region: for sizing at compile time
+    static constexpr int payloadMaximum ();
+};
+
+inline constexpr RakDeviceRegion RakDeviceRegion::REGIONS [5] = {
+    { .band = Lora::Band::BAND_EU868, .name = "EU868", .dataRates = { { { 12, 125, 51 }, { 11, 125, 51 }, { 10, 125, 51 }, { 9, 125, 115 }, { 8, 125, 222 }, { 7, 125, 222 }, { 7, 250, 222 } } }, .uplinkMinimum = 0, .uplinkMaximum = 5, .downlinkMinimum = 0, .downlinkMaximum = 6, .rx2Frequency = 869525000, .rx2DataRate = 0, .p2pFrequency = 868000000, .subBands = 0 },
+    { .band = Lora::Band::BAND_US915, .name = "US915", .dataRates = { { { 10, 125, 11 }, { 9, 125, 53 }, { 8, 125, 125 }, { 7, 125, 222 }, { 8, 500, 222 }, {}, {}, {}, { 12, 500, 33 }, { 11, 500, 109 }, { 10, 500, 222 }, { 9, 500, 222 }, { 8, 500, 222 }, { 7, 500, 222 } } }, .uplinkMinimum = 0, .uplinkMaximum = 3, .downlinkMinimum = 8, .downlinkMaximum = 13, .rx2Frequency = 923300000, .rx2DataRate = 8, .p2pFrequency = 915000000, .subBands = 8 },
+    { .band = Lora::Band::BAND_AU915, .name = "AU915", .dataRates = { { { 12, 125, 51 }, { 11, 125, 51 }, { 10, 125, 51 }, { 9, 125, 115 }, { 8, 125, 222 }, { 7, 125, 222 }, { 8, 500, 222 }, {}, { 12, 500, 33 }, { 11, 500, 109 }, { 10, 500, 222 }, { 9, 500, 222 }, { 8, 500, 222 }, { 7, 500, 222 } } }, .uplinkMinimum = 0, .uplinkMaximum = 5, .downlinkMinimum = 8, .downlinkMaximum = 13, .rx2Frequency = 923300000, .rx2DataRate = 8, .p2pFrequency = 916800000, .subBands = 8 },
+    { .band = Lora::Band::BAND_AS923, .name = "AS923-1", .dataRates = { { { 12, 125, 51 }, { 11, 125, 51 }, { 10, 125, 51 }, { 9, 125, 115 }, { 8, 125, 222 }, { 7, 125, 222 }, { 7, 250, 222 } } }, .uplinkMinimum = 0, .uplinkMaximum = 5, .downlinkMinimum = 0, .downlinkMaximum = 6, .rx2Frequency = 923200000, .rx2DataRate = 2, .p2pFrequency = 923200000, .subBands = 0 },
+    { .band = Lora::Band::BAND_IN865, .name = "IN865", .dataRates = { { { 12, 125, 51 }, { 11, 125, 51 }, { 10, 125, 51 }, { 9, 125, 115 }, { 8, 125, 222 }, { 7, 125, 222 } } }, .uplinkMinimum = 0, .uplinkMaximum = 5, .downlinkMinimum = 0, .downlinkMaximum = 5, .rx2Frequency = 866550000, .rx2DataRate = 2, .p2pFrequency = 865062500, .subBands = 0 },
+};
+constexpr const RakDeviceRegion *RakDeviceRegion::find (const Lora::Band band) {
+    for (const auto &region : REGIONS)
+        if (region.band == band)
+            return &region;
+    return nullptr;
+}
+constexpr int RakDeviceRegion::payloadMinimum () {
+    int minimum = std::numeric_limits<int>::max ();
+    for (const auto &region : REGIONS)
+        for (int dataRate = region.uplinkMinimum; dataRate <= region.uplinkMaximum; dataRate++)
+            minimum = std::min (minimum, region.dataRates [dataRate].maximumPayload);
+    return minimum;
+}
+constexpr int RakDeviceRegion::payloadMaximum () {
+    int maximum = 0;
+    for (const auto &region : REGIONS)
+        for (const auto &dataRate : region.dataRates)
+            maximum = std::max (maximum, dataRate.maximumPayload);
+    return maximum;
+}
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
+
 struct RakDeviceResult {
     bool success;
     String details;
@@ -190,7 +370,28 @@ struct RakDeviceResult {
 // -----------------------------------------------------------------------------------------------
 
 struct RakDeviceEvent {
+#ifdef RAKDEVICE_FIXED_CAPACITY
+    struct Handler {
+        void (*function) (void *context, const RakDeviceEvent &) = nullptr;
+        void *context = nullptr;
+        Handler (std::nullptr_t = nullptr) { }
+        Handler (void (*f) (void *, const RakDeviceEvent &), void *c) :
+            function (f),
+            context (c) { }
+        explicit operator bool () const { return function != nullptr; }
+        void operator() (const RakDeviceEvent &event) const { function (context, event); }
+    };
+#else
     using Handler = std::function<void (const RakDeviceEvent &)>;
+#endif
+    template <typename T, void (T::*METHOD) (const RakDeviceEvent &)>
+    static Handler bind (T *object) {    // a member as a Handler, in either profile
+#ifdef RAKDEVICE_FIXED_CAPACITY
+        return Handler ([] (void *context, const RakDeviceEvent &event) { (static_cast<T *> (context)->*METHOD) (event); }, object);
+#else
+        return [object] (const RakDeviceEvent &event) { (object->*METHOD) (event); };
+#endif
+    }
     String type, args;
     RakDeviceEvent (const String &t, const String &a = String ()) :
         type (t),
@@ -223,6 +424,13 @@ struct RakDeviceAttributeValidator {
             return RakDeviceResult (false, command.substring (1) + " " + type + " has value '" + String (value) + "' but must be between " + String (value_min) + "and" + String (value_max) + (! errorString.isEmpty () ? String (" [" + errorString + "]") : String ("")));
         return true;
     }
+    template <typename T, size_t N>
+    static RakDeviceResult validateIsValueOneOf (const int value, const String &command, const String &type, const T (&values) [N], const String &errorString) {
+        for (const auto candidate : values)
+            if (static_cast<T> (value) == candidate)
+                return true;
+        return RakDeviceResult (false, command.substring (1) + " " + type + " has value '" + String (value) + "' but must be one of the permitted values" + (! errorString.isEmpty () ? String (" [" + errorString + "]") : String ("")));
+    }
     static RakDeviceResult validateStringIsHexadecimal (const String &candidate, const String &command, const String &errorString) {
         if (candidate.length () % 2 != 0)
             return RakDeviceResult (false, command.substring (1) + " data has length '" + String (candidate.length ()) + "' that is not even (for hexadecimal pairs)" + (! errorString.isEmpty () ? String (" [" + errorString + "]") : String ("")));
@@ -240,62 +448,796 @@ struct RakDeviceAttributeValidator {
 // -----------------------------------------------------------------------------------------------
 // -----------------------------------------------------------------------------------------------
 
-class RakDeviceTransceiver {
+template <typename T, size_t CAPACITY>
+class RakDeviceQueue {    // fixed capacity FIFO, not thread safe
+    T _items [CAPACITY];
+    size_t _head = 0, _count = 0;
+
+public:
+    static constexpr size_t capacity () { return CAPACITY; }
+    size_t size () const { return _count; }
+    bool empty () const { return _count == 0; }
+    bool full () const { return _count == CAPACITY; }
+    bool push (const T &item) {
+        if (_count == CAPACITY)
+            return false;
+        _items [(_head + _count++) % CAPACITY] = item;
+        return true;
+    }
+    T &front () { return _items [_head]; }
+    const T &front () const { return _items [_head]; }
+    T &back () { return _items [(_head + _count - 1) % CAPACITY]; }
+    T &operator[] (const size_t i) { return _items [(_head + i) % CAPACITY]; }    // from the front
+    const T &operator[] (const size_t i) const { return _items [(_head + i) % CAPACITY]; }
+    void pop () {
+        if (_count > 0)
+            _items [_head] = T (), _head = (_head + 1) % CAPACITY, _count--;    // releases what the item holds, e.g. a String's buffer
+    }
+    void erase (const size_t i) {    // from the front, later items move up
+        if (i >= _count)
+            return;
+        for (size_t j = i; j + 1 < _count; j++)
+            (*this) [j] = std::move ((*this) [j + 1]);
+        (*this) [--_count] = T ();
+    }
+};
+
+template <typename T, size_t CAPACITY>
+class RakDeviceVector {    // fixed capacity, not thread safe, excess items are dropped
+    T _items [CAPACITY];
+    size_t _size = 0;
+
+public:
+    RakDeviceVector () = default;
+    RakDeviceVector (std::initializer_list<T> items) {
+        for (const auto &item : items)
+            push_back (item);
+    }
+    static constexpr size_t capacity () { return CAPACITY; }
+    size_t size () const { return _size; }
+    bool empty () const { return _size == 0; }
+    bool push_back (const T &item) {
+        if (_size == CAPACITY)
+            return false;
+        _items [_size++] = item;
+        return true;
+    }
+    T &operator[] (const size_t i) { return _items [i]; }
+    const T &operator[] (const size_t i) const { return _items [i]; }
+    const T *begin () const { return _items; }
+    const T *end () const { return _items + _size; }
+};
+
+template <typename K, typename V, size_t CAPACITY>
+class RakDeviceMap {    // fixed capacity, unordered, linear search: for a handful of keys
+public:
+    struct Entry {    // as std::map's value_type
+        K first;
+        V second;
+    };
+
+private:
+    Entry _items [CAPACITY];
+    size_t _size = 0;
+    Entry _overflow;
+
+public:
+    V &operator[] (const K &key) {    // keys beyond capacity share one value
+        for (size_t i = 0; i < _size; i++)
+            if (_items [i].first == key)
+                return _items [i].second;
+        if (_size == CAPACITY)
+            return _overflow.second;
+        _items [_size] = Entry { key, V () };
+        return _items [_size++].second;
+    }
+    size_t size () const { return _size; }
+    const Entry *begin () const { return _items; }
+    const Entry *end () const { return _items + _size; }
+};
+
+template <size_t COUNT, size_t SIZE>
+class RakDeviceBufferPool {    // fixed buffers handed out and returned, thread safe
+    static_assert (COUNT > 0 && COUNT <= 32, "pool uses a 32 bit free mask");
+    uint8_t _buffers [COUNT][SIZE];
+    uint32_t _free = COUNT == 32 ? 0xFFFFFFFF : (static_cast<uint32_t> (1) << COUNT) - 1;
+    mutable std::mutex _mutex;
+
+public:
+    static constexpr size_t bufferSize () { return SIZE; }
+    uint8_t *acquire () {
+        std::lock_guard<std::mutex> guard (_mutex);
+        if (_free == 0)
+            return nullptr;
+        const int index = __builtin_ctz (_free);
+        _free &= ~(static_cast<uint32_t> (1) << index);
+        return _buffers [index];
+    }
+    void release (const uint8_t *buffer) {
+        if (buffer == nullptr)
+            return;
+        const size_t index = (buffer - _buffers [0]) / SIZE;
+        std::lock_guard<std::mutex> guard (_mutex);
+        if (index < COUNT)
+            _free |= static_cast<uint32_t> (1) << index;
+    }
+    size_t available () const {
+        std::lock_guard<std::mutex> guard (_mutex);
+        return __builtin_popcount (_free);
+    }
+};
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
+
+class RakDeviceQuantile {    // P-square streaming estimate of one quantile in five markers (Jain & Chlamtac)
+    float _p, _heights [5], _desired [5], _increments [5];
+    int _positions [5], _count = 0;
+
+    float parabolic (const int i, const int d) const {
+        return _heights [i] + static_cast<float> (d) / (_positions [i + 1] - _positions [i - 1]) * ((_positions [i] - _positions [i - 1] + d) * (_heights [i + 1] - _heights [i]) / (_positions [i + 1] - _positions [i]) + (_positions [i + 1] - _positions [i] - d) * (_heights [i] - _heights [i - 1]) / (_positions [i] - _positions [i - 1]));
+    }
+    float linear (const int i, const int d) const {
+        return _heights [i] + d * (_heights [i + d] - _heights [i]) / (_positions [i + d] - _positions [i]);
+    }
+
+public:
+    explicit RakDeviceQuantile (const float p) :
+        _p (p) { }
+    void add (const float x) {
+        if (_count < 5) {
+            _heights [_count++] = x;
+            if (_count == 5) {
+                std::sort (_heights, _heights + 5);
+                for (int i = 0; i < 5; i++)
+                    _positions [i] = i + 1;
+                const float desired [5] = { 1, 1 + 2 * _p, 1 + 4 * _p, 3 + 2 * _p, 5 }, increments [5] = { 0, _p / 2, _p, (1 + _p) / 2, 1 };
+                std::copy (desired, desired + 5, _desired);
+                std::copy (increments, increments + 5, _increments);
+            }
+            return;
+        }
+        int k;
+        if (x < _heights [0])
+            _heights [0] = x, k = 0;
+        else if (x >= _heights [4])
+            _heights [4] = std::max (_heights [4], x), k = 3;
+        else
+            for (k = 0; k < 3 && x >= _heights [k + 1]; k++)
+                ;
+        for (int i = k + 1; i < 5; i++)
+            _positions [i]++;
+        for (int i = 0; i < 5; i++)
+            _desired [i] += _increments [i];
+        for (int i = 1; i < 4; i++) {
+            const float delta = _desired [i] - _positions [i];
+            if ((delta >= 1 && _positions [i + 1] - _positions [i] > 1) || (delta <= -1 && _positions [i - 1] - _positions [i] < -1)) {
+                const int d = delta > 0 ? 1 : -1;
+                const float height = parabolic (i, d);
+                _heights [i] = (_heights [i - 1] < height && height < _heights [i + 1]) ? height : linear (i, d);
+                _positions [i] += d;
+            }
+        }
+    }
+    float value () const {
+        if (_count >= 5)
+            return _heights [2];
+        if (_count == 0)
+            return 0.0f;
+        float sorted [5];
+        std::copy (_heights, _heights + _count, sorted);
+        std::sort (sorted, sorted + _count);
+        return sorted [static_cast<int> (_p * (_count - 1) + 0.5f)];
+    }
+};
+
+template <size_t N>
+class RakDeviceSeries {    // fixed window of timestamped samples, statistics maintained per sample in O(1)
+    struct Sample {
+        float value;
+        interval_t time;
+    };
+    Sample _samples [N];
+    size_t _head = 0, _count = 0;
+    uint32_t _sequence = 0;                        // samples ever added
+    double _sum = 0, _sumSquares = 0;              // over the window
+    float _ewma = 0, _alpha;
+    uint32_t _minimums [N], _maximums [N];          // monotonic deques of sequence numbers, over the window
+    size_t _minimumsHead = 0, _minimumsCount = 0, _maximumsHead = 0, _maximumsCount = 0;
+    RakDeviceQuantile _p10 { 0.10f }, _p50 { 0.50f }, _p90 { 0.90f };    // over all samples
+
+    const Sample &bySequence (const uint32_t sequence) const { return _samples [sequence % N]; }
+    template <typename Compare>
+    void dequePush (uint32_t *deque, size_t &head, size_t &count, const float value, Compare compare) {
+        while (count > 0 && ! compare (bySequence (deque [(head + count - 1) % N]).value, value))
+            count--;
+        deque [(head + count++) % N] = _sequence;
+    }
+    static void dequeExpire (const uint32_t *deque, size_t &head, size_t &count, const uint32_t oldest) {
+        while (count > 0 && deque [head] < oldest)
+            head = (head + 1) % N, count--;
+    }
+
+public:
+    explicit RakDeviceSeries (const float alpha = 0.1f) :
+        _alpha (alpha) { }
+
+    void add (const float value, const interval_t time = millis ()) {
+        if (_count == N) {
+            const float expired = _samples [_head].value;
+            _sum -= expired;
+            _sumSquares -= static_cast<double> (expired) * expired;
+            _head = (_head + 1) % N;
+            _count--;
+        }
+        _samples [(_head + _count++) % N] = { .value = value, .time = time };
+        _sum += value;
+        _sumSquares += static_cast<double> (value) * value;
+        _ewma = (_sequence == 0) ? value : _ewma + _alpha * (value - _ewma);
+        dequeExpire (_minimums, _minimumsHead, _minimumsCount, _sequence + 1 - _count);
+        dequeExpire (_maximums, _maximumsHead, _maximumsCount, _sequence + 1 - _count);
+        dequePush (_minimums, _minimumsHead, _minimumsCount, value, [] (const float a, const float b) { return a < b; });
+        dequePush (_maximums, _maximumsHead, _maximumsCount, value, [] (const float a, const float b) { return a > b; });
+        _p10.add (value);
+        _p50.add (value);
+        _p90.add (value);
+        _sequence++;
+    }
+
+    static constexpr size_t capacity () { return N; }
+    size_t size () const { return _count; }
+    bool empty () const { return _count == 0; }
+    float operator[] (const size_t i) const { return _samples [(_head + i) % N].value; }    // 0 = oldest
+    interval_t time (const size_t i) const { return _samples [(_head + i) % N].time; }
+    float latest () const { return _count > 0 ? (*this) [_count - 1] : 0.0f; }
+
+    float mean () const { return _count > 0 ? static_cast<float> (_sum / _count) : 0.0f; }
+    float variance () const { return _count > 1 ? static_cast<float> (std::max (0.0, (_sumSquares - _sum * _sum / _count) / (_count - 1))) : 0.0f; }
+    float ewma () const { return _ewma; }
+    float minimum () const { return _minimumsCount > 0 ? bySequence (_minimums [_minimumsHead]).value : 0.0f; }
+    float maximum () const { return _maximumsCount > 0 ? bySequence (_maximums [_maximumsHead]).value : 0.0f; }
+    float p10 () const { return _p10.value (); }
+    float p50 () const { return _p50.value (); }
+    float p90 () const { return _p90.value (); }
+};
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
+
+class RakDeviceClock {    // network time, disciplined against millis (): anchored at the first sync, drift measured across the span since
+public:
+    static inline constexpr interval_t RESOLUTION = 1000;    // LTIME reports whole seconds
+    static inline constexpr float DRIFT_MAXIMUM = 500;       // ppm, beyond which a sync is treated as a step and the anchor restarts
+
+    static int64_t daysFromCivil (int year, const int month, const int day) {    // proleptic Gregorian to days since 1970-01-01
+        year -= month <= 2;
+        const int era = (year >= 0 ? year : year - 399) / 400, yoe = year - era * 400, doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1, doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+        return static_cast<int64_t> (era) * 146097 + doe - 719468;
+    }
+    static String toString (const uint64_t epoch) {    // ISO 8601, UTC
+        const int64_t days = epoch / 86400000, z = days + 719468, era = (z >= 0 ? z : z - 146096) / 146097, doe = z - era * 146097, yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365, doy = doe - (365 * yoe + yoe / 4 - yoe / 100), mp = (5 * doy + 2) / 153;
+        const int day = doy - (153 * mp + 2) / 5 + 1, month = mp < 10 ? mp + 3 : mp - 9, year = yoe + era * 400 + (month <= 2);
+        const uint32_t seconds = (epoch / 1000) % 86400;
+        char buffer [sizeof ("YYYY-MM-DDTHH:MM:SSZ") + 4];
+        snprintf (buffer, sizeof (buffer), "%04d-%02d-%02dT%02lu:%02lu:%02luZ", year, month, day, static_cast<unsigned long> (seconds / 3600), static_cast<unsigned long> ((seconds / 60) % 60), static_cast<unsigned long> (seconds % 60));
+        return String (buffer);
+    }
+
+private:
+    uint64_t _anchorEpoch = 0, _syncEpoch = 0;
+    interval_t _anchorLocal = 0, _syncLocal = 0;
+    float _drift = 0;    // ppm, network clock relative to millis ()
+    counter_t _syncs = 0;
+
+    float uncertainty () const {    // ppm, from the sync resolution over the span measured
+        const interval_t span = _syncLocal - _anchorLocal;
+        return span > 0 ? static_cast<float> (RESOLUTION) * 1e6f / span : DRIFT_MAXIMUM;
+    }
+
+public:
+    void synchronise (const uint64_t epoch, const interval_t local) {
+        if (_syncs > 0) {
+            const float span = static_cast<float> (local - _anchorLocal), drift = span > 0 ? (static_cast<float> (static_cast<int64_t> (epoch - _anchorEpoch)) - span) * 1e6f / span : 0;
+            if (std::fabs (drift) > DRIFT_MAXIMUM + static_cast<float> (RESOLUTION) * 1e6f / std::max (span, 1.0f))
+                _anchorEpoch = epoch, _anchorLocal = local, _drift = 0;
+            else
+                _drift = drift;
+        } else
+            _anchorEpoch = epoch, _anchorLocal = local;
+        _syncEpoch = epoch;
+        _syncLocal = local;
+        _syncs++;
+    }
+    bool synchronised () const { return _syncs > 0; }
+    counter_t syncs () const { return _syncs; }
+    float drift () const { return _drift; }
+    uint64_t now (const interval_t local = millis ()) const {
+        const interval_t elapsed = local - _syncLocal;
+        return _syncEpoch + elapsed + static_cast<int64_t> (elapsed * _drift / 1e6f);
+    }
+    interval_t interval (const interval_t minimum, const interval_t maximum, const interval_t tolerance) const {    // until the error could exceed tolerance
+        const float error = std::fabs (_drift) + uncertainty ();
+        return std::clamp (static_cast<interval_t> (std::min (static_cast<float> (tolerance) * 1e6f / error, static_cast<float> (maximum))), minimum, maximum);
+    }
+};
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
+
+template <size_t CAPACITY>
+class RakDeviceScheduler {    // one-shot and periodic timers in a min-heap over fixed storage, deadlines compared wrap-safe
+public:
+    using TimerId = size_t;    // 0 = none, no free slot
+    using Callback = void (*) (void *context);
+    static inline constexpr interval_t NONE = std::numeric_limits<interval_t>::max ();
+
+private:
+    struct Timer {
+        Callback callback = nullptr;
+        void *context = nullptr;
+        interval_t deadline = 0, period = 0;    // period 0 = one-shot
+        int position = -1;                      // in the heap, -1 = not armed
+    };
+    Timer _timers [CAPACITY];
+    size_t _heap [CAPACITY], _heapSize = 0;
+    mutable std::mutex _mutex;
+
+    static bool before (const interval_t a, const interval_t b) { return static_cast<long> (a - b) < 0; }
+    bool less (const size_t a, const size_t b) const { return before (_timers [_heap [a]].deadline, _timers [_heap [b]].deadline); }
+    void swap (const size_t a, const size_t b) {
+        std::swap (_heap [a], _heap [b]);
+        _timers [_heap [a]].position = a;
+        _timers [_heap [b]].position = b;
+    }
+    void up (size_t i) {
+        for (; i > 0 && less (i, (i - 1) / 2); i = (i - 1) / 2)
+            swap (i, (i - 1) / 2);
+    }
+    void down (size_t i) {
+        for (size_t smallest = i;; i = smallest) {
+            const size_t left = 2 * i + 1, right = left + 1;
+            if (left < _heapSize && less (left, smallest))
+                smallest = left;
+            if (right < _heapSize && less (right, smallest))
+                smallest = right;
+            if (smallest == i)
+                return;
+            swap (i, smallest);
+        }
+    }
+    void unlink (Timer &timer) {
+        if (timer.position < 0)
+            return;
+        const size_t i = timer.position;
+        timer.position = -1;
+        if (i != --_heapSize) {
+            _heap [i] = _heap [_heapSize];
+            _timers [_heap [i]].position = i;
+            up (i);
+            down (i);
+        }
+    }
+    void insert (const size_t slot) {
+        _heap [_heapSize] = slot;
+        _timers [slot].position = _heapSize;
+        up (_heapSize++);
+    }
+
+public:
+    TimerId add (const Callback callback, void *context = nullptr) {    // registered, not yet armed
+        std::lock_guard<std::mutex> guard (_mutex);
+        for (size_t slot = 0; slot < CAPACITY; slot++)
+            if (_timers [slot].callback == nullptr) {
+                _timers [slot] = { .callback = callback, .context = context };
+                return slot + 1;
+            }
+        return 0;
+    }
+    template <typename T, void (T::*METHOD) ()>
+    TimerId add (T *object) {
+        return add ([] (void *context) { (static_cast<T *> (context)->*METHOD) (); }, object);
+    }
+    void start (const TimerId id, const interval_t delay, const interval_t period = 0) {    // (re)arm, from now
+        std::lock_guard<std::mutex> guard (_mutex);
+        if (id == 0 || id > CAPACITY)
+            return;
+        Timer &timer = _timers [id - 1];
+        unlink (timer);
+        timer.deadline = millis () + delay;
+        timer.period = period;
+        insert (id - 1);
+    }
+    void cancel (const TimerId id) {
+        std::lock_guard<std::mutex> guard (_mutex);
+        if (id > 0 && id <= CAPACITY)
+            unlink (_timers [id - 1]);
+    }
+    void remove (const TimerId id) {    // cancel, and free the slot
+        std::lock_guard<std::mutex> guard (_mutex);
+        if (id > 0 && id <= CAPACITY) {
+            unlink (_timers [id - 1]);
+            _timers [id - 1] = Timer ();
+        }
+    }
+    bool pending (const TimerId id) const {
+        std::lock_guard<std::mutex> guard (_mutex);
+        return id > 0 && id <= CAPACITY && _timers [id - 1].position >= 0;
+    }
+    interval_t remaining (const TimerId id) const {    // NONE if not armed
+        std::lock_guard<std::mutex> guard (_mutex);
+        if (id == 0 || id > CAPACITY || _timers [id - 1].position < 0)
+            return NONE;
+        const interval_t current = millis (), deadline = _timers [id - 1].deadline;
+        return before (current, deadline) ? deadline - current : 0;
+    }
+    interval_t nextDeadline () const {    // milliseconds until the next timer is due, NONE if nothing is armed
+        std::lock_guard<std::mutex> guard (_mutex);
+        if (_heapSize == 0)
+            return NONE;
+        const interval_t current = millis (), deadline = _timers [_heap [0]].deadline;
+        return before (current, deadline) ? deadline - current : 0;
+    }
+
+    size_t process () {    // runs what is due, periodic timers re-armed before their callback so that it may restart or cancel them
+        size_t count = 0;
+        for (;;) {
+            Callback callback;
+            void *context;
+            {
+                std::lock_guard<std::mutex> guard (_mutex);
+                const interval_t current = millis ();
+                if (_heapSize == 0 || before (current, _timers [_heap [0]].deadline))
+                    return count;
+                const size_t slot = _heap [0];
+                Timer &timer = _timers [slot];
+                unlink (timer);
+                if (timer.period > 0) {
+                    timer.deadline += timer.period;
+                    if (! before (current, timer.deadline))
+                        timer.deadline = current + timer.period;    // fell behind, do not replay
+                    insert (slot);
+                }
+                callback = timer.callback;
+                context = timer.context;
+            }
+            callback (context);
+            count++;
+        }
+    }
+};
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
+
+// Binary log: each record is the format string's address plus the raw arguments (strings copied,
+// truncated), in a lock-free multiple producer, single consumer ring. Producers never format and
+// never block; a full ring drops the record and counts it. The consumer, e.g. a low priority task
+// or the idle part of loop (), formats with drain (), or ships records with read () to be decoded
+// host side against the firmware image, where format is resolved by address.
+
+#ifndef RAKDEVICE_LOG_SIZE
+#define RAKDEVICE_LOG_SIZE 32
+#endif
+
+class RakDeviceLog {
+public:
+    static inline constexpr size_t SIZE = RAKDEVICE_LOG_SIZE, MAXIMUM_ARGUMENTS = 8, TEXT_SIZE = 64;
+    static_assert (SIZE > 0 && (SIZE & (SIZE - 1)) == 0, "log size must be a power of two");
+
+    enum class Subsystem : uint8_t {
+        TRANSCEIVER,
+        COMMANDER,
+        MANAGER,
+        MESSENGER,
+        FRAGMENTER
+    };
+    static inline constexpr size_t SUBSYSTEM_COUNT = static_cast<size_t> (Subsystem::FRAGMENTER) + 1;
+    enum class Level : uint8_t {
+        NONE,
+        ERROR,
+        WARNING,
+        INFO,
+        DEBUG
+    };
+    enum class Type : uint8_t {
+        SIGNED,
+        UNSIGNED,
+        DOUBLE,
+        POINTER,
+        STRING    // value = offset into text << 8 | length
+    };
+
+    struct Record {
+        const char *format;
+        uint32_t timestamp;
+        Subsystem subsystem;
+        Level level;
+        uint8_t count, textUsed;
+        Type types [MAXIMUM_ARGUMENTS];
+        uint64_t values [MAXIMUM_ARGUMENTS];
+        char text [TEXT_SIZE];
+
+        template <typename T>
+            requires std::is_integral_v<T> || std::is_enum_v<T>
+        void add (const T value) {
+            if constexpr (std::is_signed_v<T>)
+                types [count] = Type::SIGNED, values [count++] = static_cast<uint64_t> (static_cast<int64_t> (value));
+            else
+                types [count] = Type::UNSIGNED, values [count++] = static_cast<uint64_t> (value);
+        }
+        void add (const double value) {
+            types [count] = Type::DOUBLE;
+            memcpy (&values [count++], &value, sizeof (value));
+        }
+        void add (const void *value) {
+            types [count] = Type::POINTER, values [count++] = reinterpret_cast<uintptr_t> (value);
+        }
+        void add (const char *value) {
+            const size_t length = value == nullptr ? 0 : strnlen (value, TEXT_SIZE - textUsed);
+            if (length > 0)
+                memcpy (text + textUsed, value, length);
+            types [count] = Type::STRING, values [count++] = (static_cast<uint64_t> (textUsed) << 8) | length;
+            textUsed += length;
+        }
+    };
+
+private:
+    struct Slot {
+        std::atomic<uint32_t> sequence;    // = position when free for it, position + 1 when written
+        Record record;
+    };
+    template <size_t... I>
+    static std::array<Slot, SIZE> slots (std::index_sequence<I...>) {
+        return { Slot { { I }, {} }... };
+    }
+    static inline std::array<Slot, SIZE> _slots = slots (std::make_index_sequence<SIZE> ());
+    static inline std::atomic<uint32_t> _written { 0 }, _dropped { 0 };
+    static inline uint32_t _read = 0;
+    template <size_t... I>
+    static std::array<std::atomic<Level>, SUBSYSTEM_COUNT> levels (std::index_sequence<I...>) {    // every subsystem, including any added later
+        return { ((void) I, Level::INFO)... };
+    }
+    static inline std::array<std::atomic<Level>, SUBSYSTEM_COUNT> _levels = levels (std::make_index_sequence<SUBSYSTEM_COUNT> ());
+
+    static Slot *reserve (uint32_t &position) {
+        position = _written.load (std::memory_order_relaxed);
+        while (true) {
+            Slot &slot = _slots [position & (SIZE - 1)];
+            const int32_t difference = static_cast<int32_t> (slot.sequence.load (std::memory_order_acquire) - position);
+            if (difference == 0) {
+                if (_written.compare_exchange_weak (position, position + 1, std::memory_order_relaxed))
+                    return &slot;
+            } else if (difference < 0)
+                return nullptr;
+            else
+                position = _written.load (std::memory_order_relaxed);
+        }
+    }
+
+public:
+    static void level (const Subsystem subsystem, const Level level) { _levels [static_cast<size_t> (subsystem)].store (level, std::memory_order_relaxed); }
+    static Level level (const Subsystem subsystem) { return _levels [static_cast<size_t> (subsystem)].load (std::memory_order_relaxed); }
+    static bool enabled (const Subsystem subsystem, const Level level) { return level != Level::NONE && level <= RakDeviceLog::level (subsystem); }
+    static uint32_t dropped () { return _dropped.load (std::memory_order_relaxed); }
+
+    template <typename... Arguments>
+    static void record (const Subsystem subsystem, const Level level, const char *format, const Arguments... arguments) {
+        static_assert (sizeof...(Arguments) <= MAXIMUM_ARGUMENTS, "too many log arguments");
+        uint32_t position;
+        Slot *slot = reserve (position);
+        if (slot == nullptr) {
+            _dropped.fetch_add (1, std::memory_order_relaxed);
+            return;
+        }
+        Record &record = slot->record;
+        record.format = format;
+        record.timestamp = static_cast<uint32_t> (millis ());
+        record.subsystem = subsystem;
+        record.level = level;
+        record.count = record.textUsed = 0;
+        (record.add (arguments), ...);
+        slot->sequence.store (position + 1, std::memory_order_release);
+    }
+
+    static bool read (Record &record) {    // single consumer
+        Slot &slot = _slots [_read & (SIZE - 1)];
+        if (slot.sequence.load (std::memory_order_acquire) != _read + 1)
+            return false;
+        record = slot.record;
+        slot.sequence.store (_read + SIZE, std::memory_order_release);
+        _read++;
+        return true;
+    }
+
+    static size_t format (const Record &record, char *buffer, const size_t size) {    // printf conversions, one argument each, '*' widths unsupported
+        size_t used = 0, argument = 0;
+        const auto advance = [&] (const int length) {
+            if (length > 0)
+                used += std::min (static_cast<size_t> (length), size - 1 - used);
+        };
+        for (const char *cursor = record.format; *cursor != '\0' && used + 1 < size;) {
+            if (*cursor != '%' || cursor [1] == '%') {
+                buffer [used++] = *cursor;
+                cursor += (*cursor == '%') ? 2 : 1;
+                continue;
+            }
+            const char *start = cursor++;
+            while (*cursor != '\0' && strchr ("-+ #0123456789.", *cursor) != nullptr)
+                cursor++;
+            char modifier = '\0';
+            while (*cursor != '\0' && strchr ("hlLzjt", *cursor) != nullptr)
+                modifier = (modifier == 'l' && *cursor == 'l') ? 'L' : *cursor, cursor++;
+            if (*cursor != '\0')
+                cursor++;
+            if (argument >= record.count)
+                break;
+            char specification [16];
+            const size_t length = std::min (static_cast<size_t> (cursor - start), sizeof (specification) - 1);
+            memcpy (specification, start, length);
+            specification [length] = '\0';
+            const uint64_t value = record.values [argument];
+            switch (record.types [argument++]) {
+            case Type::STRING: {
+                char text [TEXT_SIZE + 1];
+                const size_t textLength = value & 0xFF;
+                memcpy (text, record.text + (value >> 8), textLength);
+                text [textLength] = '\0';
+                advance (snprintf (buffer + used, size - used, specification, text));
+                break;
+            }
+            case Type::DOUBLE: {
+                double number;
+                memcpy (&number, &value, sizeof (number));
+                advance (snprintf (buffer + used, size - used, specification, number));
+                break;
+            }
+            case Type::POINTER:
+                advance (snprintf (buffer + used, size - used, specification, reinterpret_cast<void *> (static_cast<uintptr_t> (value))));
+                break;
+            default:
+                if (modifier == 'L' || modifier == 'j')
+                    advance (snprintf (buffer + used, size - used, specification, static_cast<long long> (value)));
+                else if (modifier == 'l')
+                    advance (snprintf (buffer + used, size - used, specification, static_cast<long> (value)));
+                else if (modifier == 'z' || modifier == 't')
+                    advance (snprintf (buffer + used, size - used, specification, static_cast<size_t> (value)));
+                else
+                    advance (snprintf (buffer + used, size - used, specification, static_cast<int> (value)));
+                break;
+            }
+        }
+        buffer [used] = '\0';
+        return used;
+    }
+
+    static size_t drain (Print &output, const size_t maximum = SIZE) {    // formats up to maximum records, returns how many
+        static constexpr const char *LEVELS [] = { "-", "E", "W", "I", "D" };
+        Record record;
+        char buffer [256];
+        size_t count = 0;
+        while (count < maximum && read (record)) {
+            format (record, buffer, sizeof (buffer));
+            output.printf ("[%lu %s] %s", static_cast<unsigned long> (record.timestamp), LEVELS [static_cast<size_t> (record.level)], buffer);
+            count++;
+        }
+        return count;
+    }
+};
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
+
+template <typename S = Stream>
+class RakDeviceTransceiverT {    // S is the stream's exact type: unless abstract, its methods are called directly rather than through the vtable
     static inline constexpr unsigned int BUFFER_MINIMUM_SIZE = 128;    // most responses are less than this
     static inline constexpr uint32_t BLOCKING_WAIT_DELAY = 5;
-    Stream &_stream;
+    static inline constexpr uint32_t PARTIAL_LINE_TIMEOUT = 2000;
+    static inline constexpr size_t RECEIVE_CHUNK_SIZE = 64;    // read from the stream in one call, rather than a byte at a time
+    S &_stream;
+    char _received [RECEIVE_CHUNK_SIZE];
+    size_t _receivedHead = 0, _receivedTail = 0;
+
+    int streamAvailable () const {
+        if constexpr (std::is_abstract_v<S>)
+            return _stream.available ();
+        else
+            return _stream.S::available ();
+    }
+    size_t streamRead (char *buffer, const size_t length) {
+        if constexpr (std::is_abstract_v<S>)
+            return _stream.readBytes (reinterpret_cast<uint8_t *> (buffer), length);
+        else
+            return _stream.S::readBytes (reinterpret_cast<uint8_t *> (buffer), length);
+    }
+    size_t streamWrite (const uint8_t *buffer, const size_t length) {
+        if constexpr (std::is_abstract_v<S>)
+            return _stream.write (buffer, length);
+        else
+            return _stream.S::write (buffer, length);
+    }
+    bool fill () {    // whatever the stream has, up to a chunk, once the previous chunk is consumed
+        if (_receivedHead < _receivedTail)
+            return true;
+        const int available = streamAvailable ();
+        if (available <= 0)
+            return false;
+        _receivedHead = 0;
+        _receivedTail = streamRead (_received, std::min (static_cast<size_t> (available), RECEIVE_CHUNK_SIZE));
+        return _receivedTail > 0;
+    }
 
 public:
-    RakDeviceTransceiver (Stream &stream) :
+    RakDeviceTransceiverT (S &stream) :
         _stream (stream) {
         _stream.setTimeout (2000);
     }
     void poke () {
-        _stream.print ("\n");
+        streamWrite (reinterpret_cast<const uint8_t *> ("\n"), 1);
     }
     bool send (const String &cmd) {
 #ifdef DEBUG_RAKDEVICE_TRANSCEIVER
-        RAKDEVICE_DEBUG_PRINTF ("-TX-> <<%s>>\n", cmd.c_str ());
+        RAKDEVICE_LOG (TRANSCEIVER, DEBUG, "-TX-> <<%s>>\n", cmd.c_str ());
 #endif
-        _stream.print (cmd + "\n");
+        streamWrite (reinterpret_cast<const uint8_t *> (cmd.c_str ()), cmd.length ());
+        poke ();
         return true;
     }
     bool available () const {
-        return _stream.available () > 0;
+        return _receivedHead < _receivedTail || streamAvailable () > 0;
     }
-    String readLine (const bool blocking = false) {
+    String readLine (const bool blocking = false, const uint32_t timeout = 0) {
         String buffer;
-        if (blocking || _stream.available ()) {
+        if (blocking || available ()) {
             buffer.reserve (BUFFER_MINIMUM_SIZE);
-            int r;
-            do {
-                while (blocking && ! _stream.available ())
+            const unsigned long started = millis ();
+            const uint32_t limit = timeout > 0 ? timeout : (blocking ? 0 : PARTIAL_LINE_TIMEOUT);    // a line at the wrong baud rate may never terminate
+            bool terminated = false;
+            while (! terminated) {
+                if (! fill ()) {
+                    if (limit > 0 && millis () - started > limit) {
+                        buffer.trim ();
+                        return buffer;
+                    }
                     delay (BLOCKING_WAIT_DELAY);
-                if (_stream.available () && (r = _stream.read ()) >= 0)
-                    buffer += (char) r;
-            } while (! (r == '\r' || r == '\n'));
-            while ((r = _stream.peek ()) >= 0 && (r == '\r' || r == '\n'))
-                (void) _stream.read ();
+                    continue;
+                }
+                const char *start = _received + _receivedHead, *end = _received + _receivedTail, *cursor = start;
+                while (cursor < end && *cursor != '\r' && *cursor != '\n')
+                    cursor++;
+                buffer.concat (start, cursor - start);
+                _receivedHead += cursor - start;
+                if (cursor < end) {
+                    _receivedHead++;
+                    terminated = ! buffer.isEmpty ();    // else the line before's "\r\n", its "\n" slower to arrive than the line was read: not a line of its own
+                    if (! terminated && ! blocking && ! available ())
+                        return buffer;
+                }
+            }
+            while (fill () && (_received [_receivedHead] == '\r' || _received [_receivedHead] == '\n'))
+                _receivedHead++;
             buffer.trim ();
 #ifdef DEBUG_RAKDEVICE_TRANSCEIVER
             if (! buffer.isEmpty ())
-                RAKDEVICE_DEBUG_PRINTF ("<-RX- <<%s>>\n", buffer.c_str ());
+                RAKDEVICE_LOG (TRANSCEIVER, DEBUG, "<-RX- <<%s>>\n", buffer.c_str ());
 #endif
         }
         return buffer;
     }
 };
+using RakDeviceTransceiver = RakDeviceTransceiverT<Stream>;
 
 // -----------------------------------------------------------------------------------------------
 // -----------------------------------------------------------------------------------------------
 
-class RakDeviceCommander;
+template <typename S = Stream>
+class RakDeviceCommanderT;
 class RakDeviceCommand {
 protected:
     String _response;
     virtual String requestBuild () const = 0;
     virtual RakDeviceResult requestValidate () const { return true; }
-    friend RakDeviceCommander;
+    template <typename>
+    friend class RakDeviceCommanderT;
 
 public:
     virtual ~RakDeviceCommand () { }
@@ -305,32 +1247,145 @@ public:
         return RakDeviceResult (_response == "OK", "response == 'OK'");
     }
     virtual bool isAsync () const { return false; }
+    virtual String responsePrefix () const { return String (); }    // non-empty when the response can be matched out of order
 };
 
 // -----------------------------------------------------------------------------------------------
 // -----------------------------------------------------------------------------------------------
 
-class RakDeviceCommander {
-    RakDeviceTransceiver &_transceiver;
+#ifndef RAKDEVICE_UNSOLICITED_SIZE
+#define RAKDEVICE_UNSOLICITED_SIZE 16    // the worst burst ahead of a response: a restart's three banner lines, and one of each event besides
+#endif
+
+template <typename S>
+class RakDeviceCommanderT {
+    RakDeviceTransceiverT<S> &_transceiver;
     RakDeviceEvent::Handler _eventHandler;
 
+    static inline constexpr size_t UNSOLICITED_MAXIMUM = RAKDEVICE_UNSOLICITED_SIZE;
+    RakDeviceQueue<String, UNSOLICITED_MAXIMUM> _unsolicited;    // arrived while awaiting a response, delivered in order once it is in
+    counter_t _interleaved = 0;
+
+    static bool isUnsolicited (const String &communique) {
+        return communique.startsWith ("+EVT:") || communique.startsWith ("+BC:") || communique.startsWith ("+PS:") || communique.startsWith ("Restricted_Wait_") || communique.startsWith ("Current Work Mode:") || communique == String ("RAKwireless RAK3272-SiP Example") || communique == String ("------------------------------------------------------");
+    }
+    void defer (const String &communique) {    // only once there is room: see receive ()
+        _interleaved++;
+        (void) _unsolicited.push (communique);
+    }
+    void deliver () {
+        while (! _unsolicited.empty ()) {
+            const String communique = _unsolicited.front ();    // popped first: a handler may issue commands, which deliver the rest
+            _unsolicited.pop ();
+            processUnsolicited (communique);
+        }
+    }
+    RakDeviceResult receive (String &response, const String &request, const unsigned long started) {    // the next line for this command, holding back unsolicited ones
+        while (true) {
+            if (_unsolicited.full ())    // reading on could only lose an event or deliver it out of order: the rest stays in the stream for process ()
+                return RakDeviceResult (false, String (request) + " unsolicited backlog");
+            const unsigned long elapsed = millis () - started;
+            if (elapsed >= RESPONSE_TIMEOUT || (response = _transceiver.readLine (true, RESPONSE_TIMEOUT - elapsed)).isEmpty ()) {
+                _timeouts++;
+                RAKDEVICE_LOG (COMMANDER, WARNING, "RakDeviceCommander::issue: response timeout (consecutive=%lu)\n", _timeouts);
+                return RakDeviceResult (false, String (request) + " response timeout");
+            }
+            responded ();
+            if (! isUnsolicited (response))
+                return RakDeviceResult (true);
+            defer (response);
+            if (response.startsWith ("Restricted_Wait_"))    // the module's answer to this command, as well as an event
+                return RakDeviceResult (false, String (request) + " restricted");
+        }
+    }
+    RakDeviceResult exchange (RakDeviceCommand &cmd, const String &request, const String &prefix) {    // send, and read until the response and its terminator, re-sending on AT_BUSY
+        int tries = 0;
+        wake ();
+        while (true) {
+            _transceiver.send ("AT" + request);
+            const unsigned long started = millis ();
+            String response;
+            do {
+                const RakDeviceResult received = receive (response, request, started);
+                if (! received.success)
+                    return received;
+            } while (response == "OK" && ! prefix.isEmpty ());    // left over from an earlier command
+            if (response == "AT_BUSY_ERROR") {
+                if (tries++ >= AT_BUSY_TRIES)
+                    return RakDeviceResult (false, String (request) + " AT_BUSY");
+                RAKDEVICE_LOG (COMMANDER, DEBUG, "RakDeviceCommander::issue: AT_BUSY, retry #%d\n", tries);
+                delay (AT_BUSY_DELAY);
+                continue;
+            }
+            const RakDeviceResult responseResult = cmd.responseSet (response);
+            if (! responseResult.success)
+                RAKDEVICE_LOG (COMMANDER, WARNING, "RakDeviceCommander::issue: invalid-response = <<%s>>\n", response.c_str ());
+            if (! prefix.isEmpty () && response.startsWith (prefix)) {    // a value, then OK or an error of its own: not to be left for the next command
+                String terminator;
+                const RakDeviceResult terminated = receive (terminator, request, started);
+                if (! terminated.success)
+                    return terminated;
+                if (terminator != "OK")
+                    return RakDeviceResult (false, String (request) + " terminated by '" + terminator + "'");
+            }
+            return responseResult;
+        }
+    }
+
+    interval_t _lastResponse = 0;
+    counter_t _timeouts = 0;    // consecutive
+    void responded () {
+        _lastResponse = millis ();
+        _timeouts = 0;
+    }
+    interval_t _wakeIdle = 0;
+    void wake () {    // the module in low power mode may lose the first character that wakes it, so let that be a newline
+        if (_wakeIdle > 0 && millis () - _lastResponse >= _wakeIdle)
+            _transceiver.poke ();
+    }
+
 public:
+    static inline constexpr uint32_t RESPONSE_TIMEOUT = 5000;
     static inline constexpr int AT_BUSY_DELAY = 10, AT_BUSY_TRIES = 3;
+    static inline constexpr size_t BATCH_MAXIMUM_SIZE = 8;
+    static inline constexpr uint32_t BATCH_WAIT_DELAY = 5;
 
-    RakDeviceCommander (RakDeviceTransceiver &transceiver, const RakDeviceEvent::Handler &eventHandler = nullptr) :
+    RakDeviceCommanderT (RakDeviceTransceiverT<S> &transceiver, const RakDeviceEvent::Handler &eventHandler = nullptr) :
         _transceiver (transceiver),
         _eventHandler (eventHandler) { }
 
     void process () {
+        deliver ();
         do {
             const String communique = _transceiver.readLine (false);
             if (communique.isEmpty ())
                 return;
+            responded ();
             if (communique != "OK" && communique != "AT_BUSY_ERROR")
                 processUnsolicited (communique);
         } while (true);
     }
 
+    bool probe (const uint32_t timeout) {
+        while (_transceiver.available ())    // discard anything left over, e.g. garbage from a baud rate change
+            (void) _transceiver.readLine (false, timeout);
+        wake ();
+        _transceiver.send ("AT");
+        const unsigned long started = millis ();
+        while (millis () - started < timeout) {
+            const String response = _transceiver.readLine (true, timeout - (millis () - started));
+            if (response == "OK") {
+                responded ();
+                return true;
+            }
+        }
+        return false;
+    }
+    interval_t lastResponse () const { return _lastResponse; }
+    void wakeAfterIdle (const interval_t idle) { _wakeIdle = idle; }    // 0 = never, the module is always listening
+    counter_t timeouts () const { return _timeouts; }
+    counter_t interleaved () const { return _interleaved; }    // unsolicited lines that arrived ahead of a response
+
     void processEvent (const RakDeviceEvent &event) {
         if (_eventHandler)
             _eventHandler (event);
@@ -371,43 +1426,261 @@ public:
             processEvent (RakDeviceEvent ("RestrictedWait", communique.substring (sizeof ("Restricted_Wait_") - 1)));
         else if (communique.startsWith ("Current Work Mode:"))
             processEvent (RakDeviceEvent ("CurrentWorkMode", communique.substring (sizeof ("Current Work Mode: ") - 1, communique.length () - 1)));
-        else if (communique == String ("------------------------------------------------------") || communique == String ("RAKwireless RAK3272-SiP Example"))
+        else if (communique == String ("RAKwireless RAK3272-SiP Example"))
+            processEvent (RakDeviceEvent ("Restart", communique));    // the module (re)started, expected or not
+        else if (communique == String ("------------------------------------------------------"))
             ;
         else {
-            RAKDEVICE_DEBUG_PRINTF ("RakDeviceCommander::processUnsolicited: unprocessable = <<%s>>\n", communique.c_str ());
+            RAKDEVICE_LOG (COMMANDER, WARNING, "RakDeviceCommander::processUnsolicited: unprocessable = <<%s>>\n", communique.c_str ());
             return false;
         }
         return true;
     }
 
     RakDeviceResult issue (RakDeviceCommand &cmd) {
-
+        // lines up to the response are demultiplexed: unsolicited ones are held back, in order, until the response is in
         process ();
 
         const RakDeviceResult validateResult = cmd.requestValidate ();
         if (! validateResult.success)
             return validateResult;
-        const String request = cmd.requestBuild ();
-        _transceiver.send ("AT" + request);
-        const String response = _transceiver.readLine (true);
-        int tries = 0;
-        while (true) {
-            const RakDeviceResult responseResult = cmd.responseSet (response);
-            if (! responseResult.success) {
-                if (response == "AT_BUSY_ERROR") {
-                    if (tries++ >= AT_BUSY_TRIES)
-                        return false;
-                    RAKDEVICE_DEBUG_PRINTF ("RakDeviceCommander::issue: AT_BUSY, retry #%d\n", tries);
-                    delay (AT_BUSY_DELAY);
+        const String request = cmd.requestBuild (), prefix = cmd.responsePrefix ();
+        const RakDeviceResult result = exchange (cmd, request, prefix);
+        deliver ();
+        return result;
+    }
+
+    RakDeviceResult issueBatch (RakDeviceCommand *const commands [], const size_t count, RakDeviceResult *const results = nullptr) {
+        // queries are written back-to-back and their responses matched by 'AT+XXX=' prefix, everything else falls back to issue ();
+        // each is done once its terminator is in, OK after the value or an error in its place, the module answering in order
+        if (count > BATCH_MAXIMUM_SIZE)
+            return RakDeviceResult (false, "batch has " + String (count) + " commands but must be at most " + String (BATCH_MAXIMUM_SIZE));
+
+        process ();
+
+        enum class Entry { QUEUED,
+                           SENT,
+                           ANSWERED,    // the value is in, its OK not yet
+                           BUSY,
+                           DONE };
+        Entry entries [BATCH_MAXIMUM_SIZE];
+        RakDeviceResult answers [BATCH_MAXIMUM_SIZE];
+        int tries [BATCH_MAXIMUM_SIZE] = { 0 };
+        RakDeviceResult result (true);
+        auto complete = [&] (const size_t i, const RakDeviceResult &entryResult) {
+            entries [i] = Entry::DONE;
+            if (results != nullptr)
+                results [i] = entryResult;
+            if (! entryResult.success && result.success)
+                result = entryResult;
+        };
+        for (size_t i = 0; i < count; i++) {
+            const RakDeviceResult validateResult = commands [i]->requestValidate ();
+            if (! validateResult.success)
+                complete (i, validateResult);
+            else if (commands [i]->responsePrefix ().isEmpty ())
+                complete (i, issue (*commands [i]));
+            else
+                entries [i] = Entry::QUEUED;
+        }
+
+        [[maybe_unused]] const unsigned long started = millis ();
+        size_t outstanding;
+        wake ();
+        do {
+            outstanding = 0;
+            for (size_t i = 0; i < count; i++)
+                if (entries [i] == Entry::QUEUED) {
+                    _transceiver.send ("AT" + commands [i]->requestBuild ());
+                    entries [i] = Entry::SENT;
+                    outstanding++;
+                }
+            unsigned long progress = millis ();    // each command has RESPONSE_TIMEOUT from the answer before it, as it would issued alone
+            const auto earliest = [&] (const bool answered) {    // the command the next terminator belongs to
+                size_t i = 0;
+                while (i < count && ! (entries [i] == Entry::SENT || (answered && entries [i] == Entry::ANSWERED)))
+                    i++;
+                return i;
+            };
+            bool backlog = false;
+            while (outstanding > 0 && millis () - progress < RESPONSE_TIMEOUT) {
+                if ((backlog = _unsolicited.full ()))    // as for issue (): the rest stays in the stream
+                    break;
+                if (! _transceiver.available ()) {
+                    delay (BATCH_WAIT_DELAY);
+                    continue;
+                }
+                const String response = _transceiver.readLine (false);
+                if (response.isEmpty ())
+                    continue;
+                responded ();
+                size_t i;
+                if (isUnsolicited (response)) {
+                    defer (response);
+                    continue;
+                }
+                progress = millis ();
+                if (response == "OK") {
+                    for (i = 0; i < count && entries [i] != Entry::ANSWERED; i++)
+                        ;
+                    if (i < count)
+                        complete (i, answers [i]), outstanding--;
+                } else if (response == "AT_BUSY_ERROR") {    // in place of a value: the earliest command still awaiting one goes again
+                    if ((i = earliest (false)) < count) {
+                        if (tries [i]++ >= AT_BUSY_TRIES)
+                            complete (i, RakDeviceResult (false, "AT_BUSY"));
+                        else
+                            entries [i] = Entry::BUSY;
+                        outstanding--;
+                    }
+                } else if (response.startsWith ("AT_")) {    // in place of a value, or of the OK after one
+                    if ((i = earliest (true)) < count)
+                        complete (i, RakDeviceResult (false, commands [i]->responsePrefix () + " " + response)), outstanding--;
                 } else {
-                    if (! processUnsolicited (response))    // typically restricted wait
-                        RAKDEVICE_DEBUG_PRINTF ("RakDeviceCommander::issue: invalid-response = <<%s>>\n", response.c_str ());
-                    return responseResult;
+                    for (i = 0; i < count && ! (entries [i] == Entry::SENT && response.startsWith (commands [i]->responsePrefix ())); i++)
+                        ;
+                    if (i < count)
+                        answers [i] = commands [i]->responseSet (response), entries [i] = Entry::ANSWERED;
+                    else
+                        RAKDEVICE_LOG (COMMANDER, WARNING, "RakDeviceCommander::issueBatch: invalid-response = <<%s>>\n", response.c_str ());
                 }
-            } else {
-                return true;
             }
+            bool busy = false;
+            if (outstanding > 0 && ! backlog)
+                _timeouts++;
+            for (size_t i = 0; i < count; i++)
+                if (entries [i] == Entry::SENT || entries [i] == Entry::ANSWERED)
+                    complete (i, RakDeviceResult (false, commands [i]->responsePrefix () + (backlog ? " unsolicited backlog" : " response timeout")));
+                else if (entries [i] == Entry::BUSY)
+                    entries [i] = Entry::QUEUED, busy = true;
+            if (! busy)
+                break;
+            RAKDEVICE_LOG (COMMANDER, DEBUG, "RakDeviceCommander::issueBatch: AT_BUSY, retry\n");
+            delay (AT_BUSY_DELAY);
+        } while (true);
+
+        RAKDEVICE_LOG (COMMANDER, DEBUG, "RakDeviceCommander::issueBatch: commands=%u, elapsed=%lu ms, success=%s\n", count, millis () - started, result.success ? "true" : "false");
+        deliver ();
+        return result;
+    }
+    template <typename... Commands>
+    RakDeviceResult issueBatch (Commands &...commands) {
+        RakDeviceCommand *const list [] = { &commands... };
+        return issueBatch (list, sizeof...(commands));
+    }
+};
+using RakDeviceCommander = RakDeviceCommanderT<Stream>;
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
+
+// The single way in to the commander from more than one task: one owner at a time, granted to the
+// most urgent class waiting and first come first served within a class. Ownership is re-entrant, as
+// event listeners run while it is held and often call back in. Deferrable work yields between steps.
+
+class RakDeviceArbiter {
+public:
+    enum class Priority {
+        TRANSMIT = 0,       // uplinks
+        CONTROL = 1,        // begin, end, suspend, resume
+        HOUSEKEEPING = 2    // process (): status, link check, time and join status polling, health
+    };
+    static inline constexpr size_t PRIORITY_COUNT = static_cast<size_t> (Priority::HOUSEKEEPING) + 1;
+    static String toString (const Priority priority) {
+        if (priority == Priority::TRANSMIT)
+            return "TRANSMIT";
+        else if (priority == Priority::CONTROL)
+            return "CONTROL";
+        else if (priority == Priority::HOUSEKEEPING)
+            return "HOUSEKEEPING";
+        else
+            return "UNKNOWN";
+    }
+    struct Stats {
+        counter_t grants = 0, yields = 0;
+        interval_t waitTotal = 0, waitMaximum = 0;    // queueing delay, from asking until granted
+        interval_t waitMean () const { return grants > 0 ? waitTotal / grants : 0; }
+    };
+
+    class Guard {
+        RakDeviceArbiter &_arbiter;
+
+    public:
+        Guard (RakDeviceArbiter &arbiter, const Priority priority) :
+            _arbiter (arbiter) { _arbiter.acquire (priority); }
+        ~Guard () { _arbiter.release (); }
+        Guard (const Guard &) = delete;
+        Guard &operator= (const Guard &) = delete;
+    };
+
+private:
+    mutable std::mutex _mutex;
+    std::condition_variable _released;
+    std::thread::id _owner;
+    size_t _depth = 0;
+    Priority _priority { Priority::HOUSEKEEPING };
+    std::array<counter_t, PRIORITY_COUNT> _ticketNext {}, _ticketServing {};    // per class, the difference is those waiting
+    std::array<Stats, PRIORITY_COUNT> _stats {};
+
+    bool waitingAbove (const Priority priority) const {
+        for (size_t above = 0; above < static_cast<size_t> (priority); above++)
+            if (_ticketNext [above] != _ticketServing [above])
+                return true;
+        return false;
+    }
+
+public:
+    void acquire (const Priority priority) {
+        std::unique_lock<std::mutex> lock (_mutex);
+        if (_depth > 0 && _owner == std::this_thread::get_id ()) {
+            _depth++;
+            return;
+        }
+        const size_t index = static_cast<size_t> (priority);
+        const counter_t ticket = _ticketNext [index]++;
+        const interval_t requested = millis ();
+        _released.wait (lock, [&] { return _depth == 0 && _ticketServing [index] == ticket && ! waitingAbove (priority); });
+        _ticketServing [index]++;
+        _owner = std::this_thread::get_id ();
+        _depth = 1;
+        _priority = priority;
+        const interval_t waited = millis () - requested;
+        Stats &stats = _stats [index];
+        stats.grants++;
+        stats.waitTotal += waited;
+        if (waited > stats.waitMaximum)
+            stats.waitMaximum = waited;
+    }
+    void release () {
+        {
+            std::lock_guard<std::mutex> guard (_mutex);
+            if (--_depth > 0)
+                return;
+            _owner = std::thread::id ();
+        }
+        _released.notify_all ();
+    }
+    bool yield () {    // hand over to anyone more urgent, then queue again: only at the outermost level, where nothing is half done
+        Priority priority;
+        {
+            std::lock_guard<std::mutex> guard (_mutex);
+            if (_depth != 1 || _owner != std::this_thread::get_id () || ! waitingAbove (_priority))
+                return false;
+            priority = _priority;
+            _stats [static_cast<size_t> (priority)].yields++;
         }
+        release ();
+        acquire (priority);
+        return true;
+    }
+
+    size_t waiting (const Priority priority) const {
+        std::lock_guard<std::mutex> guard (_mutex);
+        return _ticketNext [static_cast<size_t> (priority)] - _ticketServing [static_cast<size_t> (priority)];
+    }
+    Stats stats (const Priority priority) const {
+        std::lock_guard<std::mutex> guard (_mutex);
+        return _stats [static_cast<size_t> (priority)];
     }
 };
 
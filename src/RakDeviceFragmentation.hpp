@@ -0,0 +1,235 @@
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
+
+// Fragmented blob transport modelled on LoRaWAN Fragmented Data Block Transport (TS004): a session
+// setup message followed by data fragments and optional coded (parity) fragments. Only depends on
+// the standard library so that the reassembler can be built host side, e.g. behind a network server.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#ifndef RAKDEVICE_FIXED_CAPACITY
+#include <vector>
+#endif
+
+struct RakDeviceFragmentation {
+    static inline constexpr int DEFAULT_PORT = 201;
+    static inline constexpr uint8_t CID_SESSION_SETUP = 0x02, CID_DATA_FRAGMENT = 0x08;
+    static inline constexpr size_t SESSION_SETUP_SIZE = 10, DATA_FRAGMENT_HEADER_SIZE = 3;
+    static inline constexpr uint16_t MAXIMUM_FRAGMENTS = 0x3FFF;
+    static inline constexpr uint8_t MAXIMUM_SESSIONS = 4;
+
+    // SessionSetup:  CID, session, nbFrag (LE16), fragSize, padding, CRC32 of the blob (LE32)
+    // DataFragment:  CID, session << 14 | N (LE16, N from 1, N > nbFrag for coded fragments), payload
+    struct Session {
+        uint8_t session = 0;
+        uint16_t fragments = 0;
+        uint8_t fragmentSize = 0, padding = 0;
+        uint32_t crc = 0;
+    };
+
+    static uint32_t crc32 (const uint8_t *data, const size_t length, uint32_t crc = 0) {
+        crc = ~crc;
+        for (size_t i = 0; i < length; i++) {
+            crc ^= data [i];
+            for (int bit = 0; bit < 8; bit++)
+                crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+        return ~crc;
+    }
+
+    // TS004 parity matrix: which of the M data fragments are XORed into coded fragment N
+    static uint32_t prbs23 (const uint32_t x) {
+        const uint32_t b0 = x & 1, b1 = (x & 32) >> 5;
+        return (x >> 1) + ((b0 ^ b1) << 22);
+    }
+    template <typename Line>
+    static void matrixLine (Line &line, const uint32_t N, const uint32_t M) {    // std::vector<bool>, or a std::bitset of at least M
+        if constexpr (requires { line.assign (M, false); })
+            line.assign (M, false);
+        else
+            line.reset ();
+        const uint32_t m = (M & (M - 1)) == 0 ? 1 : 0;
+        uint32_t x = 1 + 1001 * N;
+        for (uint32_t coefficients = 0; coefficients < M / 2; coefficients++) {
+            uint32_t r = 1 << 16;
+            while (r >= M)
+                r = (x = prbs23 (x)) % (M + m);
+            line [r] = true;
+        }
+        if (M == 1)
+            line [0] = true;
+    }
+
+    static void encodeSession (uint8_t *buffer, const Session &session) {
+        buffer [0] = CID_SESSION_SETUP;
+        buffer [1] = session.session;
+        buffer [2] = session.fragments & 0xFF;
+        buffer [3] = session.fragments >> 8;
+        buffer [4] = session.fragmentSize;
+        buffer [5] = session.padding;
+        for (int i = 0; i < 4; i++)
+            buffer [6 + i] = (session.crc >> (8 * i)) & 0xFF;
+    }
+    static bool decodeSession (const uint8_t *buffer, const size_t length, Session &session) {
+        if (length != SESSION_SETUP_SIZE || buffer [0] != CID_SESSION_SETUP || buffer [1] >= MAXIMUM_SESSIONS)
+            return false;
+        session.session = buffer [1];
+        session.fragments = buffer [2] | (buffer [3] << 8);
+        session.fragmentSize = buffer [4];
+        session.padding = buffer [5];
+        session.crc = 0;
+        for (int i = 0; i < 4; i++)
+            session.crc |= static_cast<uint32_t> (buffer [6 + i]) << (8 * i);
+        return session.fragments > 0 && session.fragments <= MAXIMUM_FRAGMENTS && session.fragmentSize > 0 && session.padding < session.fragmentSize;
+    }
+    static void encodeFragmentHeader (uint8_t *buffer, const uint8_t session, const uint16_t index) {
+        const uint16_t indexAndN = (static_cast<uint16_t> (session) << 14) | (index & MAXIMUM_FRAGMENTS);
+        buffer [0] = CID_DATA_FRAGMENT;
+        buffer [1] = indexAndN & 0xFF;
+        buffer [2] = indexAndN >> 8;
+    }
+};
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
+
+#ifndef RAKDEVICE_FIXED_CAPACITY    // the reassembler grows with the blob it is given: host side, or a device with the heap to spare
+class RakDeviceDefragmenter {
+public:
+    enum class Result {
+        IGNORED,
+        ACCEPTED,
+        COMPLETE,
+        CORRUPT
+    };
+
+private:
+    RakDeviceFragmentation::Session _session;
+    bool _active = false, _complete = false;
+    std::vector<uint8_t> _data;                         // fragments * fragmentSize
+    std::vector<bool> _received;                        // per data fragment
+    std::vector<std::vector<bool>> _codedLines;         // outstanding coded fragments: coefficients
+    std::vector<std::vector<uint8_t>> _codedPayloads;    // ... and payloads
+    std::vector<uint16_t> _codedIndices;                // ... and which N each came as: at most fragments rows, repeats ignored
+    size_t _receivedCount = 0;
+
+    uint8_t *fragment (const size_t index) { return &_data [index * _session.fragmentSize]; }
+    static void xorInto (uint8_t *target, const uint8_t *source, const size_t length) {
+        for (size_t i = 0; i < length; i++)
+            target [i] ^= source [i];
+    }
+
+    void dropCoded (const size_t row) {
+        _codedLines.erase (_codedLines.begin () + row);
+        _codedPayloads.erase (_codedPayloads.begin () + row);
+        _codedIndices.erase (_codedIndices.begin () + row);
+    }
+    void store (const size_t index, const uint8_t *payload) {
+        memcpy (fragment (index), payload, _session.fragmentSize);
+        _received [index] = true;
+        _receivedCount++;
+    }
+    bool solve () {
+        // Gaussian elimination over GF(2), restricted to the data fragments still missing
+        const size_t fragmentSize = _session.fragmentSize;
+        for (size_t row = 0; row < _codedLines.size (); row++)
+            for (size_t column = 0; column < _session.fragments; column++)
+                if (_codedLines [row][column] && _received [column]) {
+                    xorInto (_codedPayloads [row].data (), fragment (column), fragmentSize);
+                    _codedLines [row][column] = false;
+                }
+        size_t pivotRow = 0;
+        std::vector<size_t> pivots;
+        for (size_t column = 0; column < _session.fragments && pivotRow < _codedLines.size (); column++) {
+            if (_received [column])
+                continue;
+            size_t row = pivotRow;
+            while (row < _codedLines.size () && ! _codedLines [row][column])
+                row++;
+            if (row == _codedLines.size ())
+                continue;
+            std::swap (_codedLines [row], _codedLines [pivotRow]);
+            std::swap (_codedPayloads [row], _codedPayloads [pivotRow]);
+            std::swap (_codedIndices [row], _codedIndices [pivotRow]);
+            for (size_t other = 0; other < _codedLines.size (); other++)
+                if (other != pivotRow && _codedLines [other][column]) {
+                    for (size_t c = 0; c < _session.fragments; c++)
+                        if (_codedLines [pivotRow][c])
+                            _codedLines [other][c] = ! _codedLines [other][c];
+                    xorInto (_codedPayloads [other].data (), _codedPayloads [pivotRow].data (), fragmentSize);
+                }
+            pivots.push_back (column);
+            pivotRow++;
+        }
+        while (_codedLines.size () > pivotRow)    // dependent, all zero by now: nothing left to tell, so they do not hold a row
+            dropCoded (_codedLines.size () - 1);
+        if (_receivedCount + pivots.size () < _session.fragments)
+            return false;
+        for (size_t row = 0; row < pivots.size (); row++)
+            store (pivots [row], _codedPayloads [row].data ());
+        _codedLines.clear ();
+        _codedPayloads.clear ();
+        _codedIndices.clear ();
+        return true;
+    }
+    Result finish () {
+        _complete = true;
+        const size_t length = size ();
+        return RakDeviceFragmentation::crc32 (_data.data (), length) == _session.crc ? Result::COMPLETE : Result::CORRUPT;
+    }
+
+public:
+    Result process (const uint8_t *message, const size_t length) {
+        RakDeviceFragmentation::Session session;
+        if (RakDeviceFragmentation::decodeSession (message, length, session)) {
+            _session = session;
+            _active = true;
+            _complete = false;
+            _data.assign (static_cast<size_t> (session.fragments) * session.fragmentSize, 0);
+            _received.assign (session.fragments, false);
+            _codedLines.clear ();
+            _codedPayloads.clear ();
+            _codedIndices.clear ();
+            _receivedCount = 0;
+            return Result::ACCEPTED;
+        }
+        if (! _active || _complete || length != RakDeviceFragmentation::DATA_FRAGMENT_HEADER_SIZE + _session.fragmentSize || message [0] != RakDeviceFragmentation::CID_DATA_FRAGMENT)
+            return Result::IGNORED;
+        const uint16_t indexAndN = message [1] | (message [2] << 8);
+        const uint16_t index = indexAndN & RakDeviceFragmentation::MAXIMUM_FRAGMENTS;
+        if ((indexAndN >> 14) != _session.session || index == 0)
+            return Result::IGNORED;
+        const uint8_t *payload = message + RakDeviceFragmentation::DATA_FRAGMENT_HEADER_SIZE;
+        if (index <= _session.fragments) {
+            if (_received [index - 1])
+                return Result::ACCEPTED;
+            store (index - 1, payload);
+        } else {
+            if (_codedLines.size () >= _session.fragments || std::find (_codedIndices.begin (), _codedIndices.end (), index) != _codedIndices.end ())
+                return Result::ACCEPTED;    // a repeat, or past what any solution needs
+            std::vector<bool> line;
+            RakDeviceFragmentation::matrixLine (line, index - _session.fragments, _session.fragments);
+            _codedLines.push_back (line);
+            _codedPayloads.emplace_back (payload, payload + _session.fragmentSize);
+            _codedIndices.push_back (index);
+        }
+        if (_receivedCount == _session.fragments)
+            return finish ();
+        if (_receivedCount + _codedLines.size () >= _session.fragments && solve ())
+            return finish ();
+        return Result::ACCEPTED;
+    }
+
+    bool isComplete () const { return _complete; }
+    size_t fragmentsReceived () const { return _receivedCount; }
+    size_t fragmentsExpected () const { return _session.fragments; }
+    size_t fragmentsCoded () const { return _codedLines.size (); }    // held until they solve, never more than fragmentsExpected ()
+    const uint8_t *data () const { return _data.data (); }
+    size_t size () const { return _data.size () - _session.padding; }
+};
+#endif
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
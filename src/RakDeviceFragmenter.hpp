@@ -0,0 +1,167 @@
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
+
+#include <bitset>
+
+#ifndef RAKDEVICE_FRAGMENTER_BLOB_SIZE
+#define RAKDEVICE_FRAGMENTER_BLOB_SIZE 2048    // with RAKDEVICE_FIXED_CAPACITY, the largest blob send () accepts
+#endif
+
+template <typename Device = RakDeviceManager>
+class RakDeviceFragmenterT {
+public:
+#ifdef RAKDEVICE_FIXED_CAPACITY
+    static inline constexpr size_t BLOB_MAXIMUM = RAKDEVICE_FRAGMENTER_BLOB_SIZE;
+    static inline constexpr size_t FRAGMENT_MINIMUM = RakDeviceRegion::payloadMinimum () - RakDeviceFragmentation::DATA_FRAGMENT_HEADER_SIZE;    // the slowest data rate of any region
+    static inline constexpr size_t FRAGMENTS_MAXIMUM = (BLOB_MAXIMUM + FRAGMENT_MINIMUM - 1) / FRAGMENT_MINIMUM;
+#endif
+
+    struct Config {
+        Lora::Port port { RakDeviceFragmentation::DEFAULT_PORT };
+        int redundancy { 10 };    // coded fragments, as a percentage of data fragments
+        interval_t pacing { 0 };  // between fragments, 0 = time on air for a 1% duty cycle
+    };
+    struct Stats {
+        size_t sessions = 0, fragments = 0, bytes = 0;
+        size_t aborted = 0;    // the data rate dropped below what the fragment size needs
+        interval_t elapsed = 0;
+        float throughput () const { return elapsed > 0 ? static_cast<float> (bytes) * 1000.0f / elapsed : 0.0f; }    // blob bytes sent per second: what the far end recovers depends on the loss, see test_fragmentation
+    };
+
+private:
+    using Messenger = RakDeviceMessengerT<Device>;
+    Messenger &_messenger;
+    const Device &_device;
+    const Config _config;
+
+#ifdef RAKDEVICE_FIXED_CAPACITY
+    struct Blob {
+        std::array<uint8_t, BLOB_MAXIMUM> data;
+        size_t length = 0;
+        size_t size () const { return length; }
+        uint8_t operator[] (const size_t i) const { return data [i]; }
+        void assign (const uint8_t *begin, const uint8_t *end) { length = end - begin, memcpy (data.data (), begin, length); }
+        void clear () { length = 0; }
+    } _blob;
+    using Line = std::bitset<FRAGMENTS_MAXIMUM>;
+#else
+    std::vector<uint8_t> _blob;
+    using Line = std::vector<bool>;
+#endif
+    RakDeviceFragmentation::Session _session;
+    uint16_t _next = 0, _total = 0;    // 0 = session setup, then data fragments, then coded fragments
+    interval_t _started = 0, _previous = 0, _pacing = 0;
+    bool _active = false;
+    uint8_t _sessionNext = 0;
+    Stats _stats;
+
+    static String toMessageData (const uint8_t *data, const size_t length) {
+        String result;
+        result.reserve (length);
+        result.concat (reinterpret_cast<const char *> (data), length);
+        return result;
+    }
+    void buildFragment (uint8_t *buffer, const uint16_t index) const {
+        const size_t fragmentSize = _session.fragmentSize;
+        RakDeviceFragmentation::encodeFragmentHeader (buffer, _session.session, index);
+        uint8_t *payload = buffer + RakDeviceFragmentation::DATA_FRAGMENT_HEADER_SIZE;
+        memset (payload, 0, fragmentSize);
+        auto xorFragment = [&] (const size_t fragment) {
+            const size_t offset = fragment * fragmentSize, length = std::min (fragmentSize, _blob.size () - offset);
+            for (size_t i = 0; i < length; i++)
+                payload [i] ^= _blob [offset + i];
+        };
+        if (index <= _session.fragments)
+            xorFragment (index - 1);
+        else {
+            Line line;
+            RakDeviceFragmentation::matrixLine (line, index - _session.fragments, _session.fragments);
+            for (size_t fragment = 0; fragment < _session.fragments; fragment++)
+                if (line [fragment])
+                    xorFragment (fragment);
+        }
+    }
+
+public:
+    RakDeviceFragmenterT (Messenger &messenger, const Device &device, const Config &config) :
+        _messenger (messenger),
+        _device (device),
+        _config (config) { }
+    RakDeviceFragmenterT (Messenger &messenger, const Device &device) :
+        RakDeviceFragmenterT (messenger, device, Config ()) { }
+
+    bool send (const uint8_t *data, const size_t length) {
+        if (_active || length == 0)
+            return false;
+#ifdef RAKDEVICE_FIXED_CAPACITY
+        if (length > BLOB_MAXIMUM)
+            return false;
+#endif
+        const RakDeviceRegion &region = _device.region ();
+        const Lora::Datarate dataRate = _device.status ().dataRate;
+        if (region.maximumPayloadSize (dataRate) <= static_cast<int> (RakDeviceFragmentation::DATA_FRAGMENT_HEADER_SIZE))
+            return false;
+        const size_t fragmentSize = region.maximumPayloadSize (dataRate) - RakDeviceFragmentation::DATA_FRAGMENT_HEADER_SIZE;
+        const size_t fragments = (length + fragmentSize - 1) / fragmentSize, coded = (fragments * _config.redundancy + 99) / 100;
+        if (fragments + coded > RakDeviceFragmentation::MAXIMUM_FRAGMENTS)
+            return false;
+#ifdef RAKDEVICE_FIXED_CAPACITY
+        if (fragments > FRAGMENTS_MAXIMUM)    // the coding line's bitset
+            return false;
+#endif
+        _blob.assign (data, data + length);
+        _session = { .session = _sessionNext, .fragments = static_cast<uint16_t> (fragments), .fragmentSize = static_cast<uint8_t> (fragmentSize), .padding = static_cast<uint8_t> (fragments * fragmentSize - length), .crc = RakDeviceFragmentation::crc32 (data, length) };
+        _sessionNext = (_sessionNext + 1) % RakDeviceFragmentation::MAXIMUM_SESSIONS;
+        _next = 0;
+        _total = static_cast<uint16_t> (fragments + coded);
+        _pacing = _config.pacing > 0 ? _config.pacing : region.timeOnAir (dataRate, fragmentSize + RakDeviceFragmentation::DATA_FRAGMENT_HEADER_SIZE) * 100;
+        _started = millis ();
+        _previous = _started - _pacing;
+        _active = true;
+        RAKDEVICE_LOG (FRAGMENTER, INFO, "RakDeviceFragmenter: session=%u, size=%u, fragments=%u+%u, fragmentSize=%u, pacing=%lu ms\n", _session.session, length, fragments, coded, fragmentSize, _pacing);
+        return true;
+    }
+    inline bool send (const String &data) {
+        return send (reinterpret_cast<const uint8_t *> (data.c_str ()), data.length ());
+    }
+
+    void process () {
+        if (! _active || _messenger.transmit_queue_size () > 0 || millis () - _previous < _pacing)
+            return;
+        if (_next > _total) {
+            _active = false;
+            _stats.sessions++;
+            _stats.bytes += _blob.size ();
+            _stats.elapsed += millis () - _started;
+            RAKDEVICE_LOG (FRAGMENTER, INFO, "RakDeviceFragmenter: session=%u complete, throughput=%.2f bytes/s\n", _session.session, _stats.throughput ());
+            _blob.clear ();
+            return;
+        }
+        const size_t fragmentLength = RakDeviceFragmentation::DATA_FRAGMENT_HEADER_SIZE + _session.fragmentSize;
+        if (_next > 0 && fragmentLength > _device.maximumPayloadSize ()) {    // sized at the data rate when sent, the link optimiser or ADR has lowered it since
+            _active = false;
+            _stats.aborted++;
+            RAKDEVICE_LOG (FRAGMENTER, WARNING, "RakDeviceFragmenter: session=%u aborted at fragment %u, %u bytes exceeds %u\n", _session.session, _next, fragmentLength, _device.maximumPayloadSize ());
+            _blob.clear ();
+            return;
+        }
+        uint8_t buffer [RakDeviceFragmentation::DATA_FRAGMENT_HEADER_SIZE + RakDeviceRegion::payloadMaximum ()];
+        size_t length;
+        if (_next == 0)
+            RakDeviceFragmentation::encodeSession (buffer, _session), length = RakDeviceFragmentation::SESSION_SETUP_SIZE;
+        else
+            buildFragment (buffer, _next), length = fragmentLength;
+        _messenger.transmit (typename Messenger::Message (_config.port, toMessageData (buffer, length)));
+        _stats.fragments++;
+        _next++;
+        _previous = millis ();
+    }
+
+    bool isActive () const { return _active; }
+    const Stats &stats () const { return _stats; }
+};
+using RakDeviceFragmenter = RakDeviceFragmenterT<RakDeviceManager>;
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
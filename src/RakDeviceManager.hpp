@@ -2,13 +2,38 @@
 // -----------------------------------------------------------------------------------------------
 // -----------------------------------------------------------------------------------------------
 
-class RakDeviceManager {
+#ifndef RAKDEVICE_RETAINED
+#define RAKDEVICE_RETAINED    // e.g. RTC_NOINIT_ATTR, to survive warm restarts
+#endif
+
+struct RakDeviceRetained {
+    static inline constexpr uint32_t MAGIC = 0x52414B33;
+    uint32_t magic, baudRate;
+};
+inline RAKDEVICE_RETAINED RakDeviceRetained rakDeviceRetained;    // one for the program: with more than one module, give each its own in ConfigSerial::retained
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
+
+template <typename S = Stream>
+class RakDeviceManagerT {
 public:
-    static inline constexpr uint32_t TRANSMIT_AWAIT_CONFIRMATION_DELAY = 100;
+    static inline constexpr uint32_t TRANSMIT_CONFIRMATION_POLL = 10;    // between process () calls while a caller waits on a confirmation
+    static inline constexpr size_t RECEIVE_POOL_SIZE = 8;
+    static inline constexpr size_t HISTORY_SIZE = 32;
+    static inline constexpr size_t MAXIMUM_EVENT_LISTENERS = 8;
+    static inline constexpr size_t MAXIMUM_EVENT_ARGS = 2;
+    static inline constexpr size_t SCHEDULER_SIZE = 16;    // the manager's own timers, plus those of the messenger and the application
+    static inline constexpr counter_t HEALTH_TIMEOUTS_MAXIMUM = 2;    // consecutive response timeouts before the module is considered unresponsive
+    static inline constexpr uint32_t HEALTH_PROBE_TIMEOUT = 1000, RESET_SETTLE_DELAY = 2000;
+    static inline constexpr uint32_t WAKE_PROBE_TIMEOUT = 50;    // per AT probe while waking: the first may be lost to the wake up itself
+    static inline constexpr uint32_t BAUDRATE_DEFAULT = 115200, BAUDRATE_SETTLE_DELAY = 50, BAUDRATE_PROBE_TIMEOUT = 500;
+    static inline constexpr const auto &BAUDRATES = Lora::BAUDRATES;
 
     struct ConfigLoraOperation {
         Lora::Mode mode = Lora::Mode::MODE_LORAWAN;
         Lora::Band band = Lora::Band::BAND_EU868;
+        int subBand = 0;    // US915 and AU915: 1 to 8, the gateway's 8 channels, 0 = leave the channel mask alone
         Lora::Class clazz = Lora::Class::CLASS_A;
         Lora::Join join = Lora::Join::JOIN_OTAA;
     };
@@ -28,6 +53,26 @@ public:
         Lora::Datarate rx2DataRate { Lora::Datarate::SF12 };
         int joinAttemptsDelay { 10 };
         int joinAttemptsNumber { 8 };
+        int pingSlotPeriodicity { 2 };    // Class B, ping every 2^n seconds
+    };
+    struct ConfigSerial {
+        uint32_t baudRate { 0 };                            // negotiated during begin (), 0 = keep BAUDRATE_DEFAULT
+        RakDeviceRetained *retained { &rakDeviceRetained };    // where the negotiated rate survives a warm restart, one per module
+#ifdef RAKDEVICE_FIXED_CAPACITY
+        void (*baudRateApply) (uint32_t) = nullptr;    // reconfigures the host side, e.g. HardwareSerial::updateBaudRate
+#else
+        std::function<void (uint32_t)> baudRateApply;    // reconfigures the host side, e.g. HardwareSerial::updateBaudRate
+#endif
+    };
+    struct ConfigPower {
+        bool lowPowerMode { true };                      // AT+LPM=1, the module stops between commands by itself
+        interval_t lowPowerWakeIdle { 1000 };            // ... so a newline goes ahead of the first command after this long quiet
+        bool sleepAutomatic { false };                   // Class A, joined: AT+SLEEP=<ms> whenever idle, until just before the next timed work
+        interval_t sleepMinimum { 5 * 1000 };            // not worth sleeping for less
+        interval_t sleepMaximum { 60 * 60 * 1000 };
+        interval_t sleepMargin { 20 };                   // awake again this much ahead of the deadline
+        interval_t wakeTimeout { 500 };                  // probing for readiness, after which waking has failed
+        bool resumeOnTransmit { true };                  // a transmit while suspended resumes first, rather than failing
     };
     struct Config {
         ConfigLoraOperation loraOperation;
@@ -37,7 +82,32 @@ public:
         interval_t rejoinInterval { 4 * 60 * 1000 };
         interval_t statusInterval { 1 * 60 * 1000 };
         interval_t linkCheckInterval { 2 * 60 * 1000 };
-        interval_t networkTimeInterval { 30 * 60 * 1000 };
+        interval_t networkTimeInterval { 30 * 60 * 1000 };           // TIMEREQ, shortest, while the drift is unknown
+        interval_t networkTimeIntervalMaximum { 24 * 60 * 60 * 1000 };    // ... and longest, once it is measured
+        interval_t networkTimeTolerance { 2 * 1000 };                     // clock error to allow for between TIMEREQs
+        interval_t beaconAcquireTimeout { 5 * 60 * 1000 };    // Class B, beacon period is 128 seconds
+        interval_t beaconRetryInterval { 15 * 60 * 1000 };    // Class B, after falling back to Class A
+        interval_t healthInterval { 60 * 1000 };               // health checks, and a probe when the module has been quiet this long
+        interval_t joinPendingMaximum { 30 * 60 * 1000 };      // before a join that never resolves is treated as a fault
+        interval_t transmitConfirmationTimeout { 30 * 1000 };    // AT+SEND until SEND_CONFIRMED_OK/FAILED (or TX_DONE), after which the uplink has failed
+
+        ConfigSerial serial;
+        ConfigPower power;
+        RakDeviceLinkOptimiser::Config linkOptimiser;    // when enabled, module ADR is turned off
+        RakDeviceChannelHealth::Config channelHealth;
+        RakDeviceJoinEngine::Config joinEngine;    // when enabled, rejoinInterval and the module's own join reattempts are not used
+        RakDeviceEnergyModel::Config energy;
+        RakDeviceCommand_P2P::Parameters p2p { .frequency = 0, .spreadingFactor = 7, .bandwidth = 125, .codingRate = 0, .preamble = 8, .txPower = 14 };    // MODE_P2PLORA, frequency 0 = the band's default P2P channel
+    };
+    struct ConfigDelta {    // reconfigure (): only what is set changes; band and mode need a new manager, the region tables follow the band
+        std::optional<int> subBand;
+        std::optional<Lora::Join> join;
+        std::optional<String> devEUI, appEUI, appKey;
+        std::optional<bool> confirmMode, dutyCycle, adaptiveDataRate, publicNetworkMode;
+        std::optional<Lora::Datarate> dataRate, rx2DataRate;
+        std::optional<Lora::TxPower> txPower;
+        std::optional<int> rx1Delay, rx2Delay, joinAttemptsDelay, joinAttemptsNumber;
+        std::optional<interval_t> rejoinInterval, statusInterval, linkCheckInterval, networkTimeInterval, healthInterval, transmitConfirmationTimeout;
     };
 
     enum class State {
@@ -46,7 +116,8 @@ public:
         SUSPENDED = 2,
         JOIN_PENDING = 3,
         JOIN_SUCCESS = 4,
-        JOIN_FAILURE = 5
+        JOIN_FAILURE = 5,
+        P2P_READY = 6
     };
     static String toString (const State state) {
         if (state == State::UNINITIALISED)
@@ -61,6 +132,8 @@ public:
             return "JOIN_SUCCESS";
         else if (state == State::JOIN_FAILURE)
             return "JOIN_FAILURE";
+        else if (state == State::P2P_READY)
+            return "P2P_READY";
         else
             return "UNKNOWN";
     }
@@ -70,139 +143,328 @@ public:
         JOIN_SUCCESS,
         JOIN_FAILURE,
         DATA_RECEIVED,
-        TRANSMIT_SUCCESS,
-        TRANSMIT_FAILURE,
+        TRANSMIT_SUCCESS,    // uplink sequence, and milliseconds from AT+SEND to its confirmation
+        TRANSMIT_FAILURE,    // ... likewise, or "timeout" for the latter when none arrived
         NETWORK_TIME,
         STATUS_LINK,
         STATUS_RECEIVE,
         STATUS_CHANNEL,
+        STATUS_CLASS,
+        STATUS_HEALTH,
+    };
+    static inline constexpr size_t EVENT_COUNT = static_cast<size_t> (Event::STATUS_HEALTH) + 1;
+    using EventMask = uint32_t;
+    static constexpr EventMask eventMask (const Event event) { return 1UL << static_cast<int> (event); }
+    template <typename... Events>
+    static constexpr EventMask eventMask (const Event event, const Events... events) { return eventMask (event) | eventMask (events...); }
+    static inline constexpr EventMask EVENTS_ALL = (1UL << EVENT_COUNT) - 1;
+    struct Downlink {    // data is a pool buffer, owned by whoever receive ()d it until release ()d
+        Lora::Port port = 0;
+        Lora::Window window = Lora::Window::RX_1;
+        Lora::RSSI RSSI = 0;
+        Lora::SNR SNR = 0;
+        interval_t timestamp = 0;
+        const uint8_t *data = nullptr;
+        size_t length = 0;
+    };
+    enum class Confirmation {
+        NONE,
+        PENDING,
+        CONFIRMED,    // +EVT:SEND_CONFIRMED_OK
+        FAILED,       // +EVT:SEND_CONFIRMED_FAILED
+        SENT,         // +EVT:TX_DONE, unconfirmed uplinks
+        TIMEOUT,      // nothing within transmitConfirmationTimeout
+        SUPERSEDED    // another uplink went out before this one's outcome was known, or read: the module reports only on the latest
     };
-    using EventHandlerId = size_t;
+    static String toString (const Confirmation confirmation) {
+        if (confirmation == Confirmation::NONE)
+            return "NONE";
+        else if (confirmation == Confirmation::PENDING)
+            return "PENDING";
+        else if (confirmation == Confirmation::CONFIRMED)
+            return "CONFIRMED";
+        else if (confirmation == Confirmation::FAILED)
+            return "FAILED";
+        else if (confirmation == Confirmation::SENT)
+            return "SENT";
+        else if (confirmation == Confirmation::TIMEOUT)
+            return "TIMEOUT";
+        else if (confirmation == Confirmation::SUPERSEDED)
+            return "SUPERSEDED";
+        else
+            return "UNKNOWN";
+    }
+    struct Uplink {    // the latest: the module has only one in flight
+        counter_t sequence = 0;
+        Lora::Port port = 0;
+        bool confirmed = false;    // sent as a confirmed uplink
+        interval_t sent = 0, resolved = 0;
+        Confirmation confirmation { Confirmation::NONE };
+        interval_t elapsed () const { return resolved - sent; }
+    };
+
+    using EventHandlerId = size_t;    // 0 = not registered, no free slot
+#ifdef RAKDEVICE_FIXED_CAPACITY
+    using EventArgs = RakDeviceVector<String, MAXIMUM_EVENT_ARGS>;
+#else
     using EventArgs = std::vector<String>;
     using EventHandler = std::function<void (const Event, const EventArgs &args)>;
-    EventHandlerId addEventListener (const EventHandler &handler) {
-        EventHandlerId id = _nextHandlerId++;
-        _eventHandlers [id] = handler;
-        return id;
+#endif
+    using EventFunction = void (*) (const Event, const EventArgs &args);
+    EventHandlerId addEventListener (const EventFunction function, const EventMask mask = EVENTS_ALL) {
+        return addEventListener (EventListener { .function = function }, mask);
+    }
+#ifndef RAKDEVICE_FIXED_CAPACITY
+    template <typename Handler>
+        requires (! std::is_convertible_v<Handler, EventFunction>)
+    EventHandlerId addEventListener (Handler &&handler, const EventMask mask = EVENTS_ALL) {    // capturing lambdas, std::function
+        return addEventListener (EventListener { .handler = EventHandler (std::forward<Handler> (handler)) }, mask);
+    }
+#endif
+    template <typename T, void (T::*METHOD) (const Event, const EventArgs &)>
+    EventHandlerId addEventListener (T *object, const EventMask mask = EVENTS_ALL) {    // bound member, no std::function
+        return addEventListener (EventListener { .method = [] (void *context, const Event event, const EventArgs &args) { (static_cast<T *> (context)->*METHOD) (event, args); }, .context = object }, mask);
+    }
+    template <typename... Listeners>
+    static void dispatchEventListeners (const Event event, const EventArgs &args) {
+        ((Listeners::EVENTS & eventMask (event) ? Listeners::onEvent (event, args) : void ()), ...);
+    }
+    template <typename... Listeners>
+    EventHandlerId addEventListeners () {    // each with static EventMask EVENTS and static void onEvent (Event, const EventArgs &), called directly
+        return addEventListener (&dispatchEventListeners<Listeners...>, (Listeners::EVENTS | ... | 0));
     }
     void removeEventListener (const EventHandlerId id) {
-        _eventHandlers.erase (id);
+        for (size_t slot = 0; slot < MAXIMUM_EVENT_LISTENERS; slot++)
+            if (_eventListeners [slot].id == id && id != 0) {
+                _eventListeners [slot] = EventListener ();
+                for (auto &subscribers : _eventSubscribers)
+                    subscribers &= ~(1UL << slot);
+            }
     }
+    bool hasEventListeners (const Event event) const { return _eventSubscribers [static_cast<size_t> (event)] != 0; }
 
     struct Status {
         using Channels = RakDeviceCommand_RSSI_ALL::ChannelsRSSI;
         static String toString (const Channels &status) {
             String result;
-            for (const auto &[channel, RSSI] : status)
-                result += (result.isEmpty () ? "" : ",") + String (channel) + ":" + String (RSSI);
+            for (int channel = 0; channel < Lora::MAXIMUM_CHANNELS; channel++)
+                if (status.has (channel))
+                    result += (result.isEmpty () ? "" : ",") + String (channel) + ":" + String (status.RSSI [channel]);
             return result;
         }
 
         String version, hardware, serialno, apiversion, hardwareid;
 
+        uint32_t baudRate = BAUDRATE_DEFAULT;
+        struct TransmitTiming {
+            counter_t count = 0;
+            interval_t total = 0, maximum = 0;
+        };
+#ifdef RAKDEVICE_FIXED_CAPACITY
+        RakDeviceMap<uint32_t, TransmitTiming, std::size (BAUDRATES)> transmitTiming;    // UART time per uplink, AT+SEND until its response, by baud rate
+#else
+        std::map<uint32_t, TransmitTiming> transmitTiming;    // UART time per uplink, AT+SEND until its response, by baud rate
+#endif
+
         String devAddr;
+        Lora::Datarate dataRate { Lora::Datarate::SF12 };
+        Lora::TxPower txPower { Lora::TxPower::HIGHEST };
 
-        TrackableValue<String> networkTime;
+        TrackableValue<uint64_t> networkTime;    // epoch milliseconds, at the last sync
         TrackableValue<bool> transmitConfirmation;
+        struct Confirmations {    // time to confirmation, AT+SEND until SEND_CONFIRMED_OK/FAILED or TX_DONE
+            counter_t confirmed = 0, failed = 0, sent = 0, timeouts = 0, late = 0;    // late: after a timeout, or for no uplink of ours
+            counter_t superseded = 0;                                                  // replaced while still pending
+            interval_t total = 0, maximum = 0;
+            interval_t mean () const { return confirmed + failed + sent > 0 ? total / (confirmed + failed + sent) : 0; }
+        } confirmations;
         TrackableValue<Lora::ReceiveStatus> receiveStatus;
         TrackableValue<Lora::LinkStatus> linkStatus;
         TrackableValue<Channels> channelStatus;
+        TrackableValue<Lora::Class> deviceClass;
+        struct P2P {
+            counter_t transmits = 0, receives = 0, turnarounds = 0;
+            size_t bytesTransmitted = 0, bytesReceived = 0;
+            interval_t airtimeTotal = 0, turnaroundTotal = 0, turnaroundMaximum = 0;    // PSEND to TXP2P DONE, TXP2P DONE to receive re-armed
+        } p2p;
+        Lora::ClassB_Status beaconStatus { Lora::ClassB_Status::DEVICETIME_REQ };
+        struct History {    // most recent HISTORY_SIZE samples of each, with statistics kept up to date as they arrive
+            RakDeviceSeries<HISTORY_SIZE> receiveRSSI, receiveSNR;
+            RakDeviceSeries<HISTORY_SIZE> linkRSSI, linkSNR, linkMargin, linkGateways;
+            RakDeviceSeries<HISTORY_SIZE> channelRSSI;    // mean across channels reporting
+            RakDeviceSeries<HISTORY_SIZE> transmitConfirmation;    // milliseconds to confirmation
+        } history;
+        struct Health {
+            counter_t faults = 0, recoveries = 0, failures = 0;                        // failures: attempts that did not restore service
+            counter_t probes = 0, resets = 0, reinitialisations = 0, settingsSkipped = 0;    // by tier, and settings already correct at re-init
+            interval_t recoveryTotal = 0, recoveryMaximum = 0;                          // from detection until serviceable again
+            String lastFault;
+            interval_t mttr () const { return recoveries > 0 ? recoveryTotal / recoveries : 0; }
+        } health;
+        struct Power {
+            counter_t sleeps = 0, wakes = 0, wakeFailures = 0, uplinksAfterWake = 0;    // wakes: those that had to rouse the module, not sleeps that ran out
+            interval_t sleepTotal = 0;
+            interval_t wakeLatencyLast = 0, wakeLatencyTotal = 0, wakeLatencyMaximum = 0;       // from starting to wake until the module answers
+            interval_t wakeToUplinkLast = 0, wakeToUplinkTotal = 0, wakeToUplinkMaximum = 0;    // ... until the first uplink after it is accepted
+            interval_t wakeLatencyMean () const { return wakes > 0 ? wakeLatencyTotal / wakes : 0; }
+            interval_t wakeToUplinkMean () const { return uplinksAfterWake > 0 ? wakeToUplinkTotal / uplinksAfterWake : 0; }
+        } power;
     };
 
 private:
-    const Config _config;
-    RakDeviceTransceiver _transceiver;
-    RakDeviceCommander _commander;
+    Config _config;    // changed only through reconfigure ()
+    const RakDeviceRegion &_region;
+    RakDeviceTransceiverT<S> _transceiver;
+    RakDeviceCommanderT<S> _commander;
+    RakDeviceArbiter _arbiter;    // in front of _commander: every public entry point that may issue holds it
     Status _status;
 
+    struct EventListener {    // exactly one of function, method (with context) or handler is set
+        EventHandlerId id = 0;
+        EventFunction function = nullptr;
+        void (*method) (void *context, const Event, const EventArgs &) = nullptr;
+        void *context = nullptr;
+#ifndef RAKDEVICE_FIXED_CAPACITY
+        EventHandler handler;
+#endif
+    };
     EventHandlerId _nextHandlerId = 1;
-    std::map<EventHandlerId, EventHandler> _eventHandlers;
+    std::array<EventListener, MAXIMUM_EVENT_LISTENERS> _eventListeners;
+    std::array<uint32_t, EVENT_COUNT> _eventSubscribers {};    // per event, a bit for each interested listener slot
+    EventHandlerId addEventListener (EventListener &&listener, const EventMask mask) {
+        for (size_t slot = 0; slot < MAXIMUM_EVENT_LISTENERS; slot++)
+            if (_eventListeners [slot].id == 0) {
+                listener.id = _nextHandlerId++;
+                _eventListeners [slot] = std::move (listener);
+                for (size_t event = 0; event < EVENT_COUNT; event++)
+                    if (mask & (1UL << event))
+                        _eventSubscribers [event] |= 1UL << slot;
+                return _eventListeners [slot].id;
+            }
+        RAKDEVICE_LOG (MANAGER, WARNING, "RakDeviceManager::addEventListener: no free slot (maximum=%u)\n", MAXIMUM_EVENT_LISTENERS);
+        return 0;
+    }
     void notifyEventListeners (const Event event, const EventArgs &args) {
-        for (const auto &[id, handler] : _eventHandlers)
-            if (handler)
-                handler (event, args);
+        for (uint32_t subscribers = _eventSubscribers [static_cast<size_t> (event)]; subscribers != 0; subscribers &= subscribers - 1) {
+            const EventListener &listener = _eventListeners [__builtin_ctz (subscribers)];
+            if (listener.function)
+                listener.function (event, args);
+            else if (listener.method)
+                listener.method (listener.context, event, args);
+#ifndef RAKDEVICE_FIXED_CAPACITY
+            else if (listener.handler)
+                listener.handler (event, args);
+#endif
+        }
     }
 
     State _state { State::UNINITIALISED }, _stateSuspended;
+    bool _asleep = false, _dozing = false;    // asleep: after AT+SLEEP, dozing: one the manager started itself, while joined
+    interval_t _sleepStarted = 0, _sleepUntil = 0, _wokeAt = 0;    // _sleepUntil 0 = until woken
+
+public:
+    using Scheduler = RakDeviceScheduler<SCHEDULER_SIZE>;
+
+private:
+    Scheduler _scheduler;
+    Scheduler::TimerId _timerNetworkRestriction;
+    Scheduler::TimerId _timerRejoin;
+    Scheduler::TimerId _timerStatus, _timerLinkCheck, _timerNetworkTime;
+    Scheduler::TimerId _timerBeaconAcquire, _timerBeaconRetry;
+    Scheduler::TimerId _timerHealth, _timerRecover;
+    Scheduler::TimerId _timerTransmitConfirmation;
+
+    enum class Fault {
+        NONE,
+        UNRESPONSIVE,    // response timeouts, or no answer to a probe
+        RESTARTED,       // banner while in service, the module reset itself
+        STUCK            // JOIN_PENDING for longer than joinPendingMaximum
+    } _fault { Fault::NONE };
+    interval_t _faultDetected = 0, _joinPendingSince = 0;
+    bool _recovering = false;
+
+    RakDeviceClock _clock;
+
+    Uplink _uplink, _uplinkPrevious;    // the one before, as it stood when replaced
 
-    Intervalable _networkRestriction;
+    bool _p2pTransmitting = false, _p2pReceiving = false;
+    interval_t _p2pTransmitStarted = 0, _p2pTransmitDone = 0;
 
-    Intervalable _intervalRejoin;
-    Intervalable _intervalStatus, _intervalLinkCheck, _intervalNetworkTime;
+    RakDeviceLinkOptimiser _linkOptimiser;
+    RakDeviceChannelHealth _channelHealth;
+    RakDeviceJoinEngine _joinEngine;
+    RakDeviceEnergyModel _energy;
 
-    ActivationTracker _transmitCounter, _receiveCounter;
+    RakDeviceBufferPool<RECEIVE_POOL_SIZE, Lora::MAXIMUM_RECEIVE_SIZE> _receivePool;
+    RakDeviceQueue<Downlink, RECEIVE_POOL_SIZE> _receiveQueue;
+    mutable std::mutex _receiveMutex;
+
+    ActivationTracker _transmitCounter, _receiveCounter, _receiveDropped;
     ActivationTracker _transmitSuccesses, _transmitFailures;
 
 public:
-    RakDeviceManager (const Config &config, Stream &stream) :
+    RakDeviceManagerT (const Config &config, S &stream) :
         _config (config),
+        _region (RakDeviceRegion::of (config.loraOperation.band)),
         _transceiver (stream),
-        _commander (_transceiver, [this] (const RakDeviceEvent &event) { events (event); }),
-        _intervalRejoin (config.rejoinInterval),
-        _intervalStatus (config.statusInterval),
-        _intervalLinkCheck (config.linkCheckInterval),
-        _intervalNetworkTime (config.networkTimeInterval) { }
-    ~RakDeviceManager () {
+        _commander (_transceiver, RakDeviceEvent::bind<RakDeviceManagerT, &RakDeviceManagerT::events> (this)),
+        _timerNetworkRestriction (_scheduler.add<RakDeviceManagerT, &RakDeviceManagerT::timerNetworkRestriction> (this)),
+        _timerRejoin (_scheduler.add<RakDeviceManagerT, &RakDeviceManagerT::timerRejoin> (this)),
+        _timerStatus (_scheduler.add<RakDeviceManagerT, &RakDeviceManagerT::timerStatus> (this)),
+        _timerLinkCheck (_scheduler.add<RakDeviceManagerT, &RakDeviceManagerT::timerLinkCheck> (this)),
+        _timerNetworkTime (_scheduler.add<RakDeviceManagerT, &RakDeviceManagerT::timerNetworkTime> (this)),
+        _timerBeaconAcquire (_scheduler.add<RakDeviceManagerT, &RakDeviceManagerT::timerBeaconAcquire> (this)),
+        _timerBeaconRetry (_scheduler.add<RakDeviceManagerT, &RakDeviceManagerT::timerBeaconRetry> (this)),
+        _timerHealth (_scheduler.add<RakDeviceManagerT, &RakDeviceManagerT::timerHealth> (this)),
+        _timerRecover (_scheduler.add<RakDeviceManagerT, &RakDeviceManagerT::timerRecover> (this)),
+        _timerTransmitConfirmation (_scheduler.add<RakDeviceManagerT, &RakDeviceManagerT::timerTransmitConfirmation> (this)),
+        _linkOptimiser (config.linkOptimiser, _region, config.loraParameters.dataRate, config.loraParameters.txPower),
+        _channelHealth (config.channelHealth),
+        _joinEngine (config.joinEngine, _region),
+        _energy (config.energy, _region) {
+        _commander.wakeAfterIdle (config.power.lowPowerMode ? config.power.lowPowerWakeIdle : 0);
+    }
+    ~RakDeviceManagerT () {
         end ();
     }
 
     //
 
+    using Priority = RakDeviceArbiter::Priority;
+
     bool begin () {
+        RakDeviceArbiter::Guard guard (_arbiter, Priority::CONTROL);
         if (_state != State::UNINITIALISED)
             return false;
 
+        if (! baudRateEstablish ())
+            return false;
+        if (_config.serial.baudRate != 0 && _config.serial.baudRate != _status.baudRate)
+            (void) baudRateNegotiate (_config.serial.baudRate);
+        _scheduler.start (_timerHealth, _config.healthInterval, _config.healthInterval);
+
         RakDeviceCommand_VERSION commandVersion;
         RakDeviceCommand_HWMODEL commandHardware;
         RakDeviceCommand_HWID commandHardwareId;
         RakDeviceCommand_SERIALNO commandSerialNo;
         RakDeviceCommand_APIVERSION commandApiVersion;
-        if (! _commander.issue (commandVersion).success || ! _commander.issue (commandHardware).success || ! _commander.issue (commandHardwareId).success || ! _commander.issue (commandSerialNo).success || ! _commander.issue (commandApiVersion).success)
+        if (! _commander.issueBatch (commandVersion, commandHardware, commandHardwareId, commandSerialNo, commandApiVersion).success)
             return false;
         _status.version = commandVersion.responseGet ();
         _status.hardware = commandHardware.responseGet ();
         _status.hardwareid = commandHardwareId.responseGet ();
         _status.serialno = commandSerialNo.responseGet ();
         _status.apiversion = commandApiVersion.responseGet ();
-        RAKDEVICE_DEBUG_PRINTF ("RakDeviceManager::setup: Version=%s, Hardware=%s, HardwareId=%s, Serialno=%s, APIversion=%s\n", _status.version.c_str (), _status.hardware.c_str (), _status.hardwareid.c_str (), _status.serialno.c_str (), _status.apiversion.c_str ());
+        RAKDEVICE_LOG (MANAGER, INFO, "RakDeviceManager::setup: Version=%s, Hardware=%s, HardwareId=%s, Serialno=%s, APIversion=%s\n", _status.version.c_str (), _status.hardware.c_str (), _status.hardwareid.c_str (), _status.serialno.c_str (), _status.apiversion.c_str ());
 
         RakDeviceCommand_NWM commandModeNetworkSet (static_cast<int> (_config.loraOperation.mode));
         if (! _commander.issue (commandModeNetworkSet).success)
             return false;
-        RakDeviceCommand_NJM commandModeJoinSet (static_cast<int> (_config.loraOperation.join));
-        (void) _commander.issue (commandModeJoinSet);
-        delay (250);                 // wait 250ms for mode switch
-        _transceiver.send ("\n");    // soak up banner "RAKwireless RAK3272-SiP Example------------------------------------------------------"
-        if (! _commander.issue (commandModeJoinSet).success)
-            return false;
-        RakDeviceCommand_CLASS commandClassSet (String ((char) _config.loraOperation.clazz));
-        if (! _commander.issue (commandClassSet).success)
+        if (_config.loraOperation.mode == Lora::Mode::MODE_P2PLORA)
+            return p2pBegin ();
+        else if (_config.loraOperation.mode != Lora::Mode::MODE_LORAWAN)
             return false;
-        RakDeviceCommand_BAND commandBandSet (static_cast<int> (_config.loraOperation.band));
-        if (! _commander.issue (commandBandSet).success)
-            return false;
-        RAKDEVICE_DEBUG_PRINTF ("RakDeviceManager::setup: Mode=%s, Join=%s, Class=%s, Band=%s\n", Lora::toString (_config.loraOperation.mode).c_str (), Lora::toString (_config.loraOperation.join).c_str (), Lora::toString (_config.loraOperation.clazz).c_str (), Lora::toString (_config.loraOperation.band).c_str ());
-
-        RakDeviceCommand_DEVEUI commandDevEuiSet (_config.loraIdentifiers.devEUI);
-        RakDeviceCommand_APPEUI commandAppEuiSet (_config.loraIdentifiers.appEUI);
-        RakDeviceCommand_APPKEY commandAppKeySet (_config.loraIdentifiers.appKey);
-        if (! _commander.issue (commandDevEuiSet).success || ! _commander.issue (commandAppEuiSet).success || ! _commander.issue (commandAppKeySet).success)
-            return false;
-        RAKDEVICE_DEBUG_PRINTF ("RakDeviceManager::setup: DevEUI=%s, AppEUI=%s, AppKey=%s\n", _config.loraIdentifiers.devEUI.c_str (), _config.loraIdentifiers.appEUI.c_str (), _config.loraIdentifiers.appKey.c_str ());
-
-        RakDeviceCommand_CONFIRM_MODE commandConfirmModeSet (_config.loraParameters.confirmMode);
-        RakDeviceCommand_DUTY_CYCLE commandDutyCycleSet (_config.loraParameters.dutyCycle);
-        RakDeviceCommand_DATARATE commandDataRateSet (static_cast<int> (_config.loraParameters.dataRate));
-        RakDeviceCommand_TX_POWER commandTxPowerSet (static_cast<int> (_config.loraParameters.txPower));
-        if (! _commander.issue (commandConfirmModeSet).success || ! _commander.issue (commandDutyCycleSet).success || ! _commander.issue (commandDataRateSet).success || ! _commander.issue (commandTxPowerSet).success)
-            return false;
-
-        RakDeviceCommand_ADR commandAdrSet (_config.loraParameters.adaptiveDataRate);
-        RakDeviceCommand_PNM commandPnmSet (_config.loraParameters.publicNetworkMode);
-        RakDeviceCommand_RX1_DELAY commandRx1DelaySet (_config.loraParameters.rx1Delay);
-        RakDeviceCommand_RX2_DELAY commandRx2DelaySet (_config.loraParameters.rx2Delay);
-        RakDeviceCommand_RX2_DATARATE commandRx2DataRateSet (static_cast<int> (_config.loraParameters.rx2DataRate));
-        if (! _commander.issue (commandAdrSet).success || ! _commander.issue (commandPnmSet).success || ! _commander.issue (commandRx1DelaySet).success || ! _commander.issue (commandRx2DelaySet).success || ! _commander.issue (commandRx2DataRateSet).success)
+        if (! configure (false))
             return false;
 
         _state = State::INITIALISED;
@@ -212,6 +474,7 @@ public:
     }
 
     void end () {
+        RakDeviceArbiter::Guard guard (_arbiter, Priority::CONTROL);
         if (_state == State::UNINITIALISED)
             return;
 
@@ -220,174 +483,795 @@ public:
     }
 
     void process () {
-        RAKDEVICE_DEBUG_PRINTF ("RakDeviceManager::STATE: %s\n", toString (_state).c_str ());
+        RakDeviceArbiter::Guard guard (_arbiter, Priority::HOUSEKEEPING);
+        RAKDEVICE_LOG (MANAGER, DEBUG, "RakDeviceManager::STATE: %s\n", toString (_state).c_str ());
+        _energy.update ();
 
-        if (! (_state == State::JOIN_PENDING || _state == State::JOIN_FAILURE || _state == State::JOIN_SUCCESS))
+        if (! (_state == State::JOIN_PENDING || _state == State::JOIN_FAILURE || _state == State::JOIN_SUCCESS || _state == State::P2P_READY))
             return;
 
+        if (_dozing && (sleepElapsed () || _scheduler.nextDeadline () == 0))    // timed work is due, e.g. a queued transmit: wake first
+            (void) awaken ();
         _commander.process ();
+        _scheduler.process ();
 
-        if (_networkRestriction.active ())
-            updateNetworkRestriction ();
-
-        if (_state == State::JOIN_PENDING)
-            updateJoinStatus ();
-        else if (_state == State::JOIN_SUCCESS) {
-            if (_intervalStatus)
-                updateStatus (), updateNetworkTime ();
-            if (_intervalLinkCheck)
-                updateLinkStatus ();
-        }
+        if (_state == State::P2P_READY)
+            p2pReceive ();    // the module rejects most commands while receiving, so the timers hold off housekeeping
+        else
+            doze ();
+    }
+    interval_t nextDeadline () const {    // how long the caller may sleep before process () has timed work to do
+        return _scheduler.nextDeadline ();
+    }
+    bool hasInput () const {    // the module has said something process () has not yet handled, buffered here or still in the stream
+        return _transceiver.available ();
     }
+    Scheduler &scheduler () { return _scheduler; }
+    bool isRestricted () const { return _scheduler.pending (_timerNetworkRestriction); }
+    const RakDeviceArbiter &arbiter () const { return _arbiter; }
 
-    bool suspend () {
-        if (_state == State::SUSPENDED)
+    bool suspend (const interval_t duration = 0) {    // 0 = until resume (), otherwise the module wakes itself by then
+        RakDeviceArbiter::Guard guard (_arbiter, Priority::CONTROL);
+        if (_state == State::SUSPENDED || ! awaken ())
             return false;
 
-        RakDeviceCommand_SLEEP commandSleep;
-        if (! _commander.issue (commandSleep).success)
+        if (! sleep (duration))
             return false;
         _stateSuspended = _state;
         _state = State::SUSPENDED;
         return true;
     }
 
-    bool resume () {
+    bool resume () {    // ready as soon as the module answers: status is refreshed by its own timer, not here
+        RakDeviceArbiter::Guard guard (_arbiter, Priority::CONTROL);
         if (_state != State::SUSPENDED)
             return false;
 
-        _transceiver.poke ();
-        delay (100);
+        const bool ready = awaken ();
         _state = _stateSuspended;
-        return updateStatus ();
+        return ready;
+    }
+
+    bool reconfigure (const ConfigDelta &delta) {    // all or nothing, without begin (): only the settings that differ are issued, and only those the session depends on rejoin
+        RakDeviceArbiter::Guard guard (_arbiter, Priority::CONTROL);
+        if (_state == State::SUSPENDED)
+            return false;
+        Config next = _config;
+        auto &operation = next.loraOperation;
+        auto &identifiers = next.loraIdentifiers;
+        auto &parameters = next.loraParameters;
+        const bool subBand = merge (operation.subBand, delta.subBand) && operation.subBand != 0, join = merge (operation.join, delta.join);
+        const bool devEui = merge (identifiers.devEUI, delta.devEUI), appEui = merge (identifiers.appEUI, delta.appEUI), appKey = merge (identifiers.appKey, delta.appKey);
+        const bool confirmMode = merge (parameters.confirmMode, delta.confirmMode), dutyCycle = merge (parameters.dutyCycle, delta.dutyCycle), publicNetworkMode = merge (parameters.publicNetworkMode, delta.publicNetworkMode);
+        const bool adaptiveDataRate = merge (parameters.adaptiveDataRate, delta.adaptiveDataRate) && ! _linkOptimiser.enabled ();
+        const bool rx1Delay = merge (parameters.rx1Delay, delta.rx1Delay), rx2Delay = merge (parameters.rx2Delay, delta.rx2Delay), rx2DataRate = merge (parameters.rx2DataRate, delta.rx2DataRate);
+        const bool dataRate = delta.dataRate && *delta.dataRate != _status.dataRate, txPower = delta.txPower && *delta.txPower != _status.txPower;    // against what is in use, the optimisers move them
+        (void) merge (parameters.dataRate, delta.dataRate), (void) merge (parameters.txPower, delta.txPower);
+        (void) merge (parameters.joinAttemptsDelay, delta.joinAttemptsDelay), (void) merge (parameters.joinAttemptsNumber, delta.joinAttemptsNumber);
+        const bool rejoinInterval = merge (next.rejoinInterval, delta.rejoinInterval), statusInterval = merge (next.statusInterval, delta.statusInterval), linkCheckInterval = merge (next.linkCheckInterval, delta.linkCheckInterval), healthInterval = merge (next.healthInterval, delta.healthInterval);
+        (void) merge (next.networkTimeInterval, delta.networkTimeInterval), (void) merge (next.transmitConfirmationTimeout, delta.transmitConfirmationTimeout);    // taken up when next armed
+        const char *invalid = reconfigureInvalid (delta, next);
+        if (invalid != nullptr) {
+            RAKDEVICE_LOG (MANAGER, WARNING, "RakDeviceManager::RECONFIGURE: %s invalid, nothing changed\n", invalid);
+            return false;
+        }
+
+        RakDeviceCommand_MASK commandMask (_region.subBandMask (operation.subBand));
+        RakDeviceCommand_DEVEUI commandDevEui (identifiers.devEUI);
+        RakDeviceCommand_APPEUI commandAppEui (identifiers.appEUI);
+        RakDeviceCommand_APPKEY commandAppKey (identifiers.appKey);
+        RakDeviceCommand_PNM commandPnm (parameters.publicNetworkMode);
+        RakDeviceCommand_CONFIRM_MODE commandConfirmMode (parameters.confirmMode);
+        RakDeviceCommand_DUTY_CYCLE commandDutyCycle (parameters.dutyCycle);
+        RakDeviceCommand_DATARATE commandDataRate (static_cast<int> (parameters.dataRate));
+        RakDeviceCommand_TX_POWER commandTxPower (static_cast<int> (parameters.txPower));
+        RakDeviceCommand_ADR commandAdr (parameters.adaptiveDataRate);
+        RakDeviceCommand_RX1_DELAY commandRx1Delay (parameters.rx1Delay);
+        RakDeviceCommand_RX2_DELAY commandRx2Delay (parameters.rx2Delay);
+        RakDeviceCommand_RX2_DATARATE commandRx2DataRate (static_cast<int> (parameters.rx2DataRate));
+        RakDeviceCommand *session [5], *settings [8];    // each within a batch
+        size_t sessionCount = 0, settingsCount = 0;
+        const auto include = [] (RakDeviceCommand *commands [], size_t &count, RakDeviceCommand &command, const bool changed) {
+            if (changed)
+                commands [count++] = &command;
+        };
+        include (session, sessionCount, commandMask, subBand), include (session, sessionCount, commandDevEui, devEui), include (session, sessionCount, commandAppEui, appEui), include (session, sessionCount, commandAppKey, appKey), include (session, sessionCount, commandPnm, publicNetworkMode);
+        include (settings, settingsCount, commandConfirmMode, confirmMode), include (settings, settingsCount, commandDutyCycle, dutyCycle), include (settings, settingsCount, commandDataRate, dataRate), include (settings, settingsCount, commandTxPower, txPower);
+        include (settings, settingsCount, commandAdr, adaptiveDataRate), include (settings, settingsCount, commandRx1Delay, rx1Delay), include (settings, settingsCount, commandRx2Delay, rx2Delay), include (settings, settingsCount, commandRx2DataRate, rx2DataRate);
+        const bool rejoin = join || sessionCount > 0;
+
+        if (_state != State::UNINITIALISED && (join || sessionCount > 0 || settingsCount > 0)) {    // otherwise begin () configures it all
+            if (_config.loraOperation.mode != Lora::Mode::MODE_LORAWAN) {
+                RAKDEVICE_LOG (MANAGER, WARNING, "RakDeviceManager::RECONFIGURE: LoRaWAN settings in %s mode, nothing changed\n", Lora::toString (_config.loraOperation.mode).c_str ());
+                return false;
+            }
+            if (! awaken ())
+                return false;
+            if ((join && ! configureJoinMode (operation.join)) || (sessionCount > 0 && ! _commander.issueBatch (session, sessionCount, nullptr).success) || (settingsCount > 0 && ! _commander.issueBatch (settings, settingsCount, nullptr).success)) {
+                RAKDEVICE_LOG (MANAGER, WARNING, "RakDeviceManager::RECONFIGURE: setting failed, restoring the previous configuration\n");
+                (void) configure (true);    // verifying: only what was changed is set back
+                return false;
+            }
+        }
+        _config = next;
+        if (dataRate || txPower) {
+            _status.dataRate = parameters.dataRate;
+            _status.txPower = parameters.txPower;
+            _linkOptimiser.apply ({ .dataRate = _status.dataRate, .txPower = _status.txPower });    // from here, with a fresh history
+        }
+        if (statusInterval)
+            reschedule (_timerStatus, _config.statusInterval);
+        if (linkCheckInterval)
+            reschedule (_timerLinkCheck, _config.linkCheckInterval);
+        if (healthInterval)
+            reschedule (_timerHealth, _config.healthInterval);
+        if (rejoinInterval && ! _joinEngine.enabled ())
+            reschedule (_timerRejoin, _config.rejoinInterval);
+        RAKDEVICE_LOG (MANAGER, INFO, "RakDeviceManager::RECONFIGURE: settings=%u, rejoin=%s\n", (join ? 1 : 0) + sessionCount + settingsCount, rejoin ? "yes" : "no");
+        if (rejoin && (_state == State::JOIN_PENDING || _state == State::JOIN_FAILURE || _state == State::JOIN_SUCCESS)) {
+            _state = State::INITIALISED;
+            joinCommence ();
+        }
+        return true;
     }
 
     //
 
     inline bool transmit (Lora::Port port, const String &data, const bool awaitConfirmation = false) {
-        if (_state != State::JOIN_SUCCESS)
-            return false;
-        return processTransmit (port, bytesToHexString (reinterpret_cast<const uint8_t *> (data.c_str ()), data.length ()), awaitConfirmation);
+        return transmit (port, reinterpret_cast<const uint8_t *> (data.c_str ()), data.length (), awaitConfirmation);
+    }
+    bool transmit (Lora::Port port, const uint8_t *data, const size_t length, const bool awaitConfirmation = false) {    // awaiting, true only once delivered
+        counter_t sequence;
+        {
+            RakDeviceArbiter::Guard guard (_arbiter, Priority::TRANSMIT);
+            if (_state == State::SUSPENDED && _config.power.resumeOnTransmit && _stateSuspended == State::JOIN_SUCCESS && resume ())
+                RAKDEVICE_LOG (MANAGER, INFO, "RakDeviceManager::POWER: resumed to transmit\n");
+            if (_state == State::P2P_READY)
+                return processTransmitP2P (bytesToHexString (data, length));
+            if (_state != State::JOIN_SUCCESS || ! awaken ())
+                return false;
+            if (length > static_cast<size_t> (_region.maximumPayloadSize (_status.dataRate))) {    // the module would only refuse it after the round trip
+                RAKDEVICE_LOG (MANAGER, WARNING, "RakDeviceManager::transmit: %u bytes exceeds %d for %s %s\n", length, _region.maximumPayloadSize (_status.dataRate), _region.name, _region.toString (_status.dataRate).c_str ());
+                return false;
+            }
+            if (! processTransmit (port, bytesToHexString (data, length)))
+                return false;
+            sequence = _uplink.sequence;
+        }
+        if (! awaitConfirmation)
+            return true;
+        const Confirmation confirmation = confirmationWait (sequence, _config.transmitConfirmationTimeout);
+        return confirmation == Confirmation::CONFIRMED || confirmation == Confirmation::SENT;
     }
-    inline bool transmit (Lora::Port port, const uint8_t *data, const size_t length, const bool awaitConfirmation = false) {
-        if (_state != State::JOIN_SUCCESS)
+    Confirmation confirmationWait (const counter_t sequence, const interval_t timeout) {    // of that uplink, bounded, running process () meanwhile so that other work carries on, which may itself transmit
+        const interval_t started = millis ();
+        while (true) {
+            {
+                RakDeviceArbiter::Guard guard (_arbiter, Priority::HOUSEKEEPING);
+                process ();
+                const Confirmation confirmation = confirmationOf (sequence);
+                if (confirmation != Confirmation::PENDING || millis () - started >= timeout)
+                    return confirmation;
+            }
+            delay (TRANSMIT_CONFIRMATION_POLL);
+        }
+    }
+    Confirmation confirmationOf (const counter_t sequence) const {    // the latest uplink and the one before are known, any earlier have been superseded
+        if (sequence == _uplink.sequence)
+            return _uplink.confirmation;
+        else if (sequence == _uplinkPrevious.sequence && sequence != 0)
+            return _uplinkPrevious.confirmation;
+        else
+            return Confirmation::SUPERSEDED;
+    }
+    const Uplink &uplink () const { return _uplink; }
+
+    bool receive (Downlink &downlink) {
+        std::lock_guard<std::mutex> guard (_receiveMutex);
+        if (_receiveQueue.empty ())
             return false;
-        return processTransmit (port, bytesToHexString (data, length), awaitConfirmation);
+        downlink = _receiveQueue.front ();
+        _receiveQueue.pop ();
+        return true;
+    }
+    void release (Downlink &downlink) {
+        _receivePool.release (downlink.data);
+        downlink.data = nullptr;
+        downlink.length = 0;
+    }
+    size_t receiveQueueSize () const {
+        std::lock_guard<std::mutex> guard (_receiveMutex);
+        return _receiveQueue.size ();
     }
 
     const Status &status () const { return _status; }
-    bool isAvailable () const { return _state == State::JOIN_SUCCESS; }
+    const RakDeviceClock &clock () const { return _clock; }
+    bool networkTime (uint64_t &epoch) const {    // epoch milliseconds, from the disciplined clock, no AT traffic
+        if (! _clock.synchronised ())
+            return false;
+        epoch = _clock.now ();
+        return true;
+    }
+    const RakDeviceChannelHealth &channelHealth () const { return _channelHealth; }
+    bool isCongested () const { return _channelHealth.congested (); }
+    const RakDeviceJoinEngine &joinEngine () const { return _joinEngine; }
+    const RakDeviceRegion &region () const { return _region; }
+    const RakDeviceEnergyModel &energy () const { return _energy; }
+    interval_t energyBudgetWait (const size_t length) const {    // until an uplink of length bytes, at the current settings, fits the energy budget
+        return _energy.budgetWait (_energy.uplinkCharge (_status.dataRate, _status.txPower, length));
+    }
+    size_t maximumPayloadSize () const {    // at the current data rate, or for a P2P packet
+        if (_config.loraOperation.mode == Lora::Mode::MODE_P2PLORA)
+            return Lora::MAXIMUM_P2P_SEND_SIZE / 2;
+        return static_cast<size_t> (_region.maximumPayloadSize (_status.dataRate));
+    }
+    bool isAvailable () const { return _state == State::JOIN_SUCCESS || _state == State::P2P_READY; }
     const State getState () const { return _state; }
 
 private:
     //
 
+    bool sleep (const interval_t duration) {
+        RakDeviceCommand_SLEEP commandSleep (duration);
+        if (! _commander.issue (commandSleep).success)
+            return false;
+        _asleep = true;
+        _sleepStarted = millis ();
+        _sleepUntil = duration > 0 ? _sleepStarted + duration : 0;
+        _wokeAt = 0;
+        _status.power.sleeps++;
+        _energy.sleep (true);
+        RAKDEVICE_LOG (MANAGER, DEBUG, "RakDeviceManager::POWER: sleep, %lu ms\n", duration);
+        return true;
+    }
+    bool sleepElapsed () const {    // a timed sleep has run out, the module is awake again by itself
+        return _asleep && _sleepUntil != 0 && static_cast<long> (millis () - _sleepUntil) >= 0;
+    }
+    void sleepEnded (const interval_t at) {
+        _status.power.sleepTotal += at - _sleepStarted;
+        _asleep = _dozing = false;
+        _energy.sleep (false);
+    }
+    bool awaken () {    // before issuing anything: a no-op unless asleep, and no probing when the sleep has already run out
+        if (! _asleep)
+            return true;
+        if (sleepElapsed ()) {
+            sleepEnded (_sleepUntil);
+            return true;
+        }
+        const interval_t started = millis ();
+        sleepEnded (started);
+        _transceiver.poke ();    // any character wakes it, and is lost doing so
+        bool ready = false;
+        while (! ready && millis () - started < _config.power.wakeTimeout)
+            ready = _commander.probe (WAKE_PROBE_TIMEOUT);
+        const interval_t latency = millis () - started;
+        auto &power = _status.power;
+        if (! ready) {
+            power.wakeFailures++;
+            RAKDEVICE_LOG (MANAGER, WARNING, "RakDeviceManager::POWER: no response %lu ms after waking\n", latency);
+            return false;
+        }
+        power.wakes++;
+        power.wakeLatencyLast = latency;
+        power.wakeLatencyTotal += latency;
+        if (latency > power.wakeLatencyMaximum)
+            power.wakeLatencyMaximum = latency;
+        _wokeAt = started;
+        RAKDEVICE_LOG (MANAGER, DEBUG, "RakDeviceManager::POWER: awake, %lu ms\n", latency);
+        return true;
+    }
+    void doze () {    // joined, Class A and idle: sleep until just before the next timed work
+        if (! _config.power.sleepAutomatic || _asleep || _state != State::JOIN_SUCCESS || _config.loraOperation.clazz != Lora::Class::CLASS_A || _recovering || _fault != Fault::NONE)
+            return;
+        if (_uplink.confirmation == Confirmation::PENDING || _transceiver.available ())    // receive windows, or events, still to come
+            return;
+        const interval_t deadline = std::min (_scheduler.nextDeadline (), _config.power.sleepMaximum);
+        if (deadline < _config.power.sleepMinimum + _config.power.sleepMargin)
+            return;
+        if (sleep (deadline - _config.power.sleepMargin))
+            _dozing = true;
+    }
+    void updateWakeToUplink () {
+        if (_wokeAt == 0)
+            return;
+        const interval_t elapsed = millis () - _wokeAt;
+        auto &power = _status.power;
+        power.uplinksAfterWake++;
+        power.wakeToUplinkLast = elapsed;
+        power.wakeToUplinkTotal += elapsed;
+        if (elapsed > power.wakeToUplinkMaximum)
+            power.wakeToUplinkMaximum = elapsed;
+        _wokeAt = 0;
+    }
+
+    //
+
+    bool baudRateProbe (const uint32_t baudRate) {
+        if (_config.serial.baudRateApply) {
+            _config.serial.baudRateApply (baudRate);
+            delay (BAUDRATE_SETTLE_DELAY);
+        }
+        if (! _commander.probe (BAUDRATE_PROBE_TIMEOUT))
+            return false;
+        _status.baudRate = baudRate;
+        *_config.serial.retained = { .magic = RakDeviceRetained::MAGIC, .baudRate = baudRate };
+        return true;
+    }
+    bool baudRateEstablish () {
+        // after a warm restart the module may still be at a previously negotiated rate
+        const RakDeviceRetained retained = *_config.serial.retained;
+        if (_config.serial.baudRateApply && retained.magic == RakDeviceRetained::MAGIC && retained.baudRate != BAUDRATE_DEFAULT)
+            for (const auto baudRate : BAUDRATES)
+                if (baudRate == retained.baudRate && baudRateProbe (baudRate)) {
+                    RAKDEVICE_LOG (MANAGER, INFO, "RakDeviceManager::BAUDRATE: retained %lu\n", (unsigned long) baudRate);
+                    return true;
+                }
+        if (baudRateProbe (BAUDRATE_DEFAULT))
+            return true;
+        RAKDEVICE_LOG (MANAGER, WARNING, "RakDeviceManager::BAUDRATE: no response at %lu\n", (unsigned long) BAUDRATE_DEFAULT);
+        return ! _config.serial.baudRateApply;    // without control of the host side, carry on regardless
+    }
+    bool baudRateNegotiate (const uint32_t baudRate) {
+        if (! _config.serial.baudRateApply)
+            return false;
+        const uint32_t baudRatePrevious = _status.baudRate;
+        RakDeviceCommand_BAUD commandBaud (static_cast<int> (baudRate));
+        if (! _commander.issue (commandBaud).success) {
+            RAKDEVICE_LOG (MANAGER, WARNING, "RakDeviceManager::BAUDRATE: %lu rejected\n", (unsigned long) baudRate);
+            return false;
+        }
+        if (baudRateProbe (baudRate)) {
+            RAKDEVICE_LOG (MANAGER, INFO, "RakDeviceManager::BAUDRATE: negotiated %lu\n", (unsigned long) baudRate);
+            return true;
+        }
+        RAKDEVICE_LOG (MANAGER, WARNING, "RakDeviceManager::BAUDRATE: %lu failed probe, falling back to %lu\n", (unsigned long) baudRate, (unsigned long) baudRatePrevious);
+        if (baudRateProbe (baudRatePrevious))    // module did not switch
+            return false;
+        _config.serial.baudRateApply (baudRate);    // module switched but the link is unreliable, revert it blind
+        delay (BAUDRATE_SETTLE_DELAY);
+        _transceiver.send ("AT" + String (CMD_BAUD) + "=" + String (baudRatePrevious));
+        delay (BAUDRATE_SETTLE_DELAY);
+        (void) baudRateProbe (baudRatePrevious);
+        return false;
+    }
+
+    //
+
+    static bool settingEquals (const String &current, const String &value) { return current.equalsIgnoreCase (value); }
+    bool configureJoinMode (const Lora::Join join) {
+        RakDeviceCommand_NJM commandModeJoinSet (static_cast<int> (join));
+        (void) _commander.issue (commandModeJoinSet);
+        delay (250);                 // wait 250ms for mode switch
+        _transceiver.send ("\n");    // soak up banner "RAKwireless RAK3272-SiP Example------------------------------------------------------"
+        return _commander.issue (commandModeJoinSet).success;
+    }
+    template <typename T>
+    static bool settingEquals (const T &current, const T &value) { return current == value; }
+    template <typename Command, typename T>
+    bool configureSetting (const Command &current, const bool verified, const T &value) {    // current has been queried, when verified
+        if (verified && settingEquals (current.getValue (), value)) {
+            _status.health.settingsSkipped++;
+            return true;
+        }
+        Command commandSet (value);
+        return _commander.issue (commandSet).success;
+    }
+    template <typename T>
+    static bool merge (T &value, const std::optional<T> &change) {    // true when it differs
+        if (! change || *change == value)
+            return false;
+        value = *change;
+        return true;
+    }
+    const char *reconfigureInvalid (const ConfigDelta &delta, const Config &next) const {    // the first setting out of range, nullptr if none
+        const auto within = [] (const auto &value, const int minimum, const int maximum) { return ! value || (static_cast<int> (*value) >= minimum && static_cast<int> (*value) <= maximum); };
+        const auto hexadecimal = [] (const std::optional<String> &value, const size_t length) { return ! value || (value->length () == length && RakDeviceAttributeValidator::isHexadecimalString (*value)); };
+        if (! within (delta.subBand, 0, _region.subBands))
+            return "SubBand";
+        if (! within (delta.join, Lora::MINIMUM_NJM, Lora::MAXIMUM_NJM))
+            return "Join";
+        if (! hexadecimal (delta.devEUI, 16) || ! hexadecimal (delta.appEUI, 16) || ! hexadecimal (delta.appKey, 32))
+            return "Identifiers";
+        if (delta.dataRate && ! _region.isUplink (*delta.dataRate))
+            return "DataRate";
+        if (! within (delta.txPower, Lora::MINIMUM_TXPOWER, Lora::MAXIMUM_TXPOWER))
+            return "TxPower";
+        if (! within (delta.rx1Delay, Lora::MINIMUM_RX1_DELAY, Lora::MAXIMUM_RX1_DELAY) || ! within (delta.rx2Delay, Lora::MINIMUM_RX2_DELAY, Lora::MAXIMUM_RX2_DELAY) || ((delta.rx1Delay || delta.rx2Delay) && next.loraParameters.rx2Delay <= next.loraParameters.rx1Delay))
+            return "RxDelay";
+        if (delta.rx2DataRate && ! _region.isDownlink (*delta.rx2DataRate))
+            return "RX2DataRate";
+        if (! within (delta.joinAttemptsDelay, Lora::MINIMUM_JOIN_ATTEMPTS_DELAY, Lora::MAXIMUM_JOIN_ATTEMPTS_DELAY) || ! within (delta.joinAttemptsNumber, Lora::MINIMUM_JOIN_ATTEMPTS, Lora::MAXIMUM_JOIN_ATTEMPTS))
+            return "JoinAttempts";
+        for (const auto &interval : { delta.rejoinInterval, delta.statusInterval, delta.linkCheckInterval, delta.networkTimeInterval, delta.healthInterval, delta.transmitConfirmationTimeout })
+            if (interval && *interval == 0)
+                return "Interval";
+        return nullptr;
+    }
+    void reschedule (const Scheduler::TimerId id, const interval_t period) {    // a running periodic timer onto its new period, due no later than it was
+        if (_scheduler.pending (id))
+            _scheduler.start (id, std::min (_scheduler.remaining (id), period), period);
+    }
+    Lora::Datarate regionUplink (const Lora::Datarate dataRate) const {    // the nearest 125 kHz uplink data rate the region has
+        if (_region.isUplink (dataRate))
+            return dataRate;
+        const Lora::Datarate nearest = static_cast<Lora::Datarate> (std::clamp (static_cast<int> (dataRate), _region.uplinkMinimum, _region.uplinkMaximum));
+        RAKDEVICE_LOG (MANAGER, WARNING, "RakDeviceManager::setup: DataRate=%d not an uplink data rate for %s, using %s\n", static_cast<int> (dataRate), _region.name, _region.toString (nearest).c_str ());
+        return nearest;
+    }
+    Lora::Datarate regionDownlink (const Lora::Datarate dataRate) const {    // for RX2, otherwise the region's default
+        if (_region.isDownlink (dataRate))
+            return dataRate;
+        const Lora::Datarate fallback = static_cast<Lora::Datarate> (_region.rx2DataRate);
+        RAKDEVICE_LOG (MANAGER, WARNING, "RakDeviceManager::setup: RX2DataRate=%d not a downlink data rate for %s, using %s\n", static_cast<int> (dataRate), _region.name, _region.toString (fallback).c_str ());
+        return fallback;
+    }
+    bool configure (const bool verify) {    // LoRaWAN settings; when verifying, queried in two batches first and only those that differ are set
+        RakDeviceCommand_NJM currentModeJoin;
+        RakDeviceCommand_CLASS currentClass;
+        RakDeviceCommand_BAND currentBand;
+        RakDeviceCommand_DEVEUI currentDevEui;
+        RakDeviceCommand_APPEUI currentAppEui;
+        RakDeviceCommand_APPKEY currentAppKey;
+        RakDeviceCommand_CONFIRM_MODE currentConfirmMode;
+        RakDeviceCommand_DUTY_CYCLE currentDutyCycle;
+        RakDeviceCommand_DATARATE currentDataRate;
+        RakDeviceCommand_TX_POWER currentTxPower;
+        RakDeviceCommand_ADR currentAdr;
+        RakDeviceCommand_PNM currentPnm;
+        RakDeviceCommand_RX1_DELAY currentRx1Delay;
+        RakDeviceCommand_RX2_DELAY currentRx2Delay;
+        RakDeviceCommand_RX2_DATARATE currentRx2DataRate;
+        RakDeviceCommand_LPM currentLpm;
+        RakDeviceResult results [16];
+        if (verify) {
+            RakDeviceCommand *const operation [] = { &currentModeJoin, &currentClass, &currentBand, &currentDevEui, &currentAppEui, &currentAppKey, &currentConfirmMode, &currentDutyCycle };
+            RakDeviceCommand *const parameters [] = { &currentDataRate, &currentTxPower, &currentAdr, &currentPnm, &currentRx1Delay, &currentRx2Delay, &currentRx2DataRate, &currentLpm };
+            (void) _commander.issueBatch (operation, sizeof (operation) / sizeof (operation [0]), results);
+            (void) _commander.issueBatch (parameters, sizeof (parameters) / sizeof (parameters [0]), results + sizeof (operation) / sizeof (operation [0]));
+        }
+        const auto verified = [&] (const size_t i) { return verify && results [i].success; };
+
+        if (verified (0) && currentModeJoin.getValue () == static_cast<int> (_config.loraOperation.join))
+            _status.health.settingsSkipped++;
+        else if (! configureJoinMode (_config.loraOperation.join))
+            return false;
+        const Lora::Class clazz = _config.loraOperation.clazz == Lora::Class::CLASS_B ? Lora::Class::CLASS_A : _config.loraOperation.clazz;    // Class B needs a join and network time first
+        if (verified (1) && currentClass.getClass () == clazz)
+            _status.health.settingsSkipped++;
+        else {
+            RakDeviceCommand_CLASS commandClassSet (String ((char) clazz));
+            if (! _commander.issue (commandClassSet).success)
+                return false;
+        }
+        if (! configureSetting (currentBand, verified (2), static_cast<int> (_config.loraOperation.band)))
+            return false;
+        RAKDEVICE_LOG (MANAGER, INFO, "RakDeviceManager::setup: Mode=%s, Join=%s, Class=%s, Band=%s\n", Lora::toString (_config.loraOperation.mode).c_str (), Lora::toString (_config.loraOperation.join).c_str (), Lora::toString (_config.loraOperation.clazz).c_str (), Lora::toString (_config.loraOperation.band).c_str ());
+        if (_region.subBands > 0 && _config.loraOperation.subBand != 0) {    // join on the gateway's channels rather than scanning all of them
+            const String mask = _region.subBandMask (_config.loraOperation.subBand);
+            RakDeviceCommand_MASK currentMask;
+            if (mask.isEmpty ())
+                RAKDEVICE_LOG (MANAGER, WARNING, "RakDeviceManager::setup: SubBand=%d not in 1 to %d for %s, channel mask unchanged\n", _config.loraOperation.subBand, _region.subBands, _region.name);
+            else if (! configureSetting (currentMask, verify && _commander.issue (currentMask).success, mask))
+                return false;
+            else
+                RAKDEVICE_LOG (MANAGER, INFO, "RakDeviceManager::setup: SubBand=%d, Mask=%s\n", _config.loraOperation.subBand, mask.c_str ());
+        }
+
+        if (! configureSetting (currentDevEui, verified (3), _config.loraIdentifiers.devEUI) || ! configureSetting (currentAppEui, verified (4), _config.loraIdentifiers.appEUI) || ! configureSetting (currentAppKey, verified (5), _config.loraIdentifiers.appKey))
+            return false;
+        RAKDEVICE_LOG (MANAGER, INFO, "RakDeviceManager::setup: DevEUI=%s, AppEUI=%s, AppKey=%s\n", _config.loraIdentifiers.devEUI.c_str (), _config.loraIdentifiers.appEUI.c_str (), _config.loraIdentifiers.appKey.c_str ());
+
+        const Lora::Datarate dataRate = regionUplink (verify ? _status.dataRate : _config.loraParameters.dataRate);    // on re-init, keep what the link optimiser has chosen
+        const Lora::TxPower txPower = verify ? _status.txPower : _config.loraParameters.txPower;
+        if (! configureSetting (currentConfirmMode, verified (6), _config.loraParameters.confirmMode) || ! configureSetting (currentDutyCycle, verified (7), _config.loraParameters.dutyCycle) || ! configureSetting (currentDataRate, verified (8), static_cast<int> (dataRate)) || ! configureSetting (currentTxPower, verified (9), static_cast<int> (txPower)))
+            return false;
+        _status.dataRate = dataRate;
+        _status.txPower = txPower;
+
+        const Lora::Datarate rx2DataRate = regionDownlink (_config.loraParameters.rx2DataRate);
+        if (! configureSetting (currentAdr, verified (10), networkAdaptiveDataRate ()) || ! configureSetting (currentPnm, verified (11), _config.loraParameters.publicNetworkMode) || ! configureSetting (currentRx1Delay, verified (12), _config.loraParameters.rx1Delay) || ! configureSetting (currentRx2Delay, verified (13), _config.loraParameters.rx2Delay) || ! configureSetting (currentRx2DataRate, verified (14), static_cast<int> (rx2DataRate)))
+            return false;
+        if (! configureSetting (currentLpm, verified (15), _config.power.lowPowerMode))    // sleeps between commands, so each exchange wakes it first
+            return false;
+        return true;
+    }
+
+    bool p2pBegin () {
+        delay (250);                 // wait 250ms for mode switch
+        _transceiver.send ("\n");    // soak up banner
+        RakDeviceCommand_P2P::Parameters parameters = _config.p2p;
+        if (parameters.frequency == 0)
+            parameters.frequency = _region.p2pFrequency;
+        RakDeviceCommand_P2P commandP2PSet (parameters);
+        if (! _commander.issue (commandP2PSet).success)
+            return false;
+        RAKDEVICE_LOG (MANAGER, INFO, "RakDeviceManager::setup: Mode=%s, Frequency=%ld, SF=%d, BW=%d, CR=%d, Preamble=%d, TxPower=%d\n", Lora::toString (_config.loraOperation.mode).c_str (), parameters.frequency, parameters.spreadingFactor, parameters.bandwidth, parameters.codingRate, parameters.preamble, parameters.txPower);
+        _state = State::P2P_READY;
+        p2pReceive ();
+        return true;
+    }
+    void p2pReceive () {
+        if (_p2pReceiving || _p2pTransmitting)
+            return;
+        RakDeviceCommand_PRECV commandReceive (Lora::P2P_RECEIVE_UNTIL_PACKET);
+        if (! _commander.issue (commandReceive).success)
+            return;
+        _p2pReceiving = true;
+        if (_p2pTransmitDone != 0) {
+            const interval_t turnaround = millis () - _p2pTransmitDone;
+            _status.p2p.turnarounds++;
+            _status.p2p.turnaroundTotal += turnaround;
+            if (turnaround > _status.p2p.turnaroundMaximum)
+                _status.p2p.turnaroundMaximum = turnaround;
+            _p2pTransmitDone = 0;
+        }
+    }
+
+    //
+
     void joinCommence () {
-        RAKDEVICE_DEBUG_PRINTF ("RakDeviceManager::JOIN-COMMENCE\n");
+        RAKDEVICE_LOG (MANAGER, INFO, "RakDeviceManager::JOIN-COMMENCE\n");
+        if (_joinEngine.enabled ()) {
+            joinPending ();
+            _scheduler.start (_timerRejoin, _joinEngine.begin ());
+            return;
+        }
         RakDeviceCommand_JOIN commandJoin (RakDeviceCommand_JOIN::Command::JOIN, _config.loraParameters.autoJoin, _config.loraParameters.joinAttemptsDelay, _config.loraParameters.joinAttemptsNumber);
         if (_commander.issue (commandJoin).success)
-            joinPending ();
+            _energy.join (_status.dataRate, _status.txPower), joinPending ();    // the first request: any the module reattempts itself go unseen
         else
             joinFailure ("unable to issue JOIN request");
     }
     void joinPending () {
-        RAKDEVICE_DEBUG_PRINTF ("RakDeviceManager::JOIN-PENDING\n");
-        _intervalRejoin.reset ();
+        RAKDEVICE_LOG (MANAGER, INFO, "RakDeviceManager::JOIN-PENDING\n");
+        if (_state != State::JOIN_PENDING)
+            _joinPendingSince = millis ();
+        if (! _joinEngine.enabled ())
+            _scheduler.start (_timerRejoin, _config.rejoinInterval, _config.rejoinInterval);
         _state = State::JOIN_PENDING;
         notifyEventListeners (Event::JOIN_PENDING, EventArgs ());
     }
+    void joinAttempt () {    // a single request at the engine's data rate: the engine, not the module, does the reattempting
+        const Lora::Datarate dataRate = _joinEngine.dataRate ();
+        RakDeviceCommand_DATARATE commandDataRateSet (static_cast<int> (dataRate));
+        RakDeviceCommand_JOIN commandJoin (RakDeviceCommand_JOIN::Command::JOIN, _config.loraParameters.autoJoin, Lora::DEFAULT_JOIN_ATTEMPTS_DELAY, 0);
+        if (! _commander.issue (commandDataRateSet).success || ! _commander.issue (commandJoin).success) {
+            joinRetry (RakDeviceJoinEngine::Failure::ERROR, "unable to issue JOIN request");
+            return;
+        }
+        _joinEngine.attempt ();
+        _energy.join (dataRate, _status.txPower);
+        _joinPendingSince = millis ();    // the health check looks for an attempt that never resolves, not for a long backoff
+        _scheduler.start (_timerRejoin, _config.joinEngine.attemptTimeout);
+        RAKDEVICE_LOG (MANAGER, INFO, "RakDeviceManager::JOIN-ATTEMPT: %lu, DataRate=%d\n", (unsigned long) _joinEngine.stats ().attempts, static_cast<int> (dataRate));
+    }
+    void joinRetry (const RakDeviceJoinEngine::Failure failure, const String &reason) {
+        const interval_t wait = _joinEngine.failure (failure);
+        RAKDEVICE_LOG (MANAGER, WARNING, "RakDeviceManager::JOIN-FAILURE: %s, next DataRate=%d in %lu ms\n", reason.c_str (), static_cast<int> (_joinEngine.dataRate ()), wait);
+        _scheduler.start (_timerRejoin, wait);
+        notifyEventListeners (Event::JOIN_FAILURE, { reason });    // still JOIN_PENDING: the engine carries on
+    }
     void joinSuccess () {
+        if (_joinEngine.active ()) {
+            _joinEngine.success ();
+            RakDeviceCommand_DATARATE commandDataRateSet (static_cast<int> (_status.dataRate));    // back from the join data rate to the configured one
+            if (_joinEngine.dataRate () != _status.dataRate)
+                (void) _commander.issue (commandDataRateSet);
+            RAKDEVICE_LOG (MANAGER, INFO, "RakDeviceManager::JOIN-TIME: %lu ms, attempts=%lu, median=%.0f ms\n", _joinEngine.stats ().timeToJoinLast, (unsigned long) _joinEngine.stats ().attempts, _joinEngine.stats ().timeToJoinMedian.value ());
+        }
         RakDeviceCommand_DEVADDR commandDevAddr;
         if (_commander.issue (commandDevAddr).success)
             _status.devAddr = commandDevAddr.getValue ();
-        RAKDEVICE_DEBUG_PRINTF ("RakDeviceManager::JOIN-SUCCESS: DevAddr=%s\n", _status.devAddr.c_str ());
+        RAKDEVICE_LOG (MANAGER, INFO, "RakDeviceManager::JOIN-SUCCESS: DevAddr=%s\n", _status.devAddr.c_str ());
         updateStatus ();
         _state = State::JOIN_SUCCESS;
+        _scheduler.cancel (_timerRejoin);
+        _scheduler.start (_timerStatus, _config.statusInterval, _config.statusInterval);
+        _scheduler.start (_timerLinkCheck, _config.linkCheckInterval, _config.linkCheckInterval);
+        _scheduler.start (_timerNetworkTime, _config.statusInterval);
         notifyEventListeners (Event::JOIN_SUCCESS, { _status.devAddr });
+        if (_config.loraOperation.clazz == Lora::Class::CLASS_B)
+            classBAcquire ();
+        else
+            updateClass ();
     }
     void joinFailure (const String &reason = String ()) {
-        RAKDEVICE_DEBUG_PRINTF ("RakDeviceManager::JOIN-FAILURE%s%s\n", (reason.isEmpty () ? "" : ": "), reason.c_str ());
+        RAKDEVICE_LOG (MANAGER, WARNING, "RakDeviceManager::JOIN-FAILURE%s%s\n", (reason.isEmpty () ? "" : ": "), reason.c_str ());
         _state = State::JOIN_FAILURE;
         notifyEventListeners (Event::JOIN_FAILURE, { reason });
     }
     void updateJoinStatus () {
-        if (_intervalRejoin) {
-            RakDeviceCommand_JOIN_STATUS commandJoinStatus;
-            if (_commander.issue (commandJoinStatus).success) {
-                if (commandJoinStatus.isJoined ())
-                    joinSuccess ();
-                else
-                    joinCommence ();
-            }
-        }
+        RakDeviceCommand_JOIN_STATUS commandJoinStatus;
+        if (_commander.issue (commandJoinStatus).success) {
+            if (commandJoinStatus.isJoined ())
+                joinSuccess ();
+            else if (_joinEngine.enabled ())
+                joinRetry (RakDeviceJoinEngine::Failure::UNRESOLVED, "no response to JOIN request");
+            else
+                joinCommence ();
+        } else if (_joinEngine.enabled ())
+            _scheduler.start (_timerRejoin, _config.joinEngine.attemptTimeout);    // ask again
     }
     void updateJoinStatus (const RakDeviceCommand_JOIN &commandJoin) {
         if (commandJoin.isJoined ())
             joinSuccess ();
-        else
+        else if (! _joinEngine.enabled ())
             joinFailure (commandJoin.failureString ());
+        else if (_joinEngine.attempting ())    // otherwise late, after the attempt was given up on
+            joinRetry (RakDeviceJoinEngine::toFailure (commandJoin.failureString ()), commandJoin.failureString ());
     }
 
     //
 
-    bool processTransmit (Lora::Port port, const String &data, const bool awaitConfirmation = false) {
-        RAKDEVICE_DEBUG_PRINTF ("RakDeviceManager::TRANSMIT-DATA: port=%d, %s\n", port, debugHexString (data).c_str ());
+    bool processTransmit (Lora::Port port, const String &data) {    // the outcome arrives later, as an event: see updateTransmitConfirmation
+        RAKDEVICE_LOG (MANAGER, DEBUG, "RakDeviceManager::TRANSMIT-DATA: port=%d, size=%u, data=%s\n", port, data.length (), data.c_str ());
         RakDeviceCommand_SEND commandSend (port, data);
+        const interval_t transmitStarted = millis ();
         if (! _commander.issue (commandSend).success)
             return false;
+        updateTransmitTiming (millis () - transmitStarted);
+        updateWakeToUplink ();
+        _energy.uplink (port, _status.dataRate, _status.txPower, data.length () / 2);
         _transmitCounter++;
-        if (awaitConfirmation) {
-            delay (TRANSMIT_AWAIT_CONFIRMATION_DELAY);
-            RakDeviceCommand_SEND_STATUS commandSendStatus;
-            if (_commander.issue (commandSendStatus).success) {
-                const bool wasSuccessful = commandSendStatus.wasSuccessful ();
-                _status.transmitConfirmation = wasSuccessful;
-                if (wasSuccessful)
-                    _transmitSuccesses++;
-                else
-                    _transmitFailures++;
-                return true;
-            } else {
-                _status.transmitConfirmation.invalidate ();
+        _uplinkPrevious = _uplink;
+        if (_uplink.confirmation == Confirmation::PENDING) {
+            _uplinkPrevious.confirmation = Confirmation::SUPERSEDED;
+            _status.confirmations.superseded++;
+            RAKDEVICE_LOG (MANAGER, WARNING, "RakDeviceManager::TRANSMIT-CONF: sequence=%lu superseded while pending\n", (unsigned long) _uplink.sequence);
+        }
+        _uplink = { .sequence = _uplink.sequence + 1, .port = port, .confirmed = _config.loraParameters.confirmMode, .sent = transmitStarted, .resolved = 0, .confirmation = Confirmation::PENDING };
+        _scheduler.start (_timerTransmitConfirmation, _config.transmitConfirmationTimeout);
+        return true;
+    }
+    bool processTransmitP2P (const String &data) {
+        if (_p2pTransmitting)
+            return false;
+        _p2pTransmitting = true;    // from here: an RXP2P delivered after the stop's response must not re-arm receive ahead of the PSEND
+        if (_p2pReceiving) {
+            RakDeviceCommand_PRECV commandReceiveStop (Lora::P2P_RECEIVE_STOP);
+            if (! _commander.issue (commandReceiveStop).success) {
+                _p2pTransmitting = false;
+                p2pReceive ();    // in case a packet ended it meanwhile
                 return false;
             }
+            _p2pReceiving = false;
         }
+        RakDeviceCommand_PSEND commandSend (data);
+        if (! _commander.issue (commandSend).success) {
+            _p2pTransmitting = false;
+            p2pReceive ();
+            return false;
+        }
+        _p2pTransmitStarted = millis ();
+        _status.p2p.bytesTransmitted += data.length () / 2;
+        _transmitCounter++;
         return true;
     }
-    void updateTransmitStatus (const RakDeviceCommand_SEND &commandSend) {
-        const bool wasConfirmed = commandSend.wasConfirmed ();
-        RAKDEVICE_DEBUG_PRINTF ("RakDeviceManager::TRANSMIT-CONF: %s\n", wasConfirmed ? "true" : "false");
-        _status.transmitConfirmation = wasConfirmed;
-        if (wasConfirmed) {
+    void updateTransmitP2P () {
+        _p2pTransmitting = false;
+        _p2pTransmitDone = millis ();
+        _status.p2p.transmits++;
+        _status.p2p.airtimeTotal += _p2pTransmitDone - _p2pTransmitStarted;
+        _transmitSuccesses++;
+        notifyEventListeners (Event::TRANSMIT_SUCCESS, EventArgs ());    // a listener may send the next packet straight away, ahead of re-arming receive
+        p2pReceive ();
+    }
+    void updateTransmitTiming (const interval_t elapsed) {
+        auto &timing = _status.transmitTiming [_status.baudRate];
+        timing.count++;
+        timing.total += elapsed;
+        if (elapsed > timing.maximum)
+            timing.maximum = elapsed;
+        RAKDEVICE_LOG (MANAGER, DEBUG, "RakDeviceManager::TRANSMIT-TIMING: baud=%lu, elapsed=%lu ms, average=%lu ms\n", (unsigned long) _status.baudRate, elapsed, timing.total / timing.count);
+    }
+    void updateTransmitDone () {
+        if (! _uplink.confirmed)    // a confirmed uplink has its SEND_CONFIRMED still to come
+            updateTransmitConfirmation (Confirmation::SENT);
+    }
+    void updateTransmitConfirmation (const Confirmation confirmation) {
+        auto &confirmations = _status.confirmations;
+        if (_uplink.confirmation != Confirmation::PENDING) {
+            confirmations.late++;
+            RAKDEVICE_LOG (MANAGER, WARNING, "RakDeviceManager::TRANSMIT-CONF: %s, late or unexpected, ignored\n", toString (confirmation).c_str ());
+            return;
+        }
+        _scheduler.cancel (_timerTransmitConfirmation);
+        _uplink.confirmation = confirmation;
+        _uplink.resolved = millis ();
+        const interval_t elapsed = _uplink.elapsed ();
+        const bool delivered = confirmation == Confirmation::CONFIRMED || confirmation == Confirmation::SENT;
+        RAKDEVICE_LOG (MANAGER, INFO, "RakDeviceManager::TRANSMIT-CONF: sequence=%lu, port=%d, %s, %lu ms\n", (unsigned long) _uplink.sequence, _uplink.port, toString (confirmation).c_str (), elapsed);
+        if (confirmation == Confirmation::TIMEOUT) {
+            confirmations.timeouts++;
+            _status.transmitConfirmation.invalidate ();
+        } else {
+            (confirmation == Confirmation::CONFIRMED ? confirmations.confirmed : confirmation == Confirmation::FAILED ? confirmations.failed : confirmations.sent)++;
+            confirmations.total += elapsed;
+            if (elapsed > confirmations.maximum)
+                confirmations.maximum = elapsed;
+            _status.history.transmitConfirmation.add (static_cast<float> (elapsed));
+        }
+        if (_uplink.confirmed && confirmation != Confirmation::SENT) {
+            _status.transmitConfirmation = delivered;
+            _linkOptimiser.recordDelivery (delivered);
+        }
+        if (delivered) {
             _transmitSuccesses++;
-            notifyEventListeners (Event::TRANSMIT_SUCCESS, EventArgs ());
+            notifyEventListeners (Event::TRANSMIT_SUCCESS, { String (_uplink.sequence), String (elapsed) });
         } else {
             _transmitFailures++;
-            notifyEventListeners (Event::TRANSMIT_FAILURE, EventArgs ());
+            notifyEventListeners (Event::TRANSMIT_FAILURE, { String (_uplink.sequence), confirmation == Confirmation::TIMEOUT ? String ("timeout") : String (elapsed) });
         }
     }
 
     //
 
-    void processReceive (const Lora::Port port, const String &data) {
-        RAKDEVICE_DEBUG_PRINTF ("RakDeviceManager::RECEIVE-DATA: port=%d, %s\n", port, debugHexString (data).c_str ());
+    void processReceive (const Downlink &downlink) {
+        RAKDEVICE_LOG (MANAGER, INFO, "RakDeviceManager::RECEIVE-DATA: port=%d, window=%d, size=%u\n", downlink.port, static_cast<int> (downlink.window), downlink.length);
+        {
+            std::lock_guard<std::mutex> guard (_receiveMutex);
+            _receiveQueue.push (downlink);    // cannot fail, the queue holds as many as the pool
+        }
         _receiveCounter++;
-        notifyEventListeners (Event::DATA_RECEIVED, { String (port), data });
-    }
-    void updateReceive (const Lora::Class class_, const String &details) {
-        // <-RX- <<+EVT:RX_1:-107:-7:UNICAST:15:beef>>details
-        int offset = 0, colon = details.indexOf (':');
-        const Lora::RSSI rssi = details.substring (offset, colon).toInt ();
-        colon = details.indexOf (':', offset = colon + 1);
-        const Lora::SNR snr = details.substring (offset, colon).toInt ();
-        colon = details.indexOf (':', offset = colon + 1);
-        const String mode = details.substring (offset, colon);
-        colon = details.indexOf (':', offset = colon + 1);
-        const Lora::Port port = details.substring (offset, colon).toInt ();
-        offset = colon + 1;
-        const String data = details.substring (offset);
-        updateStatusReceive ({ .RSSI = rssi, .SNR = snr });
-        processReceive (port, data);
+        notifyEventListeners (Event::DATA_RECEIVED, EventArgs ());
+    }
+    static size_t decodeHex (const char *hex, uint8_t *buffer, const size_t size) {
+        auto nibble = [] (const char c) -> int {
+            return (c >= '0' && c <= '9') ? c - '0' : (c >= 'A' && c <= 'F') ? c - 'A' + 10 : (c >= 'a' && c <= 'f') ? c - 'a' + 10 : -1;
+        };
+        size_t length = 0;
+        for (int high, low; length < size && (high = nibble (hex [0])) >= 0 && (low = nibble (hex [1])) >= 0; hex += 2)
+            buffer [length++] = static_cast<uint8_t> ((high << 4) | low);
+        return length;
+    }
+    bool processReceive (Downlink &downlink, const char *hex) {
+        uint8_t *buffer = _receivePool.acquire ();
+        if (buffer == nullptr) {
+            _receiveDropped++;
+            RAKDEVICE_LOG (MANAGER, WARNING, "RakDeviceManager::RECEIVE-DATA: pool exhausted, dropped (dropped=%lu)\n", (unsigned long) _receiveDropped.count ());
+            return false;
+        }
+        downlink.data = buffer;
+        downlink.length = decodeHex (hex, buffer, Lora::MAXIMUM_RECEIVE_SIZE);
+        processReceive (downlink);
+        return true;
+    }
+    void updateReceive (const Lora::Window window, const String &details) {
+        // <-RX- <<+EVT:RX_1:-107:-7:UNICAST:15:beef>>details, parsed in place and decoded straight into a pool buffer
+        const char *cursor = details.c_str ();
+        char *end;
+        Downlink downlink { .window = window, .timestamp = millis () };
+        downlink.RSSI = strtol (cursor, &end, 10);
+        downlink.SNR = (*end == ':') ? strtol (end + 1, &end, 10) : 0;
+        if (*end == ':' && (end = strchr (end + 1, ':')) != nullptr)    // UNICAST/MULTICAST
+            downlink.port = strtol (end + 1, &end, 10);
+        if (end == nullptr || *end != ':') {
+            RAKDEVICE_LOG (MANAGER, WARNING, "RakDeviceManager::RECEIVE-DATA: malformed <<%s>>\n", cursor);
+            return;
+        }
+        updateStatusReceive ({ .RSSI = downlink.RSSI, .SNR = downlink.SNR });
+        _linkOptimiser.recordReceive ({ .RSSI = downlink.RSSI, .SNR = downlink.SNR });
+        _energy.downlink (window == Lora::Window::RX_1 ? _status.dataRate : static_cast<Lora::Datarate> (_region.rx2DataRate), strlen (end + 1) / 2);    // received, even if dropped here
+        processReceive (downlink, end + 1);
+    }
+    void updateReceiveP2P (const String &details) {
+        // <-RX- <<+EVT:RXP2P:-26:7:414243>>details
+        _p2pReceiving = false;    // P2P_RECEIVE_UNTIL_PACKET ends with the packet
+        const char *cursor = details.c_str ();
+        char *end;
+        Downlink downlink { .window = Lora::Window::RX_P2P, .timestamp = millis () };
+        downlink.RSSI = strtol (cursor, &end, 10);
+        downlink.SNR = (*end == ':') ? strtol (end + 1, &end, 10) : 0;
+        if (*end == ':') {
+            updateStatusReceive ({ .RSSI = downlink.RSSI, .SNR = downlink.SNR });
+            if (processReceive (downlink, end + 1)) {
+                _status.p2p.receives++;
+                _status.p2p.bytesReceived += downlink.length;
+            }
+        } else
+            RAKDEVICE_LOG (MANAGER, WARNING, "RakDeviceManager::RECEIVE-DATA: malformed <<%s>>\n", cursor);
+        p2pReceive ();
     }
     // void updateReceive () {
     //     String data;
@@ -409,43 +1293,219 @@ private:
 
     //
 
-    void updateNetworkRestriction () {
-        if (_networkRestriction) {
-            RAKDEVICE_DEBUG_PRINTF ("RakDeviceManager::RESTRICTION: completed\n");
-            _networkRestriction.reset (0);
-        } else {
-            RAKDEVICE_DEBUG_PRINTF ("RakDeviceManager::RESTRICTION: continues, for another %f mins\n", ((float) (_networkRestriction.remaining ())) / 1000.0f / 60.0f);
-        }
-    }
     void updateNetworkRestriction (const interval_t milliseconds) {
-        RAKDEVICE_DEBUG_PRINTF ("RakDeviceManager::RESTRICTION: notified, for another %f mins\n", ((float) milliseconds) / 1000.0f / 60.0f);
-        _networkRestriction.reset (milliseconds);
+        RAKDEVICE_LOG (MANAGER, INFO, "RakDeviceManager::RESTRICTION: notified, for another %f mins\n", ((float) milliseconds) / 1000.0f / 60.0f);
+        _scheduler.start (_timerNetworkRestriction, milliseconds);
     }
 
     //
 
-    void updateWorkMode (const Lora::Mode mode) {
-        RAKDEVICE_DEBUG_PRINTF ("RakDeviceManager::WORK-MODE: %s\n", Lora::toString (mode));
+    void timerNetworkRestriction () {
+        RAKDEVICE_LOG (MANAGER, INFO, "RakDeviceManager::RESTRICTION: completed\n");
+    }
+    // housekeeping polls step aside first for anything more urgent queued behind process ()
+    void timerRejoin () {
+        _arbiter.yield ();
+        if (_state != State::JOIN_PENDING)
+            return;
+        if (! _joinEngine.enabled () || _joinEngine.attempting ())
+            updateJoinStatus ();
+        else
+            joinAttempt ();
+    }
+    void timerStatus () {
+        _arbiter.yield ();
+        if (_state == State::JOIN_SUCCESS)
+            updateStatus (), updateLinkOptimiser ();
+    }
+    void timerLinkCheck () {
+        _arbiter.yield ();
+        if (_state == State::JOIN_SUCCESS)
+            updateLinkStatus ();
+    }
+    void timerNetworkTime () {
+        _arbiter.yield ();
+        if (_state == State::JOIN_SUCCESS)
+            updateNetworkTime ();
+    }
+    void timerBeaconAcquire () {
+        if (_state == State::JOIN_SUCCESS && _status.deviceClass.get () == Lora::Class::CLASS_B && _status.beaconStatus != Lora::ClassB_Status::BEACON_LOCKED)
+            classBFallback ("beacon acquisition timeout");
+    }
+    void timerBeaconRetry () {
+        if (_state == State::JOIN_SUCCESS && _status.deviceClass.get () == Lora::Class::CLASS_A)
+            classBAcquire ();
+    }
+    void timerHealth () {
+        _arbiter.yield ();
+        if (_recovering || _fault != Fault::NONE || ! (_state == State::JOIN_PENDING || _state == State::JOIN_SUCCESS || _state == State::JOIN_FAILURE || _state == State::P2P_READY))
+            return;
+        if (_commander.timeouts () >= HEALTH_TIMEOUTS_MAXIMUM)
+            healthFault (Fault::UNRESPONSIVE, String (_commander.timeouts ()) + " response timeouts");
+        else if (_state == State::JOIN_PENDING && (! _joinEngine.enabled () || _joinEngine.attempting ()) && millis () - _joinPendingSince > _config.joinPendingMaximum)
+            healthFault (Fault::STUCK, "join pending for " + String ((millis () - _joinPendingSince) / 1000) + " s");
+        else if (_state != State::P2P_READY && millis () - _commander.lastResponse () > _config.healthInterval && ! _commander.probe (HEALTH_PROBE_TIMEOUT))    // receiving P2P, the module rejects commands
+            healthFault (Fault::UNRESPONSIVE, "no response to probe");
+    }
+    void timerRecover () {
+        if (_fault != Fault::NONE)
+            healthRecover ();
+    }
+    void timerTransmitConfirmation () {
+        if (_uplink.confirmation == Confirmation::PENDING)
+            updateTransmitConfirmation (Confirmation::TIMEOUT);
     }
 
     //
 
-    bool updateNetworkTime () {
-        if (! _status.networkTime.lastResult () || _intervalNetworkTime) {
-            RakDeviceCommand_TIMEREQUEST commandTimeRequest (true);
-            if (! _commander.issue (commandTimeRequest).success)
+    void healthFault (const Fault fault, const String &reason) {
+        if (_fault != Fault::NONE)
+            return;
+        RAKDEVICE_LOG (MANAGER, WARNING, "RakDeviceManager::HEALTH: fault, %s\n", reason.c_str ());
+        _fault = fault;
+        _faultDetected = millis ();
+        _status.health.faults++;
+        _status.health.lastFault = reason;
+        if (hasEventListeners (Event::STATUS_HEALTH))
+            notifyEventListeners (Event::STATUS_HEALTH, { "FAULT", reason });
+        _scheduler.start (_timerRecover, 0);    // not from within whatever noticed it
+    }
+    void healthRestarted () {
+        if (! _recovering && (_state == State::JOIN_PENDING || _state == State::JOIN_SUCCESS || _state == State::JOIN_FAILURE || _state == State::P2P_READY))
+            healthFault (Fault::RESTARTED, "module restarted");
+    }
+    bool healthReinitialise () {    // as begin (), but settings the module still holds are not written again
+        if (! baudRateEstablish ())
+            return false;
+        RakDeviceCommand_NWM commandModeNetwork;
+        if (_commander.issue (commandModeNetwork).success && commandModeNetwork.getValue () == static_cast<int> (_config.loraOperation.mode))
+            _status.health.settingsSkipped++;
+        else {
+            RakDeviceCommand_NWM commandModeNetworkSet (static_cast<int> (_config.loraOperation.mode));
+            if (! _commander.issue (commandModeNetworkSet).success)
                 return false;
         }
+        if (_config.loraOperation.mode == Lora::Mode::MODE_P2PLORA) {
+            _p2pReceiving = _p2pTransmitting = false;
+            return p2pBegin ();
+        }
+        if (! configure (true))
+            return false;
+        _state = State::INITIALISED;
+        joinCommence ();
         return true;
     }
+    void healthRecover () {
+        // tiered, cheapest first: probe, then AT+RESET, then re-initialise from the configuration
+        _recovering = true;
+        bool recovered = false;
+        const char *tier = "";
+        if (_fault == Fault::UNRESPONSIVE) {
+            _status.health.probes++;
+            if ((recovered = _commander.probe (HEALTH_PROBE_TIMEOUT)))
+                tier = "probe";
+        }
+        if (! recovered && _fault != Fault::RESTARTED) {
+            _status.health.resets++;
+            _transceiver.send ("AT" + String (CMD_RESET));    // no reply is expected, the module may not give one
+            delay (RESET_SETTLE_DELAY);
+        }
+        if (! recovered) {
+            _status.health.reinitialisations++;
+            if ((recovered = healthReinitialise ()))
+                tier = _fault == Fault::RESTARTED ? "re-initialise" : "reset";
+        }
+        _recovering = false;
+        if (! recovered) {
+            _status.health.failures++;
+            RAKDEVICE_LOG (MANAGER, WARNING, "RakDeviceManager::HEALTH: recovery failed, retry in %lu s\n", _config.healthInterval / 1000);
+            _scheduler.start (_timerRecover, _config.healthInterval);
+            return;
+        }
+        const interval_t elapsed = millis () - _faultDetected;
+        _status.health.recoveries++;
+        _status.health.recoveryTotal += elapsed;
+        if (elapsed > _status.health.recoveryMaximum)
+            _status.health.recoveryMaximum = elapsed;
+        _fault = Fault::NONE;
+        RAKDEVICE_LOG (MANAGER, INFO, "RakDeviceManager::HEALTH: recovered by %s, in %lu ms (mttr=%lu ms)\n", tier, elapsed, _status.health.mttr ());
+        if (hasEventListeners (Event::STATUS_HEALTH))
+            notifyEventListeners (Event::STATUS_HEALTH, { "RECOVERED", tier });
+    }
+
+    //
+
+    void updateClass () {
+        RakDeviceCommand_CLASS commandClass;
+        if (_commander.issue (commandClass).success)
+            updateStatusClass (commandClass.getClass (), commandClass.getClassBStatus ());
+    }
+    void classBAcquire () {
+        RakDeviceCommand_PINGSLOT commandPingSlotSet (_config.loraParameters.pingSlotPeriodicity);
+        RakDeviceCommand_CLASS commandClassSet (String ((char) Lora::Class::CLASS_B));
+        if (! _commander.issue (commandPingSlotSet).success || ! _commander.issue (commandClassSet).success) {
+            RAKDEVICE_LOG (MANAGER, INFO, "RakDeviceManager::CLASS-B: unable to switch, retry later\n");
+            _scheduler.start (_timerBeaconRetry, _config.beaconRetryInterval);
+            updateStatusClass (Lora::Class::CLASS_A, Lora::ClassB_Status::BEACON_FAILED);
+            return;
+        }
+        _scheduler.start (_timerBeaconAcquire, _config.beaconAcquireTimeout);
+        updateStatusClass (Lora::Class::CLASS_B, Lora::ClassB_Status::DEVICETIME_REQ);
+    }
+    void classBFallback (const String &reason) {
+        RAKDEVICE_LOG (MANAGER, WARNING, "RakDeviceManager::CLASS-B: %s, falling back to Class A\n", reason.c_str ());
+        RakDeviceCommand_CLASS commandClassSet (String ((char) Lora::Class::CLASS_A));
+        (void) _commander.issue (commandClassSet);
+        _scheduler.cancel (_timerBeaconAcquire);
+        _scheduler.start (_timerBeaconRetry, _config.beaconRetryInterval);
+        updateStatusClass (Lora::Class::CLASS_A, Lora::ClassB_Status::BEACON_FAILED);
+    }
+    void updateBeaconStatus (const String &details) {
+        // +BC: ONGOING, +BC: LOCKED, +BC: DONE, +BC: LOST, +BC: FAILED_errorcode
+        String status (details);
+        status.trim ();
+        RAKDEVICE_LOG (MANAGER, INFO, "RakDeviceManager::CLASS-B: beacon %s\n", status.c_str ());
+        if (_status.deviceClass.get () != Lora::Class::CLASS_B)
+            return;
+        if (status.startsWith ("LOCKED") || status.startsWith ("DONE"))
+            updateStatusClass (Lora::Class::CLASS_B, Lora::ClassB_Status::BEACON_LOCKED);
+        else if (status.startsWith ("ONGOING"))
+            updateStatusClass (Lora::Class::CLASS_B, Lora::ClassB_Status::BEACON_SEARCHING);
+        else if (status.startsWith ("LOST") || status.startsWith ("FAILED"))
+            classBFallback ("beacon " + status);
+    }
+    void updatePingSlotStatus (const String &details) {
+        // +PS: DONE, the network has acknowledged our ping slot periodicity
+        RAKDEVICE_LOG (MANAGER, INFO, "RakDeviceManager::CLASS-B: ping slot %s\n", details.c_str ());
+    }
+
+    //
+
+    void updateWorkMode (const Lora::Mode mode) {
+        RAKDEVICE_LOG (MANAGER, INFO, "RakDeviceManager::WORK-MODE: %s\n", Lora::toString (mode).c_str ());
+    }
+
+    //
+
+    bool updateNetworkTime () {
+        _scheduler.start (_timerNetworkTime, _clock.synchronised () ? _config.networkTimeInterval : _config.statusInterval);    // retry, unless a sync re-arms it sooner or later
+        RakDeviceCommand_TIMEREQUEST commandTimeRequest (true);
+        return _commander.issue (commandTimeRequest).success;
+    }
     void updateNetworkTime (const RakDeviceCommand_TIMEREQUEST &commandTimeRequest) {
         if (commandTimeRequest.succeeded ()) {
             RakDeviceCommand_LTIME commandTimeRetrieve;
-            if (_commander.issue (commandTimeRetrieve).success) {
-                _status.networkTime = commandTimeRetrieve.responseGet ();
-                _intervalNetworkTime.reset ();
-                RAKDEVICE_DEBUG_PRINTF ("RakDeviceManager::NETWORK-TIME: %s\n", _status.networkTime.get ().c_str ());
-                notifyEventListeners (Event::NETWORK_TIME, { _status.networkTime });
+            const interval_t requested = millis ();
+            uint64_t epoch;
+            if (_commander.issue (commandTimeRetrieve).success && commandTimeRetrieve.getTimeEpoch (epoch)) {
+                const interval_t responded = millis ();    // the time was read somewhere in between: take the midpoint, and the middle of the reported second
+                _clock.synchronise (epoch + RakDeviceClock::RESOLUTION / 2, requested + (responded - requested) / 2);
+                _status.networkTime = epoch;
+                const interval_t interval = _clock.interval (_config.networkTimeInterval, _config.networkTimeIntervalMaximum, _config.networkTimeTolerance);
+                _scheduler.start (_timerNetworkTime, interval);
+                RAKDEVICE_LOG (MANAGER, INFO, "RakDeviceManager::NETWORK-TIME: %s, drift=%.1f ppm, next=%lu s\n", RakDeviceClock::toString (epoch).c_str (), _clock.drift (), interval / 1000);
+                if (hasEventListeners (Event::NETWORK_TIME))
+                    notifyEventListeners (Event::NETWORK_TIME, { RakDeviceClock::toString (epoch) });
             } else
                 _status.networkTime.invalidate ();
         }
@@ -458,50 +1518,97 @@ private:
     }
     void updateLinkStatus (const RakDeviceCommand_LINKCHECK &command) {
         const auto &result = command.getResult ();
-        if (result.success)
+        if (result.success) {
             updateStatusLink (result.status);
+            _linkOptimiser.recordLink (result.status);
+        }
     }
-    void updateSignalQuality () {
-        RakDeviceCommand_RSSI_LAST commandRSSI;
-        RakDeviceCommand_SNR_LAST commandSNR;
-        if (_commander.issue (commandRSSI).success && _commander.issue (commandSNR).success)
-            updateStatusReceive ({ .RSSI = commandRSSI.RSSI (), .SNR = commandSNR.SNR () });
-    }
-    void updateChannelHealth () {
-        RakDeviceCommand_RSSI_ALL commandRSSI;
-        if (_commander.issue (commandRSSI).success)
-            updateStatusChannel (commandRSSI.getChannelsRSSI ());
+    void updateLinkOptimiser () {
+        RakDeviceLinkOptimiser::Decision decision;
+        if (! _linkOptimiser.evaluate (decision))
+            return;
+        RakDeviceCommand_DATARATE commandDataRateSet (static_cast<int> (decision.dataRate));
+        RakDeviceCommand_TX_POWER commandTxPowerSet (static_cast<int> (decision.txPower));
+        if (decision.dataRate != _status.dataRate) {
+            if (! _commander.issue (commandDataRateSet).success)
+                return;
+            _status.dataRate = decision.dataRate;
+        }
+        if (decision.txPower != _status.txPower && _commander.issue (commandTxPowerSet).success)
+            _status.txPower = decision.txPower;
+        RAKDEVICE_LOG (MANAGER, INFO, "RakDeviceManager::LINK-OPTIMISER: DataRate=%d, TxPower=%d, delivery=%.2f\n", static_cast<int> (_status.dataRate), static_cast<int> (_status.txPower), _linkOptimiser.deliveryRatio ());
+        _linkOptimiser.apply ({ .dataRate = _status.dataRate, .txPower = _status.txPower });
     }
 
     //
 
+    bool networkAdaptiveDataRate () const {
+        return _config.loraParameters.adaptiveDataRate && ! _linkOptimiser.enabled ();
+    }
     bool updateStatus () {
-        updateSignalQuality ();
-        updateChannelHealth ();
-        return true;
+        RakDeviceCommand_RSSI_LAST commandRSSI;
+        RakDeviceCommand_SNR_LAST commandSNR;
+        RakDeviceCommand_RSSI_ALL commandRSSIAll;
+        RakDeviceCommand_DATARATE commandDataRate;
+        RakDeviceCommand *const commands [] = { &commandRSSI, &commandSNR, &commandRSSIAll, &commandDataRate };
+        const size_t count = sizeof (commands) / sizeof (commands [0]) - (networkAdaptiveDataRate () ? 0 : 1);    // the data rate only moves under network ADR
+        RakDeviceResult results [sizeof (commands) / sizeof (commands [0])];
+        const bool success = _commander.issueBatch (commands, count, results).success;
+        if (results [0].success && results [1].success)
+            updateStatusReceive ({ .RSSI = commandRSSI.RSSI (), .SNR = commandSNR.SNR () });
+        if (results [2].success)
+            updateStatusChannel (commandRSSIAll.getChannelsRSSI ());
+        if (count > 3 && results [3].success && commandDataRate.getValue () != static_cast<int> (_status.dataRate)) {    // payload limits follow it
+            RAKDEVICE_LOG (MANAGER, INFO, "RakDeviceManager::STATUS-DATARATE: %s, maximum payload %d\n", _region.toString (static_cast<Lora::Datarate> (commandDataRate.getValue ())).c_str (), _region.maximumPayloadSize (static_cast<Lora::Datarate> (commandDataRate.getValue ())));
+            _status.dataRate = static_cast<Lora::Datarate> (commandDataRate.getValue ());
+        }
+        return success;
     }
 
     void updateStatusReceive (const Lora::ReceiveStatus &status) {
         _status.receiveStatus = status;
-        RAKDEVICE_DEBUG_PRINTF ("RakDeviceManager::STATUS-RECEIVE: %s\n", Lora::toString (status).c_str ());
-        if (status.RSSI != 0)
-            notifyEventListeners (Event::STATUS_RECEIVE, { Lora::toString (status), String (status.RSSI) });
+        RAKDEVICE_LOG (MANAGER, INFO, "RakDeviceManager::STATUS-RECEIVE: %s\n", Lora::toString (status).c_str ());
+        if (status.RSSI != 0) {
+            _status.history.receiveRSSI.add (status.RSSI);
+            _status.history.receiveSNR.add (status.SNR);
+            if (hasEventListeners (Event::STATUS_RECEIVE))
+                notifyEventListeners (Event::STATUS_RECEIVE, { Lora::toString (status), String (status.RSSI) });
+        }
     }
     void updateStatusLink (const Lora::LinkStatus &status) {
         _status.linkStatus = status;
-        RAKDEVICE_DEBUG_PRINTF ("RakDeviceManager::STATUS-LINK: %s\n", Lora::toString (status).c_str ());
-        if (status.RSSI != 0)
+        RAKDEVICE_LOG (MANAGER, INFO, "RakDeviceManager::STATUS-LINK: %s\n", Lora::toString (status).c_str ());
+        if (status.NbGateways > 0) {
+            _status.history.linkRSSI.add (status.RSSI);
+            _status.history.linkSNR.add (status.SNR);
+            _status.history.linkMargin.add (status.DemodMargin);
+        }
+        _status.history.linkGateways.add (status.NbGateways);
+        if (status.RSSI != 0 && hasEventListeners (Event::STATUS_LINK))
             notifyEventListeners (Event::STATUS_LINK, { Lora::toString (status), String (status.RSSI) });
     }
+    void updateStatusClass (const Lora::Class clazz, const Lora::ClassB_Status beaconStatus) {
+        const bool changed = ! _status.deviceClass.lastResult () || _status.deviceClass.get () != clazz || (clazz == Lora::Class::CLASS_B && _status.beaconStatus != beaconStatus);
+        _status.deviceClass = clazz;
+        _status.beaconStatus = beaconStatus;
+        _energy.listening (clazz == Lora::Class::CLASS_C);
+        RAKDEVICE_LOG (MANAGER, INFO, "RakDeviceManager::STATUS-CLASS: %s%s%s\n", Lora::toString (clazz).c_str (), clazz == Lora::Class::CLASS_B ? ", " : "", clazz == Lora::Class::CLASS_B ? Lora::toString (beaconStatus).c_str () : "");
+        if (changed && hasEventListeners (Event::STATUS_CLASS))
+            notifyEventListeners (Event::STATUS_CLASS, { Lora::toString (clazz), Lora::toString (beaconStatus) });
+    }
     void updateStatusChannel (const Status::Channels &status) {
         _status.channelStatus = status;
-        RAKDEVICE_DEBUG_PRINTF ("RakDeviceManager::STATUS-CHANNEL: %s\n", Status::toString (status).c_str ());
-        bool nonZeroRSSI = false;
-        for (const auto &channelRSSI : status)
-            if (channelRSSI.second != Lora::RSSI (0))
-                nonZeroRSSI = true;
-        if (nonZeroRSSI)
-            notifyEventListeners (Event::STATUS_CHANNEL, { Status::toString (status) });
+        RAKDEVICE_LOG (MANAGER, INFO, "RakDeviceManager::STATUS-CHANNEL: %s\n", Status::toString (status).c_str ());
+        int reporting = 0, total = 0;
+        for (int channel = 0; channel < Lora::MAXIMUM_CHANNELS; channel++)
+            if (status.has (channel) && status.RSSI [channel] != Lora::RSSI (0))
+                reporting++, total += status.RSSI [channel];
+        if (reporting > 0) {
+            _status.history.channelRSSI.add (static_cast<float> (total) / reporting);
+            _channelHealth.record (status);
+            if (hasEventListeners (Event::STATUS_CHANNEL))
+                notifyEventListeners (Event::STATUS_CHANNEL, { Status::toString (status) });
+        }
     }
 
     //
@@ -510,27 +1617,40 @@ private:
         if (event.type.startsWith ("JOIN"))
             updateJoinStatus (RakDeviceCommand_JOIN (event));    // +EVT:JOINED, +EVT:JOIN_FAILED_TX_TIMEOUT, +EVT:JOIN_FAILED_RX_TIMEOUT, +EVT:JOIN_FAILED_errorcode
         else if (event.type.startsWith ("SEND"))
-            updateTransmitStatus (RakDeviceCommand_SEND (event));    // +EVT:SEND_CONFIRMED_OK, +EVT:SEND_CONFIRMED_FAILED
+            updateTransmitConfirmation (RakDeviceCommand_SEND (event).wasConfirmed () ? Confirmation::CONFIRMED : Confirmation::FAILED);    // +EVT:SEND_CONFIRMED_OK, +EVT:SEND_CONFIRMED_FAILED
+        else if (event.type == "TX_DONE")
+            updateTransmitDone ();    // +EVT:TX_DONE
         else if (event.type.startsWith ("LINKCHECK"))
             updateLinkStatus (RakDeviceCommand_LINKCHECK (event));    // +EVT:LINKCHECK:Y0,Y1,Y2,Y3,Y4
         else if (event.type.startsWith ("TIMEREQ"))
             updateNetworkTime (RakDeviceCommand_TIMEREQUEST (event));    // +EVT:TIMEREQ_FAILED, +EVT:TIMEREQ_OK
         else if (event.type == "BC")
-            ;    // updateBeaconStatus (event.args);    // +BC: ... LOCKED/DONE/FAILED//ONGOING/LOST/FAILED_errorcode
+            updateBeaconStatus (event.args);    // +BC: ... LOCKED/DONE/FAILED//ONGOING/LOST/FAILED_errorcode
         else if (event.type == "PS")
-            ;    // updatePingSlotStatus (event.args);    // +PS: ... DONE
+            updatePingSlotStatus (event.args);    // +PS: ... DONE
+        else if (event.type == "TXP2P DONE")
+            updateTransmitP2P ();    // +EVT:TXP2P DONE
+        else if (event.type == "RXP2P")
+            updateReceiveP2P (event.args);    // +EVT:RXP2P:-26:7:414243
+        else if (event.type.startsWith ("RXP2P"))
+            _p2pReceiving = false, p2pReceive ();    // +EVT:RXP2P RECEIVE TIMEOUT
         else if (event.type == "RX_1" || event.type == "RX_2")
-            updateReceive (Lora::Class::CLASS_A, event.args);    // +EVT:RX_1:-70:8:UNICAST:1:1234
+            updateReceive (event.type == "RX_1" ? Lora::Window::RX_1 : Lora::Window::RX_2, event.args);    // +EVT:RX_1:-70:8:UNICAST:1:1234
         else if (event.type == "RX_B")
-            updateReceive (event.args.indexOf ("UNICAST") > 0 ? Lora::Class::CLASS_B : Lora::Class::CLASS_C, event.args);    // +EVT:RX_B:-47:3:UNICAST:2:4321
+            updateReceive (Lora::Window::RX_B, event.args);    // +EVT:RX_B:-47:3:UNICAST:2:4321
+        else if (event.type == "RX_C")
+            updateReceive (Lora::Window::RX_C, event.args);    // +EVT:RX_C:-47:3:UNICAST:2:4321
         else if (event.type == "RestrictedWait")
             updateNetworkRestriction (std::atol (event.args.c_str ()));    // Restricted_Wait_3343902_ms
+        else if (event.type == "Restart")
+            healthRestarted ();    // RAKwireless RAK3272-SiP Example
         else if (event.type == "CurrentWorkMode")
             updateWorkMode ((event.args == "LoRaWAN" ? Lora::Mode::MODE_LORAWAN : (event.args == "P2PLoRa" ? Lora::Mode::MODE_P2PLORA : (event.args == "P2PFSK" ? Lora::Mode::MODE_P2PFSK : Lora::Mode::MODE_UNDEFINED))));    // Current Work Mode: LoRaWAN.
         else
-            RAKDEVICE_DEBUG_PRINTF ("RakDeviceManager::EVENT: UNHANDLED, type=(%s), args=(%s)\n", event.type.c_str (), event.args.c_str ());
+            RAKDEVICE_LOG (MANAGER, WARNING, "RakDeviceManager::EVENT: UNHANDLED, type=(%s), args=(%s)\n", event.type.c_str (), event.args.c_str ());
     }
 };
+using RakDeviceManager = RakDeviceManagerT<Stream>;
 
 // -----------------------------------------------------------------------------------------------
 // -----------------------------------------------------------------------------------------------
@@ -2,12 +2,19 @@
 // -----------------------------------------------------------------------------------------------
 // -----------------------------------------------------------------------------------------------
 
+#include <condition_variable>
 #include <mutex>
-#include <queue>
 
-class RakDeviceMessenger {
+#ifndef RAKDEVICE_TRANSMIT_QUEUE_SIZE
+#define RAKDEVICE_TRANSMIT_QUEUE_SIZE 32
+#endif
+
+template <typename Device = RakDeviceManager>
+class RakDeviceMessengerT {
 public:
     static constexpr interval_t RETRY_DELAY = 30 * 1000;    // 10 seconds in milliseconds
+    static constexpr interval_t CONGESTION_DEFER_MAXIMUM = 60 * 1000;    // hold back while channels are busy, but not for longer
+    static constexpr size_t TRANSMIT_QUEUE_MAXIMUM = RAKDEVICE_TRANSMIT_QUEUE_SIZE;    // storage, Config::capacity may be less
 
     struct Message {
         Lora::Port port;
@@ -21,104 +28,245 @@ public:
             timestamp (t) { }
     };
 
+    enum class Overflow {
+        DROP_OLDEST,    // the oldest message not already in flight makes room
+        DROP_NEWEST,    // the incoming message is refused
+        MERGE           // the incoming message is folded into the newest queued for the same port, else refused
+    };
+#ifdef RAKDEVICE_FIXED_CAPACITY
+    using Merge = bool (*) (Message &queued, const Message &incoming);
+    using WaterMark = void (*) (const bool high, const size_t size);
+#else
+    using Merge = std::function<bool (Message &queued, const Message &incoming)>;
+    using WaterMark = std::function<void (const bool high, const size_t size)>;    // high: reached highWater, else fell back to lowWater
+#endif
+    struct Config {
+        size_t capacity { TRANSMIT_QUEUE_MAXIMUM };    // at most TRANSMIT_QUEUE_MAXIMUM
+        size_t highWater { 24 }, lowWater { 8 };
+        Overflow overflow { Overflow::DROP_NEWEST };
+        Merge merge;
+        WaterMark waterMark;    // called without the queue locked, so it may query or transmit
+        bool energyBudget { false };    // hold uplinks back to the device's energy budget, see RakDeviceEnergyModel::Config
+    };
+
 private:
-    RakDeviceManager &_device;
-    RakDeviceManager::EventHandlerId _handlerId;
-    mutable std::mutex _receiveMutex;
-    std::queue<Message> _receiveQueue;
+    const Config _config;
+    Device &_device;
+    typename Device::EventHandlerId _handlerId;
+    typename Device::Scheduler::TimerId _timerId;    // retry, deferral, or a message not yet due
     mutable std::mutex _transmitMutex;
-    std::queue<Message> _transmitQueue;
-    bool _transmitPending = false;
+    std::condition_variable _transmitSpace;
+    RakDeviceQueue<Message, TRANSMIT_QUEUE_MAXIMUM> _transmitQueue;
+    bool _transmitPending = false, _transmitHigh = false, _throttled = false;
+    interval_t _deferredSince = 0;
 
     struct Stats {
         size_t transmitsAttempted = 0;
         size_t transmitsSucceeded = 0;
         size_t transmitsFailed = 0;
         size_t retransmitsAttempted = 0;
+        size_t transmitsDeferred = 0;
+        size_t transmitsDropped = 0, transmitsMerged = 0, transmitsRefused = 0;
+        size_t transmitsThrottled = 0;
+        size_t transmitsOversize = 0;    // larger than the data rate carries, refused or dropped
     } _stats;
 
-    void onDeviceEvent (const RakDeviceManager::Event event, const RakDeviceManager::EventArgs &args) {
+    enum class WaterMarkChange { NONE,
+                                 HIGH,
+                                 LOW };
+    size_t capacity () const { return std::min (_config.capacity, TRANSMIT_QUEUE_MAXIMUM); }
+    WaterMarkChange updateWaterMark () {    // with the queue locked
+        const size_t size = _transmitQueue.size ();
+        if (! _transmitHigh && size >= _config.highWater)
+            return _transmitHigh = true, WaterMarkChange::HIGH;
+        if (_transmitHigh && size <= _config.lowWater)
+            return _transmitHigh = false, WaterMarkChange::LOW;
+        return WaterMarkChange::NONE;
+    }
+    void notifyWaterMark (const WaterMarkChange change) {    // with the queue unlocked
+        if (change != WaterMarkChange::NONE && _config.waterMark)
+            _config.waterMark (change == WaterMarkChange::HIGH, transmit_queue_size ());
+    }
+    bool enqueue (const Message &message) {    // with the queue locked
+        if (message.data.length () > _device.maximumPayloadSize ()) {    // the device would refuse it every time, and it would hold up the queue
+            _stats.transmitsOversize++;
+            RAKDEVICE_LOG (MESSENGER, WARNING, "Messenger: Transmit refused, %u bytes exceeds %u -- port=%d\n", message.data.length (), _device.maximumPayloadSize (), message.port);
+            return false;
+        }
+        const size_t first = _transmitPending ? 1 : 0;    // the one in flight stays
+        if (_transmitQueue.size () >= capacity ()) {
+            if (_config.overflow == Overflow::DROP_OLDEST && _transmitQueue.size () > first) {
+                _transmitQueue.erase (first);
+                _stats.transmitsDropped++;
+            } else if (_config.overflow == Overflow::MERGE && _config.merge) {
+                for (size_t i = _transmitQueue.size (); i > first; i--)
+                    if (_transmitQueue [i - 1].port == message.port) {
+                        if (! _config.merge (_transmitQueue [i - 1], message))
+                            break;
+                        _stats.transmitsMerged++;
+                        return true;
+                    }
+                _stats.transmitsRefused++;
+                return false;
+            } else {
+                _stats.transmitsRefused++;
+                return false;
+            }
+        }
+        RAKDEVICE_LOG (MESSENGER, DEBUG, "Messenger: Transmit enqueue (queue_size=%d) -- port=%d, data=%s\n", _transmitQueue.size () + 1, message.port, message.data.c_str ());
+        _transmitQueue.push (message);
+        _device.scheduler ().start (_timerId, 0);    // sent from process (): never from the caller's thread, which may be holding up the device
+        return true;
+    }
 
-        if (event == RakDeviceManager::Event::DATA_RECEIVED) {
-            std::lock_guard<std::mutex> guard (_receiveMutex);
-            _receiveQueue.push (Message (args [0].toInt (), args [1], false, millis ()));
+    void onDeviceEvent (const typename Device::Event event, const typename Device::EventArgs &args) {
 
-        } else if (event == RakDeviceManager::Event::TRANSMIT_SUCCESS) {
-            std::lock_guard<std::mutex> guard (_transmitMutex);
+        if (event == Device::Event::TRANSMIT_SUCCESS) {
+            std::unique_lock<std::mutex> lock (_transmitMutex);
             _transmitPending = false;
             _stats.transmitsSucceeded++;
-            _transmitQueue.pop ();
-            RAKDEVICE_DEBUG_PRINTF ("Messenger: Transmit success (successes=%u, failures=%u, retries=%u)\n", _stats.transmitsSucceeded, _stats.transmitsFailed, _stats.retransmitsAttempted);
+            if (! _transmitQueue.empty ())
+                _transmitQueue.pop ();
+            RAKDEVICE_LOG (MESSENGER, INFO, "Messenger: Transmit success (successes=%u, failures=%u, retries=%u)\n", _stats.transmitsSucceeded, _stats.transmitsFailed, _stats.retransmitsAttempted);
+            _device.scheduler ().start (_timerId, 0);    // next one straight away, e.g. ahead of the P2P receive turnaround
+            const WaterMarkChange change = updateWaterMark ();
+            lock.unlock ();
+            _transmitSpace.notify_all ();
+            notifyWaterMark (change);
 
-        } else if (event == RakDeviceManager::Event::TRANSMIT_FAILURE) {
+        } else if (event == Device::Event::JOIN_SUCCESS) {
+            _device.scheduler ().start (_timerId, 0);    // anything refused while not joined, without waiting out the retry
+
+        } else if (event == Device::Event::TRANSMIT_FAILURE) {
             std::lock_guard<std::mutex> guard (_transmitMutex);
             _transmitPending = false;
             _stats.transmitsFailed++;
             if (! _transmitQueue.empty ()) {
                 Message &message = _transmitQueue.front ();
                 message.timestamp = millis () + RETRY_DELAY;
-                RAKDEVICE_DEBUG_PRINTF ("Messenger: Transmit failure, retry in %u ms (successes=%u, failures=%u, retries=%u)\n", RETRY_DELAY, _stats.transmitsSucceeded, _stats.transmitsFailed, _stats.retransmitsAttempted);
+                _device.scheduler ().start (_timerId, RETRY_DELAY);
+                RAKDEVICE_LOG (MESSENGER, WARNING, "Messenger: Transmit failure, retry in %u ms (successes=%u, failures=%u, retries=%u)\n", RETRY_DELAY, _stats.transmitsSucceeded, _stats.transmitsFailed, _stats.retransmitsAttempted);
             }
         }
     }
 
-    void doProcess () {
+    void doProcess () {    // with the queue unlocked: the device is entered without it, as the device's events lock it
+        std::unique_lock<std::mutex> lock (_transmitMutex);
         if (! _transmitPending && ! _transmitQueue.empty ()) {
-            const Message &message = _transmitQueue.front ();
-            if (millis () >= message.timestamp) {
-                RAKDEVICE_DEBUG_PRINTF ("Messenger: Transmit actuate (attempt=%u) -- port=%d, data=%s\n", _stats.transmitsAttempted, message.port, message.data.c_str ());
-                if (_device.transmit (message.port, message.data)) {
-                    _transmitPending = true;
-                    _stats.retransmitsAttempted++;
-                    _stats.transmitsAttempted++;
+            const Message message = _transmitQueue.front ();    // a copy, the queue may change while it is sent
+            const interval_t current = millis ();
+            if (message.data.length () > _device.maximumPayloadSize ()) {    // the data rate has dropped since it was queued
+                _transmitQueue.pop ();
+                _stats.transmitsOversize++;
+                RAKDEVICE_LOG (MESSENGER, WARNING, "Messenger: Transmit dropped, %u bytes exceeds %u -- port=%d\n", message.data.length (), _device.maximumPayloadSize (), message.port);
+                _device.scheduler ().start (_timerId, 0);
+                const WaterMarkChange change = updateWaterMark ();
+                lock.unlock ();
+                _transmitSpace.notify_all ();
+                notifyWaterMark (change);
+                return;
+            }
+            if (current < message.timestamp) {
+                _device.scheduler ().start (_timerId, message.timestamp - current);
+                return;
+            }
+            if (_config.energyBudget) {
+                const interval_t wait = _device.energyBudgetWait (message.data.length ());
+                if (wait > 0) {
+                    if (! _throttled)
+                        _throttled = true, _stats.transmitsThrottled++;
+                    RAKDEVICE_LOG (MESSENGER, DEBUG, "Messenger: Transmit throttled by energy budget, %lu ms\n", wait);
+                    _device.scheduler ().start (_timerId, wait);
+                    return;
+                }
+                _throttled = false;
+            }
+            if (_device.isCongested ()) {
+                if (_deferredSince == 0)
+                    _deferredSince = current, _stats.transmitsDeferred++;
+                if (current - _deferredSince < CONGESTION_DEFER_MAXIMUM) {
+                    _device.scheduler ().start (_timerId, CONGESTION_DEFER_MAXIMUM - (current - _deferredSince));
+                    return;
                 }
             }
+            _deferredSince = 0;
+            RAKDEVICE_LOG (MESSENGER, DEBUG, "Messenger: Transmit actuate (attempt=%u) -- port=%d, data=%s\n", _stats.transmitsAttempted, message.port, message.data.c_str ());
+            _transmitPending = true;    // in flight from here: kept at the head, and its outcome may arrive before transmit () returns
+            lock.unlock ();
+            const bool sent = _device.transmit (message.port, message.data);
+            lock.lock ();
+            if (sent) {
+                _stats.retransmitsAttempted++;
+                _stats.transmitsAttempted++;
+            } else {    // not joined, asleep, restricted or busy: nothing else would come back to it
+                _transmitPending = false;
+                _device.scheduler ().start (_timerId, RETRY_DELAY);
+                RAKDEVICE_LOG (MESSENGER, WARNING, "Messenger: Transmit refused, retry in %u ms\n", RETRY_DELAY);
+            }
         }
     }
 
 public:
-    explicit RakDeviceMessenger (RakDeviceManager &device) :
+    RakDeviceMessengerT (Device &device, const Config &config) :
+        _config (config),
         _device (device) {
-        _handlerId = _device.addEventListener ([this] (const RakDeviceManager::Event event, const RakDeviceManager::EventArgs &args) {
-            this->onDeviceEvent (event, args);
-        });
+        _handlerId = _device.template addEventListener<RakDeviceMessengerT, &RakDeviceMessengerT::onDeviceEvent> (this, Device::eventMask (Device::Event::JOIN_SUCCESS, Device::Event::TRANSMIT_SUCCESS, Device::Event::TRANSMIT_FAILURE));
+        _timerId = _device.scheduler ().template add<RakDeviceMessengerT, &RakDeviceMessengerT::process> (this);
     }
 
-    ~RakDeviceMessenger () {
+    explicit RakDeviceMessengerT (Device &device) :
+        RakDeviceMessengerT (device, Config ()) { }
+
+    ~RakDeviceMessengerT () {
+        _device.scheduler ().remove (_timerId);
         _device.removeEventListener (_handlerId);
     }
 
-    bool transmit (const Message &message) {
-        std::lock_guard<std::mutex> guard (_transmitMutex);
-        RAKDEVICE_DEBUG_PRINTF ("Messenger: Transmit enqueue (queue_size=%d) -- port=%d, data=%s\n", _transmitQueue.size () + 1, message.port, message.data.c_str ());
-        _transmitQueue.push (message);
-        doProcess ();
-        return true;
+    bool try_transmit (const Message &message) {    // never blocks, a full queue is handled by the overflow policy
+        std::unique_lock<std::mutex> lock (_transmitMutex);
+        const bool queued = enqueue (message);
+        const WaterMarkChange change = updateWaterMark ();
+        lock.unlock ();
+        notifyWaterMark (change);
+        return queued;
+    }
+    bool transmit_for (const Message &message, const interval_t timeout) {    // waits up to timeout for space, then as try_transmit
+        std::unique_lock<std::mutex> lock (_transmitMutex);
+        _transmitSpace.wait_for (lock, std::chrono::milliseconds (timeout), [this] { return _transmitQueue.size () < capacity (); });
+        const bool queued = enqueue (message);
+        const WaterMarkChange change = updateWaterMark ();
+        lock.unlock ();
+        notifyWaterMark (change);
+        return queued;
+    }
+    inline bool transmit (const Message &message) {
+        return try_transmit (message);
     }
 
-    bool receive (Message &message) {
-        std::lock_guard<std::mutex> guard (_receiveMutex);
-        if (_receiveQueue.empty ())
-            return false;
-        message = _receiveQueue.front ();
-        _receiveQueue.pop ();
-        return true;
+    bool receive (typename Device::Downlink &downlink) {    // downlinks are held in the device's pool, release () each one after use
+        return _device.receive (downlink);
+    }
+    void release (typename Device::Downlink &downlink) {
+        _device.release (downlink);
     }
 
     size_t transmit_queue_size () const {
         std::lock_guard<std::mutex> guard (_transmitMutex);
         return _transmitQueue.size ();
     }
+    size_t transmit_queue_capacity () const {
+        return capacity ();
+    }
+    const Stats &stats () const { return _stats; }
     size_t receive_queue_size () const {
-        std::lock_guard<std::mutex> guard (_receiveMutex);
-        return _receiveQueue.size ();
+        return _device.receiveQueueSize ();
     }
     void process () {
-        RAKDEVICE_DEBUG_PRINTF ("RakDeviceMessenger: tx_queue=%d, rx_queue=%d\n", transmit_queue_size (), receive_queue_size ());
-        std::lock_guard<std::mutex> guard (_transmitMutex);
+        RAKDEVICE_LOG (MESSENGER, DEBUG, "RakDeviceMessenger: tx_queue=%d, rx_queue=%d\n", transmit_queue_size (), receive_queue_size ());
         doProcess ();
     }
 };
+using RakDeviceMessenger = RakDeviceMessengerT<RakDeviceManager>;
 
 // -----------------------------------------------------------------------------------------------
 // -----------------------------------------------------------------------------------------------
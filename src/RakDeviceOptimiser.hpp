@@ -0,0 +1,531 @@
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
+
+class RakDeviceLinkOptimiser {
+public:
+    static inline constexpr size_t HISTORY_SIZE = 20;
+    static inline constexpr float DATARATE_STEP_SNR = 2.5f;    // dB between adjacent spreading factors
+    static inline constexpr float TXPOWER_STEP_SNR = 2.0f;     // dB per TxPower index (EU868)
+
+    struct Config {
+        bool enabled { false };
+        float targetDelivery { 0.90f };     // fraction of confirmed uplinks that must succeed
+        float installationMargin { 10 };    // dB held in reserve, as network ADR does
+        float hysteresis { 3 };             // dB of surplus (or deficit) before changing anything
+        size_t minimumSamples { 6 };        // margin samples, at current settings, before deciding
+    };
+    struct Decision {
+        Lora::Datarate dataRate;
+        Lora::TxPower txPower;
+    };
+
+    float requiredSNR (const Lora::Datarate dataRate) const {    // demodulation floor, SF7 = -7.5 dB to SF12 = -20 dB
+        return -20.0f + (12 - _region.dataRate (dataRate).spreadingFactor) * DATARATE_STEP_SNR;
+    }
+
+private:
+    const Config _config;
+    const RakDeviceRegion &_region;
+    Decision _current;
+
+    float _margins [HISTORY_SIZE];
+    size_t _marginsCount = 0, _marginsNext = 0;
+    bool _deliveries [HISTORY_SIZE];
+    size_t _deliveriesCount = 0, _deliveriesNext = 0;
+
+    void recordMargin (const float margin) {
+        _margins [_marginsNext] = margin;
+        _marginsNext = (_marginsNext + 1) % HISTORY_SIZE;
+        if (_marginsCount < HISTORY_SIZE)
+            _marginsCount++;
+    }
+    float marginAverage () const {
+        float total = 0;
+        for (size_t i = 0; i < _marginsCount; i++)
+            total += _margins [i];
+        return total / _marginsCount;
+    }
+
+public:
+    RakDeviceLinkOptimiser (const Config &config, const RakDeviceRegion &region, const Lora::Datarate dataRate, const Lora::TxPower txPower) :
+        _config (config),
+        _region (region),
+        _current { .dataRate = dataRate, .txPower = txPower } { }
+
+    bool enabled () const { return _config.enabled; }
+    const Decision &current () const { return _current; }
+
+    void recordLink (const Lora::LinkStatus &status) {    // gateway side demodulation margin of our uplink
+        if (status.NbGateways > 0)
+            recordMargin (static_cast<float> (status.DemodMargin));
+    }
+    void recordReceive (const Lora::ReceiveStatus &status) {    // downlink SNR, used as a proxy for the uplink
+        recordMargin (static_cast<float> (status.SNR) - requiredSNR (_current.dataRate));
+    }
+    void recordDelivery (const bool delivered) {
+        _deliveries [_deliveriesNext] = delivered;
+        _deliveriesNext = (_deliveriesNext + 1) % HISTORY_SIZE;
+        if (_deliveriesCount < HISTORY_SIZE)
+            _deliveriesCount++;
+    }
+    float deliveryRatio () const {
+        size_t delivered = 0;
+        for (size_t i = 0; i < _deliveriesCount; i++)
+            if (_deliveries [i])
+                delivered++;
+        return _deliveriesCount > 0 ? static_cast<float> (delivered) / _deliveriesCount : 1.0f;
+    }
+
+    bool evaluate (Decision &decision) const {
+        if (! _config.enabled)
+            return false;
+        int dataRate = static_cast<int> (_current.dataRate), txPower = static_cast<int> (_current.txPower);
+        if (_deliveriesCount >= _config.minimumSamples && deliveryRatio () < _config.targetDelivery) {
+            // losing too much: more power first, then a slower rate
+            if (txPower > Lora::MINIMUM_TXPOWER)
+                txPower--;
+            else if (dataRate > _region.uplinkMinimum)
+                dataRate--;
+        } else if (_marginsCount >= _config.minimumSamples) {
+            float surplus = marginAverage () - _config.installationMargin;
+            if (surplus >= _config.hysteresis) {
+                // faster rate first (airtime dominates), then less power with what remains
+                while (surplus >= DATARATE_STEP_SNR && dataRate < _region.uplinkMaximum)
+                    dataRate++, surplus -= DATARATE_STEP_SNR;
+                while (surplus >= TXPOWER_STEP_SNR && txPower < Lora::MAXIMUM_TXPOWER)
+                    txPower++, surplus -= TXPOWER_STEP_SNR;
+            } else if (surplus <= -_config.hysteresis) {
+                while (surplus < 0 && txPower > Lora::MINIMUM_TXPOWER)
+                    txPower--, surplus += TXPOWER_STEP_SNR;
+                while (surplus < 0 && dataRate > _region.uplinkMinimum)
+                    dataRate--, surplus += DATARATE_STEP_SNR;
+            }
+        }
+        if (dataRate == static_cast<int> (_current.dataRate) && txPower == static_cast<int> (_current.txPower))
+            return false;
+        decision = { .dataRate = static_cast<Lora::Datarate> (dataRate), .txPower = static_cast<Lora::TxPower> (txPower) };
+        return true;
+    }
+    void apply (const Decision &decision) {
+        _current = decision;
+        _marginsCount = _marginsNext = 0;    // history at the previous settings no longer applies
+        _deliveriesCount = _deliveriesNext = 0;
+    }
+};
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
+
+// Noise floor and occupancy per channel, from periodic AT+ARSSI samples. A channel sitting well
+// above its own noise floor is busy; a site where most channels are busy at once is congested,
+// and uplinks are better deferred than sent into it.
+
+class RakDeviceChannelHealth {
+public:
+    using Channels = RakDeviceCommand_RSSI_ALL::ChannelsRSSI;
+
+    struct Config {
+        float busyThreshold { 6 };           // dB above the noise floor that counts as busy
+        float busyAlpha { 0.2f };            // weight of each new sample in the busy fraction
+        float noiseRiseAlpha { 0.02f };      // the noise floor follows drops quickly and rises slowly,
+        float noiseFallAlpha { 0.25f };      // ... so that bursts of traffic do not pull it up
+        float congestedFraction { 0.5f };    // of reporting channels busy in the latest sample
+        interval_t validity { 5 * 60 * 1000 };    // after which a sample no longer says anything
+    };
+    struct Channel {
+        float noiseFloor = 0, busyFraction = 0;
+        counter_t samples = 0;
+        bool busy = false;
+        float score () const { return 1.0f - busyFraction; }    // 1 = always quiet, 0 = always busy
+    };
+
+private:
+    const Config _config;
+    std::array<Channel, Lora::MAXIMUM_CHANNELS> _channels {};
+    int _reporting = 0, _busy = 0;
+    interval_t _updated = 0;
+
+public:
+    explicit RakDeviceChannelHealth (const Config &config) :
+        _config (config) { }
+
+    void record (const Channels &channels) {
+        _reporting = _busy = 0;
+        for (int number = 0; number < Lora::MAXIMUM_CHANNELS; number++) {
+            if (! channels.has (number))
+                continue;
+            Channel &channel = _channels [number];
+            const float RSSI = static_cast<float> (channels.RSSI [number]);
+            if (channel.samples++ == 0)
+                channel.noiseFloor = RSSI;
+            channel.busy = RSSI > channel.noiseFloor + _config.busyThreshold;
+            channel.busyFraction += _config.busyAlpha * ((channel.busy ? 1.0f : 0.0f) - channel.busyFraction);
+            channel.noiseFloor += (RSSI < channel.noiseFloor ? _config.noiseFallAlpha : _config.noiseRiseAlpha) * (RSSI - channel.noiseFloor);
+            _reporting++;
+            if (channel.busy)
+                _busy++;
+        }
+        _updated = millis ();
+    }
+
+    const Channel &channel (const int number) const { return _channels [number]; }
+    float score () const {    // mean across channels ever reported
+        float total = 0;
+        int count = 0;
+        for (const auto &channel : _channels)
+            if (channel.samples > 0)
+                total += channel.score (), count++;
+        return count > 0 ? total / count : 1.0f;
+    }
+    bool congested () const {
+        return _reporting > 0 && (millis () - _updated) < _config.validity && _busy >= _config.congestedFraction * _reporting;
+    }
+};
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
+
+// Join scheduling, one AT+JOIN attempt at a time: the fastest data rate first, stepping towards the
+// slowest after unanswered attempts, with randomised exponential backoff so that a fleet coming back
+// after a gateway outage does not rejoin in lockstep. Join airtime is held to the LoRaWAN 1.0.3
+// retransmission backoff: 36 s in the first hour, 36 s per 10 h until hour 11, then 8.7 s per 24 h.
+
+class RakDeviceJoinEngine {
+public:
+    static inline constexpr size_t JOIN_REQUEST_SIZE = 23 - Lora::FRAME_OVERHEAD_SIZE;    // MHDR, JoinEUI, DevEUI, DevNonce, MIC, as an application payload for timeOnAir ()
+    static inline constexpr size_t LEDGER_SIZE = 32;    // attempts remembered for the duty cycle
+    static inline constexpr interval_t HOUR = 60 * 60 * 1000;
+
+    enum class Failure {
+        RX_TIMEOUT,    // +EVT:JOIN_FAILED_RX_TIMEOUT, no Join-Accept: out of reach at this data rate, or lost in a collision
+        TX_TIMEOUT,    // +EVT:JOIN_FAILED_TX_TIMEOUT, the module did not get the request out
+        ERROR,         // +EVT:JOIN_FAILED_errorcode, or the request was not accepted
+        UNRESOLVED     // no event within attemptTimeout, and the module says not joined
+    };
+    static Failure toFailure (const String &reason) {    // what follows +EVT:JOIN_FAILED_
+        if (reason == "RX_TIMEOUT")
+            return Failure::RX_TIMEOUT;
+        else if (reason == "TX_TIMEOUT")
+            return Failure::TX_TIMEOUT;
+        else
+            return Failure::ERROR;
+    }
+    static String toString (const Failure failure) {
+        if (failure == Failure::RX_TIMEOUT)
+            return "RX_TIMEOUT";
+        else if (failure == Failure::TX_TIMEOUT)
+            return "TX_TIMEOUT";
+        else if (failure == Failure::ERROR)
+            return "ERROR";
+        else if (failure == Failure::UNRESOLVED)
+            return "UNRESOLVED";
+        else
+            return "UNKNOWN";
+    }
+
+    struct Config {
+        bool enabled { true };
+        interval_t startJitter { 5 * 1000 };            // before the first attempt, spreading devices that powered up together
+        interval_t backoffMinimum { 10 * 1000 };        // after the first failure, doubling with each one after
+        interval_t backoffMaximum { 60 * 60 * 1000 };
+        int attemptsPerDataRate { 1 };                  // unanswered attempts before stepping to the next slower data rate
+        interval_t attemptTimeout { 15 * 1000 };        // without JOINED or JOIN_FAILED_*, ask the module
+        bool dutyCycle { true };
+    };
+    struct Stats {
+        counter_t attempts = 0, joins = 0, dutyCycleDeferrals = 0;
+        counter_t rxTimeouts = 0, txTimeouts = 0, errors = 0, unresolved = 0;
+        interval_t airtime = 0;                                // join requests sent, in total
+        interval_t timeToJoinLast = 0, timeToJoinMaximum = 0;    // from the first attempt of a session until joined
+        RakDeviceQuantile timeToJoinMedian { 0.5f }, timeToJoinP90 { 0.9f };
+    };
+
+private:
+    const Config _config;
+    const RakDeviceRegion &_region;
+    struct Attempt {
+        interval_t time = 0, airtime = 0;
+    };
+    RakDeviceQueue<Attempt, LEDGER_SIZE> _ledger;
+    interval_t _ledgerStarted = 0;    // the first attempt since power up, from which the duty cycle phases run
+    bool _active = false, _attempting = false;
+    interval_t _sessionStarted = 0;
+    int _dataRate, _attemptsAtDataRate = 0, _failures = 0;
+    Stats _stats;
+
+    interval_t dutyCycleWait (const interval_t from) const {    // until another request fits within the aggregate budget of its phase
+        if (! _config.dutyCycle || _ledger.empty ())
+            return 0;
+        const interval_t airtime = _region.timeOnAir (dataRate (), JOIN_REQUEST_SIZE);
+        interval_t at = from;
+        for (size_t step = 0; step <= LEDGER_SIZE + 2; step++) {    // each step, an attempt ages out or a phase ends
+            const interval_t since = at - _ledgerStarted;
+            const bool sliding = since >= 11 * HOUR;
+            const interval_t phaseStart = since < HOUR ? 0 : (sliding ? 11 * HOUR : HOUR), phaseEnd = since < HOUR ? HOUR : 11 * HOUR;
+            const interval_t window = sliding ? 24 * HOUR : phaseEnd - phaseStart, budget = sliding ? 8700 : 36000;
+            interval_t used = 0, next = sliding ? window : phaseEnd - since;
+            bool oldestCounts = false;
+            for (size_t i = 0; i < _ledger.size (); i++)
+                if (_ledger [i].time - _ledgerStarted >= phaseStart && at - _ledger [i].time < window) {
+                    used += _ledger [i].airtime;
+                    next = std::min (next, _ledger [i].time + window - at);
+                    oldestCounts = oldestCounts || i == 0;
+                }
+            if (used + airtime <= budget && ! (_ledger.full () && oldestCounts))    // a full ledger would forget airtime that still counts
+                break;
+            at += next;
+        }
+        return at - from;
+    }
+    interval_t schedule (const interval_t wait) {
+        const interval_t now = millis (), dutyCycle = dutyCycleWait (now + wait);
+        if (dutyCycle > 0)
+            _stats.dutyCycleDeferrals++;
+        return wait + dutyCycle;
+    }
+
+public:
+    RakDeviceJoinEngine (const Config &config, const RakDeviceRegion &region) :
+        _config (config),
+        _region (region),
+        _dataRate (region.uplinkMaximum) { }
+
+    bool enabled () const { return _config.enabled; }
+    bool active () const { return _active; }
+    bool attempting () const { return _attempting; }
+    Lora::Datarate dataRate () const { return static_cast<Lora::Datarate> (_dataRate); }
+    const Stats &stats () const { return _stats; }
+
+    interval_t begin () {    // until the first attempt; a session already under way carries on where it was
+        if (! _active) {
+            _active = true;
+            _sessionStarted = millis ();
+            _dataRate = _region.uplinkMaximum;
+            _attemptsAtDataRate = _failures = 0;
+        }
+        _attempting = false;
+        return schedule (_config.startJitter > 0 ? static_cast<interval_t> (random (static_cast<long> (_config.startJitter))) : 0);
+    }
+    void attempt () {
+        const interval_t now = millis (), airtime = _region.timeOnAir (dataRate (), JOIN_REQUEST_SIZE);
+        if (_ledger.full ())
+            _ledger.pop ();
+        if (_stats.attempts == 0)
+            _ledgerStarted = now;
+        _ledger.push ({ .time = now, .airtime = airtime });
+        _stats.attempts++;
+        _stats.airtime += airtime;
+        _attempting = true;
+    }
+    interval_t failure (const Failure failure) {    // until the next attempt
+        if (failure == Failure::RX_TIMEOUT)
+            _stats.rxTimeouts++;
+        else if (failure == Failure::TX_TIMEOUT)
+            _stats.txTimeouts++;
+        else if (failure == Failure::ERROR)
+            _stats.errors++;
+        else
+            _stats.unresolved++;
+        if (failure == Failure::TX_TIMEOUT && _attempting && ! _ledger.empty ())
+            _stats.airtime -= _ledger.back ().airtime, _ledger.back ().airtime = 0;    // nothing went out
+        if ((failure == Failure::RX_TIMEOUT || failure == Failure::UNRESOLVED) && ++_attemptsAtDataRate >= _config.attemptsPerDataRate && _dataRate > _region.uplinkMinimum)
+            _dataRate--, _attemptsAtDataRate = 0;
+        _attempting = false;
+        const int shift = std::min (_failures++, 16);
+        const interval_t backoff = _config.backoffMinimum > (_config.backoffMaximum >> shift) ? _config.backoffMaximum : _config.backoffMinimum << shift;    // clamped before the shift can overflow
+        return schedule (backoff / 2 + static_cast<interval_t> (random (static_cast<long> (backoff / 2 + 1))));    // equal jitter: never less than half
+    }
+    void success () {
+        if (! _active)
+            return;
+        const interval_t timeToJoin = millis () - _sessionStarted;
+        _stats.joins++;
+        _stats.timeToJoinLast = timeToJoin;
+        if (timeToJoin > _stats.timeToJoinMaximum)
+            _stats.timeToJoinMaximum = timeToJoin;
+        _stats.timeToJoinMedian.add (static_cast<float> (timeToJoin));
+        _stats.timeToJoinP90.add (static_cast<float> (timeToJoin));
+        _active = _attempting = false;
+    }
+};
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
+
+// Charge drawn by the module, estimated from what it is asked to do: each uplink and join request
+// at its time on air and transmit power, the receive windows after them, downlinks, and the time
+// between spent awake or asleep. Currents vary by module and board, so they are configured; the
+// defaults are RAK3172 typicals at EU868. With a battery and a target life, also a budget: the
+// charge drawn so far against what that life allows, from which uplinks may be held back.
+
+class RakDeviceEnergyModel {
+public:
+    static inline constexpr size_t PORTS_SIZE = 8;     // ports accounted separately, any more share one entry
+    static inline constexpr size_t HOURS_SIZE = 24;    // hourly totals retained
+    static inline constexpr interval_t HOUR = 60 * 60 * 1000;
+    static inline constexpr double MILLISECONDS_PER_HOUR = 60.0 * 60.0 * 1000.0;
+
+    struct Config {
+        bool enabled { true };
+        float transmitCurrent [Lora::MAXIMUM_TXPOWER + 1] { 44, 38, 33, 29, 26, 23, 21, 19 };    // mA, by TxPower index
+        float receiveCurrent { 5.5f };                                                           // mA, a receive window open, or Class C
+        float idleCurrent { 0.005f };    // mA, awake between commands: RUI3 defaults to AT+LPM=1, otherwise about 2 mA
+        float sleepCurrent { 0.0017f };  // mA, after AT+SLEEP
+        int receiveWindowSymbols { 8 };  // a window with nothing in it closes after the preamble would have been seen
+        float batteryCapacity { 0 };     // mAh, 0 = no budget
+        float targetLifeDays { 0 };      // ... which together give the average current the budget allows
+        float budgetBurst { 1.0f };      // mAh that may be drawn ahead of the budget, e.g. for the join
+    };
+    struct Totals {    // mAh
+        double transmit = 0, receive = 0, join = 0, idle = 0, sleep = 0;
+        double total () const { return transmit + receive + join + idle + sleep; }
+    };
+    struct Port {
+        counter_t uplinks = 0;
+        double charge = 0;    // mAh, transmit and the receive windows after
+    };
+    struct Hour {
+        uint32_t hour = 0;    // since the model started
+        double charge = 0;
+        counter_t uplinks = 0, joins = 0;
+    };
+    struct Stats {
+        Totals totals;
+        counter_t uplinks = 0, joins = 0, downlinks = 0;
+        interval_t transmitTime = 0, receiveTime = 0, sleepTime = 0;
+        RakDeviceMap<Lora::Port, Port, PORTS_SIZE> ports;
+        RakDeviceQueue<Hour, HOURS_SIZE> hours;    // the oldest first, the current hour last
+    };
+
+private:
+    const Config _config;
+    const RakDeviceRegion &_region;
+    interval_t _started, _updated;
+    bool _asleep = false, _listening = false;
+    Stats _stats;
+
+    static double charge (const float current, const interval_t duration) { return current * static_cast<double> (duration) / MILLISECONDS_PER_HOUR; }
+    float backgroundCurrent () const { return _asleep ? _config.sleepCurrent : (_listening ? _config.receiveCurrent : _config.idleCurrent); }
+    Hour &hour (const interval_t at) {
+        const uint32_t number = static_cast<uint32_t> ((at - _started) / HOUR);
+        if (_stats.hours.empty () || _stats.hours.back ().hour != number) {
+            if (_stats.hours.full ())
+                _stats.hours.pop ();
+            _stats.hours.push ({ .hour = number });
+        }
+        return _stats.hours.back ();
+    }
+    void accrue (double Totals::*category, const double amount) {
+        _stats.totals.*category += amount;
+        hour (millis ()).charge += amount;
+    }
+    interval_t receiveWindow (const Lora::Datarate dataRate) const {
+        const RakDeviceRegion::DataRate &rate = _region.dataRate (dataRate);
+        return rate.defined () ? static_cast<interval_t> ((static_cast<float> (1 << rate.spreadingFactor) / rate.bandwidth) * _config.receiveWindowSymbols + 0.5f) : 0;
+    }
+    interval_t receiveWindows (const Lora::Datarate dataRate) const {    // RX1 at the uplink data rate (no offset), then RX2
+        return receiveWindow (dataRate) + receiveWindow (static_cast<Lora::Datarate> (_region.rx2DataRate));
+    }
+    float transmitCurrent (const Lora::TxPower txPower) const {
+        return _config.transmitCurrent [std::clamp (static_cast<int> (txPower), Lora::MINIMUM_TXPOWER, Lora::MAXIMUM_TXPOWER)];
+    }
+
+public:
+    RakDeviceEnergyModel (const Config &config, const RakDeviceRegion &region) :
+        _config (config),
+        _region (region),
+        _started (millis ()),
+        _updated (_started) { }
+
+    bool enabled () const { return _config.enabled; }
+    const Stats &stats () const { return _stats; }
+
+    void update () {    // the background since last time, split at hour boundaries
+        if (! _config.enabled)
+            return;
+        const interval_t now = millis ();
+        while (_updated != now) {
+            const interval_t boundary = _started + ((_updated - _started) / HOUR + 1) * HOUR, until = (now - _updated) < (boundary - _updated) ? now : boundary;
+            const double amount = charge (backgroundCurrent (), until - _updated);
+            (_asleep ? _stats.totals.sleep : _stats.totals.idle) += amount;
+            hour (_updated).charge += amount;
+            if (_asleep)
+                _stats.sleepTime += until - _updated;
+            _updated = until;
+        }
+    }
+    void sleep (const bool asleep) {
+        update ();
+        _asleep = asleep;
+    }
+    void listening (const bool listening) {    // Class C: the receiver is on whenever not transmitting
+        update ();
+        _listening = listening;
+    }
+
+    double uplinkCharge (const Lora::Datarate dataRate, const Lora::TxPower txPower, const size_t length) const {    // mAh, an estimate before sending
+        return charge (transmitCurrent (txPower), _region.timeOnAir (dataRate, length)) + charge (_config.receiveCurrent, receiveWindows (dataRate));
+    }
+    void uplink (const Lora::Port port, const Lora::Datarate dataRate, const Lora::TxPower txPower, const size_t length) {
+        if (! _config.enabled)
+            return;
+        update ();
+        const interval_t airtime = _region.timeOnAir (dataRate, length), windows = receiveWindows (dataRate);
+        const double transmit = charge (transmitCurrent (txPower), airtime), receive = charge (_config.receiveCurrent, windows);
+        accrue (&Totals::transmit, transmit);
+        accrue (&Totals::receive, receive);
+        Port &totals = _stats.ports [port];
+        totals.uplinks++;
+        totals.charge += transmit + receive;
+        hour (millis ()).uplinks++;
+        _stats.uplinks++;
+        _stats.transmitTime += airtime;
+        _stats.receiveTime += windows;
+    }
+    void join (const Lora::Datarate dataRate, const Lora::TxPower txPower) {    // a request and its two windows
+        if (! _config.enabled)
+            return;
+        update ();
+        const interval_t airtime = _region.timeOnAir (dataRate, RakDeviceJoinEngine::JOIN_REQUEST_SIZE), windows = receiveWindows (dataRate);
+        accrue (&Totals::join, charge (transmitCurrent (txPower), airtime) + charge (_config.receiveCurrent, windows));
+        hour (millis ()).joins++;
+        _stats.joins++;
+        _stats.transmitTime += airtime;
+        _stats.receiveTime += windows;
+    }
+    void downlink (const Lora::Datarate dataRate, const size_t length) {    // the window stays open while it is received
+        if (! _config.enabled)
+            return;
+        update ();
+        const interval_t airtime = _region.timeOnAir (dataRate, length);
+        accrue (&Totals::receive, charge (_config.receiveCurrent, airtime));
+        _stats.downlinks++;
+        _stats.receiveTime += airtime;
+    }
+
+    float averageCurrent () const {    // mA, since the model started
+        const interval_t elapsed = _updated - _started;
+        return elapsed > 0 ? static_cast<float> (_stats.totals.total () * MILLISECONDS_PER_HOUR / elapsed) : 0.0f;
+    }
+    float lifeProjected () const {    // days on batteryCapacity at averageCurrent, 0 = unknown
+        const float current = averageCurrent ();
+        return _config.batteryCapacity > 0 && current > 0 ? _config.batteryCapacity / current / 24.0f : 0.0f;
+    }
+    bool budgeted () const { return _config.enabled && _config.batteryCapacity > 0 && _config.targetLifeDays > 0; }
+    float budgetCurrent () const { return budgeted () ? _config.batteryCapacity / (_config.targetLifeDays * 24.0f) : 0.0f; }    // mA
+    interval_t budgetWait (const double amount) const {    // until drawing amount more (mAh) keeps within the budget, 0 = now
+        if (! budgeted ())
+            return 0;
+        const interval_t now = millis ();
+        const double drawn = _stats.totals.total () + charge (backgroundCurrent (), now - _updated);
+        const double allowed = _config.budgetBurst + budgetCurrent () * static_cast<double> (now - _started) / MILLISECONDS_PER_HOUR;
+        const double excess = drawn + amount - allowed;
+        if (excess <= 0)
+            return 0;
+        return static_cast<interval_t> (std::min (excess / budgetCurrent () * MILLISECONDS_PER_HOUR, static_cast<double> (HOUR)));    // re-evaluated by then at the latest
+    }
+};
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
@@ -33,7 +33,7 @@ public:
     }
     interval_t remaining () const {
         const interval_t current = millis ();
-        return _interval - (current - _previous);
+        return (current - _previous) < _interval ? _interval - (current - _previous) : 0;
     }
     bool passed (interval_t *interval = nullptr, const bool atstart = false) {
         const interval_t current = millis ();
@@ -224,11 +224,16 @@ void inline startWiFi () {
 
 #define DEBUG_RAKDEVICE
 #define DEBUG_RAKDEVICE_TRANSCEIVER
+// #define DEBUG_RAKDEVICE_LOG
+#define RAKDEVICE_RETAINED RTC_NOINIT_ATTR
 
 #include "RakDeviceCommon.hpp"
 #include "RakDeviceCommands.hpp"
+#include "RakDeviceOptimiser.hpp"
 #include "RakDeviceManager.hpp"
 #include "RakDeviceMessenger.hpp"
+#include "RakDeviceFragmentation.hpp"
+#include "RakDeviceFragmenter.hpp"
 
 #include "Secrets.hpp"
 
@@ -238,39 +243,63 @@ HardwareSerial serial (serialId);
 static inline constexpr gpio_num_t PIN_RAK3272_TX = GPIO_NUM_2;
 static inline constexpr gpio_num_t PIN_RAK3272_RX = GPIO_NUM_1;
 
-RakDeviceManager *rak3272 = nullptr;
-const RakDeviceManager::Config rak3272_config = {
+using Rak3272 = RakDeviceManagerT<HardwareSerial>;    // the UART's own type: the transceiver calls it directly, not through Stream's vtable
+Rak3272 *rak3272 = nullptr;
+const Rak3272::Config rak3272_config = {
     .loraIdentifiers = {
                         .devEUI = LORA_DEVEUI,
                         .appEUI = LORA_APPEUI,
-                        .appKey = LORA_APPKEY }
+                        .appKey = LORA_APPKEY },
+    .serial = { .baudRateApply = [] (uint32_t baudRate) { serial.updateBaudRate (baudRate); } }
 };
 
-// RakDeviceMessenger *rak3272_messenger = nullptr;
+// RakDeviceMessengerT<Rak3272> *rak3272_messenger = nullptr;
 
-void loraEventHandler (const RakDeviceManager::Event event, const RakDeviceManager::EventArgs &args) {
+void loraEventHandler (const Rak3272::Event event, const Rak3272::EventArgs &args) {
     switch (event) {
-    case RakDeviceManager::Event::JOIN_PENDING :
+    case Rak3272::Event::JOIN_PENDING :
         Serial.println ("LORA EVENT: Join pending");
         break;
-    case RakDeviceManager::Event::JOIN_SUCCESS :
+    case Rak3272::Event::JOIN_SUCCESS :
         Serial.printf ("LORA EVENT: Join success, addr=%s\n", args [0].c_str ());
         break;
-    case RakDeviceManager::Event::JOIN_FAILURE :
+    case Rak3272::Event::JOIN_FAILURE :
         Serial.printf ("LORA EVENT: Join failed, reason=%s\n", args [0].c_str ());
         break;
-    case RakDeviceManager::Event::DATA_RECEIVED :
-        Serial.printf ("LORA EVENT: Data received: port=%s, data=%s\n", args [0].c_str (), args [1].c_str ());
+    case Rak3272::Event::DATA_RECEIVED : {
+        Rak3272::Downlink downlink;
+        while (rak3272->receive (downlink)) {
+            Serial.printf ("LORA EVENT: Data received: port=%d, size=%u, RSSI=%d, SNR=%d\n", downlink.port, downlink.length, downlink.RSSI, downlink.SNR);
+            rak3272->release (downlink);
+        }
         break;
-    case RakDeviceManager::Event::TRANSMIT_SUCCESS :
-        Serial.println ("LORA EVENT: Transmit success");
+    }
+    case Rak3272::Event::TRANSMIT_SUCCESS :
+        Serial.printf ("LORA EVENT: Transmit success, uplink=%s, confirmation=%s ms\n", args [0].c_str (), args [1].c_str ());
         break;
-    case RakDeviceManager::Event::TRANSMIT_FAILURE :
-        Serial.println ("LORA EVENT: Transmit failure");
+    case Rak3272::Event::TRANSMIT_FAILURE :
+        Serial.printf ("LORA EVENT: Transmit failure, uplink=%s, confirmation=%s\n", args [0].c_str (), args [1].c_str ());
         break;
     }
 }
 
+void reportFootprint () {    // static size per subsystem, and the heap now and at its high-water mark: build with RAKDEVICE_FIXED_CAPACITY to see what the driver still takes from it
+    Serial.printf ("FOOTPRINT: manager=%u (status=%u, scheduler=%u), messenger=%u, fragmenter=%u, log=%u\n", sizeof (Rak3272), sizeof (Rak3272::Status), sizeof (Rak3272::Scheduler), sizeof (RakDeviceMessengerT<Rak3272>), sizeof (RakDeviceFragmenterT<Rak3272>), sizeof (RakDeviceLog::Record) * RakDeviceLog::SIZE);
+    Serial.printf ("FOOTPRINT: heap free=%lu, minimum=%lu, largest=%lu, peak used=%lu since boot\n", (unsigned long) ESP.getFreeHeap (), (unsigned long) ESP.getMinFreeHeap (), (unsigned long) ESP.getMaxAllocHeap (), (unsigned long) (ESP.getHeapSize () - ESP.getMinFreeHeap ()));
+}
+
+void reportEnergy () {    // estimated from what the module was asked to do, see RakDeviceEnergyModel
+    const auto &energy = rak3272->energy ();
+    const auto &stats = energy.stats ();
+    Serial.printf ("ENERGY: total=%.3f mAh (transmit=%.3f, receive=%.3f, join=%.3f, idle=%.3f, sleep=%.3f), average=%.4f mA, uplinks=%lu, joins=%lu\n", stats.totals.total (), stats.totals.transmit, stats.totals.receive, stats.totals.join, stats.totals.idle, stats.totals.sleep, energy.averageCurrent (), stats.uplinks, stats.joins);
+    for (const auto &port : stats.ports)
+        Serial.printf ("ENERGY: port=%d, uplinks=%lu, charge=%.3f mAh\n", port.first, port.second.uplinks, port.second.charge);
+    for (size_t i = 0; i < stats.hours.size (); i++)
+        Serial.printf ("ENERGY: hour=%lu, charge=%.3f mAh, uplinks=%lu, joins=%lu\n", (unsigned long) stats.hours [i].hour, stats.hours [i].charge, stats.hours [i].uplinks, stats.hours [i].joins);
+    const auto &power = rak3272->status ().power;
+    Serial.printf ("POWER: sleeps=%lu, slept=%lu s, wakes=%lu (failed=%lu), latency=%lu/%lu ms (mean/maximum), to uplink=%lu/%lu ms\n", power.sleeps, power.sleepTotal / 1000, power.wakes, power.wakeFailures, power.wakeLatencyMean (), power.wakeLatencyMaximum, power.wakeToUplinkMean (), power.wakeToUplinkMaximum);
+}
+
 void setup () {
     Serial.begin (115200);
     delay (2.5 * 1000);
@@ -284,35 +313,46 @@ void setup () {
     serial.setTxBufferSize (512);
     serial.begin (115200, SERIAL_8N1, PIN_RAK3272_RX, PIN_RAK3272_TX, false);
 
-    rak3272 = new RakDeviceManager (rak3272_config, serial);
+    rak3272 = new Rak3272 (rak3272_config, serial);
     if (! rak3272->begin ())
         Serial.printf ("RakDeviceManager::setup () failed\n");
-    rak3272->addEventListener (loraEventHandler);
+    rak3272->addEventListener (loraEventHandler, Rak3272::eventMask (Rak3272::Event::JOIN_PENDING, Rak3272::Event::JOIN_SUCCESS, Rak3272::Event::JOIN_FAILURE, Rak3272::Event::DATA_RECEIVED, Rak3272::Event::TRANSMIT_SUCCESS, Rak3272::Event::TRANSMIT_FAILURE));
 
-    //    rak3272_messenger = new RakDeviceMessenger (*rak3272);
+    //    rak3272_messenger = new RakDeviceMessengerT<Rak3272> (*rak3272);
+    reportFootprint ();
 }
 
 // -----------------------------------------------------------------------------------------------
 
-Intervalable second (1 * 1000);
-Intervalable ping (30 * 1000);
+Intervalable ping (30 * 1000), footprint (60 * 60 * 1000);
+
+void idle (const interval_t duration) {    // until the next timed work, or the module has something to say
+    static constexpr interval_t IDLE_SLICE = 10;
+    const interval_t started = millis ();
+    while (millis () - started < duration && ! rak3272->hasInput ())
+        delay (IDLE_SLICE);    // lets the idle task light sleep, with automatic light sleep configured
+}
 
 void loop () {
-    second.wait ();
+    idle (std::min (rak3272->nextDeadline (), ping.remaining ()));
 
     rak3272->process ();
     // rak3272_messenger->process ();
+#ifdef DEBUG_RAKDEVICE_LOG
+    RakDeviceLog::drain (Serial);    // after the time critical work
+#endif
 
-    // RakDeviceMessenger::Message message;
-    // while (rak3272_messenger->receive (message))
-    //     Serial.printf ("Received message on port %d: %s\n", message.port, message.data.c_str ());
+    // Rak3272::Downlink downlink;
+    // while (rak3272_messenger->receive (downlink))
+    //     Serial.printf ("Received message on port %d: size=%u\n", downlink.port, downlink.length), rak3272_messenger->release (downlink);
 
-    // if (rak3272->isAvailable () && rak3272_messenger->transmit_queue_size () < 32 && ping) {
     if (rak3272->isAvailable () && ping) {
         static int counter = 1;
         rak3272->transmit (Lora::Port (1), "{\"ping\": \"" + String (counter++) + "\"}");
-        // rak3272_messenger->transmit (RakDeviceMessenger::Message (Lora::Port (1), "{\"ping\": \"" + String (counter++) + "\"}"));
+        // rak3272_messenger->try_transmit (RakDeviceMessengerT<Rak3272>::Message (Lora::Port (1), "{\"ping\": \"" + String (counter++) + "\"}"));
     }
+    if (footprint)
+        reportFootprint (), reportEnergy ();
 }
 
 // -----------------------------------------------------------------------------------------------
@@ -0,0 +1,241 @@
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
+
+// The parts of the Arduino core the driver uses, for host tests (pio test -e native). Time is a
+// simulated clock: it moves only when delay () is called or a test advances it, so timeouts,
+// backoffs and recoveries run in microseconds of wall time and repeat exactly.
+
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <string>
+#include <vector>
+
+// -----------------------------------------------------------------------------------------------
+
+namespace host {
+inline uint64_t clock = 0;    // microseconds
+inline void advance (const uint64_t microseconds) { clock += microseconds; }
+inline uint64_t randomState = 0x853C49E6748FEA9BULL;    // splitmix64
+inline uint64_t randomNext () {
+    uint64_t z = (randomState += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+}    // namespace host
+
+inline unsigned long millis () { return static_cast<unsigned long> (host::clock / 1000); }
+inline unsigned long micros () { return static_cast<unsigned long> (host::clock); }
+inline void delay (const unsigned long milliseconds) { host::advance (static_cast<uint64_t> (milliseconds) * 1000); }
+inline void delayMicroseconds (const unsigned int microseconds) { host::advance (microseconds); }
+
+inline long random (const long maximum) { return maximum > 0 ? static_cast<long> (host::randomNext () % static_cast<uint64_t> (maximum)) : 0; }
+inline long random (const long minimum, const long maximum) { return maximum > minimum ? minimum + random (maximum - minimum) : minimum; }
+inline void randomSeed (const unsigned long seed) { host::randomState = seed; }
+
+inline bool isHexadecimalDigit (const char c) { return std::isxdigit (static_cast<unsigned char> (c)) != 0; }
+inline bool isPrintable (const int c) { return std::isprint (c) != 0; }
+
+// -----------------------------------------------------------------------------------------------
+
+class String {
+    std::string _string;
+
+    template <typename T>
+    static std::string format (const char *specification, const T value) {
+        char buffer [48];
+        snprintf (buffer, sizeof (buffer), specification, value);
+        return buffer;
+    }
+
+public:
+    String () = default;
+    String (const char *text) :
+        _string (text != nullptr ? text : "") { }
+    String (const std::string &text) :
+        _string (text) { }
+    explicit String (const char c) :
+        _string (1, c) { }
+    String (const int value, const unsigned char base = 10) :
+        _string (format (base == 16 ? "%x" : "%d", value)) { }
+    String (const unsigned int value, const unsigned char base = 10) :
+        _string (format (base == 16 ? "%x" : "%u", value)) { }
+    String (const long value, const unsigned char base = 10) :
+        _string (format (base == 16 ? "%lx" : "%ld", value)) { }
+    String (const unsigned long value, const unsigned char base = 10) :
+        _string (format (base == 16 ? "%lx" : "%lu", value)) { }
+    String (const long long value) :
+        _string (std::to_string (value)) { }
+    String (const unsigned long long value) :
+        _string (std::to_string (value)) { }
+    String (const float value, const unsigned int decimals = 2) :
+        _string (precision (value, decimals)) { }
+    String (const double value, const unsigned int decimals = 2) :
+        _string (precision (value, decimals)) { }
+
+    const char *c_str () const { return _string.c_str (); }
+    unsigned int length () const { return static_cast<unsigned int> (_string.size ()); }
+    bool isEmpty () const { return _string.empty (); }
+    bool reserve (const unsigned int size) {
+        _string.reserve (size);
+        return true;
+    }
+    char operator[] (const unsigned int index) const { return index < _string.size () ? _string [index] : '\0'; }
+    char &operator[] (const unsigned int index) { return _string [index]; }
+    char charAt (const unsigned int index) const { return (*this) [index]; }
+    const char *begin () const { return _string.data (); }
+    const char *end () const { return _string.data () + _string.size (); }
+
+    String &operator+= (const String &other) { return _string += other._string, *this; }
+    String &operator+= (const char *other) { return _string += other, *this; }
+    String &operator+= (const char c) { return _string += c, *this; }
+    String &operator+= (const int value) { return _string += std::to_string (value), *this; }
+    String &operator+= (const unsigned int value) { return _string += std::to_string (value), *this; }
+    String &operator+= (const long value) { return _string += std::to_string (value), *this; }
+    String &operator+= (const unsigned long value) { return _string += std::to_string (value), *this; }
+    bool concat (const char *text, const unsigned int length) { return _string.append (text, length), true; }
+    bool concat (const String &other) { return _string += other._string, true; }
+    bool concat (const char c) { return _string += c, true; }
+
+    bool operator== (const String &other) const { return _string == other._string; }
+    bool operator!= (const String &other) const { return _string != other._string; }
+    bool operator== (const char *other) const { return _string == other; }
+    bool operator!= (const char *other) const { return _string != other; }
+    bool operator< (const String &other) const { return _string < other._string; }
+    bool equals (const String &other) const { return _string == other._string; }
+    bool equalsIgnoreCase (const String &other) const {
+        return _string.size () == other._string.size () && std::equal (_string.begin (), _string.end (), other._string.begin (), [] (const char a, const char b) { return std::tolower (a) == std::tolower (b); });
+    }
+
+    int indexOf (const char c, const unsigned int from = 0) const { return position (_string.find (c, from)); }
+    int indexOf (const String &text, const unsigned int from = 0) const { return position (_string.find (text._string, from)); }
+    int lastIndexOf (const char c) const { return position (_string.rfind (c)); }
+    String substring (const unsigned int from) const { return from < _string.size () ? String (_string.substr (from)) : String (); }
+    String substring (unsigned int from, unsigned int to) const {
+        if (from > to)
+            std::swap (from, to);
+        return from < _string.size () ? String (_string.substr (from, std::min<size_t> (to, _string.size ()) - from)) : String ();
+    }
+    bool startsWith (const String &prefix) const { return _string.compare (0, prefix._string.size (), prefix._string) == 0; }
+    bool startsWith (const String &prefix, const unsigned int offset) const { return offset <= _string.size () && _string.compare (offset, prefix._string.size (), prefix._string) == 0; }
+    bool endsWith (const String &suffix) const { return _string.size () >= suffix._string.size () && _string.compare (_string.size () - suffix._string.size (), suffix._string.size (), suffix._string) == 0; }
+
+    void trim () {
+        const size_t first = _string.find_first_not_of (" \t\r\n");
+        _string = first == std::string::npos ? std::string () : _string.substr (first, _string.find_last_not_of (" \t\r\n") - first + 1);
+    }
+    long toInt () const { return std::atol (_string.c_str ()); }
+    float toFloat () const { return static_cast<float> (std::atof (_string.c_str ())); }
+    void toUpperCase () {
+        for (auto &c : _string)
+            c = static_cast<char> (std::toupper (c));
+    }
+    void toLowerCase () {
+        for (auto &c : _string)
+            c = static_cast<char> (std::tolower (c));
+    }
+    void remove (const unsigned int index, const unsigned int count = 1) { _string.erase (index, count); }
+    void replace (const String &from, const String &to) {
+        for (size_t at = 0; (at = _string.find (from._string, at)) != std::string::npos; at += to._string.size ())
+            _string.replace (at, from._string.size (), to._string);
+    }
+    void clear () { _string.clear (); }
+
+    friend String operator+ (const String &a, const String &b) { return String (a._string + b._string); }
+    friend String operator+ (const String &a, const char *b) { return String (a._string + b); }
+    friend String operator+ (const char *a, const String &b) { return String (a + b._string); }
+    friend String operator+ (const String &a, const char b) { return String (a._string + b); }
+    friend String operator+ (const String &a, const int b) { return String (a._string + std::to_string (b)); }
+    friend String operator+ (const String &a, const unsigned long b) { return String (a._string + std::to_string (b)); }
+
+private:
+    static std::string precision (const double value, const unsigned int decimals) {
+        char buffer [64];
+        snprintf (buffer, sizeof (buffer), "%.*f", static_cast<int> (decimals), value);
+        return buffer;
+    }
+    static int position (const size_t found) { return found == std::string::npos ? -1 : static_cast<int> (found); }
+};
+
+// -----------------------------------------------------------------------------------------------
+
+class Print {
+public:
+    virtual ~Print () { }
+    virtual size_t write (uint8_t c) = 0;
+    virtual size_t write (const uint8_t *buffer, size_t size) {
+        size_t written = 0;
+        while (written < size && write (buffer [written]) == 1)
+            written++;
+        return written;
+    }
+    size_t write (const char *buffer, const size_t size) { return write (reinterpret_cast<const uint8_t *> (buffer), size); }
+    size_t print (const String &text) { return write (reinterpret_cast<const uint8_t *> (text.c_str ()), text.length ()); }
+    size_t print (const char *text) { return write (reinterpret_cast<const uint8_t *> (text), strlen (text)); }
+    size_t println (const String &text) { return print (text) + print ("\r\n"); }
+    size_t println (const char *text) { return print (text) + print ("\r\n"); }
+    size_t printf (const char *format, ...) __attribute__ ((format (printf, 2, 3))) {
+        char buffer [512];
+        va_list arguments;
+        va_start (arguments, format);
+        const int length = vsnprintf (buffer, sizeof (buffer), format, arguments);
+        va_end (arguments);
+        return length > 0 ? write (reinterpret_cast<const uint8_t *> (buffer), std::min (static_cast<size_t> (length), sizeof (buffer) - 1)) : 0;
+    }
+    virtual void flush () { }
+};
+
+class Stream : public Print {
+protected:
+    unsigned long _timeout = 1000;
+
+public:
+    virtual int available () = 0;
+    virtual int read () = 0;
+    virtual int peek () = 0;
+    void setTimeout (const unsigned long timeout) { _timeout = timeout; }
+    virtual size_t readBytes (uint8_t *buffer, size_t length) {
+        size_t count = 0;
+        for (int c; count < length && (c = read ()) >= 0;)
+            buffer [count++] = static_cast<uint8_t> (c);
+        return count;
+    }
+    size_t readBytes (char *buffer, const size_t length) { return readBytes (reinterpret_cast<uint8_t *> (buffer), length); }
+};
+
+class HostSerial : public Stream {    // the console
+public:
+    void begin (unsigned long) { }
+    void end () { }
+    int available () override { return 0; }
+    int read () override { return -1; }
+    int peek () override { return -1; }
+    size_t write (const uint8_t c) override { return fputc (c, stdout) != EOF ? 1 : 0; }
+    size_t write (const uint8_t *buffer, const size_t size) override { return fwrite (buffer, 1, size, stdout); }
+    using Print::write;
+};
+inline HostSerial Serial;
+
+struct EspClass {    // the host heap is not measured here: see test_footprint
+    uint32_t getFreeHeap () { return 0; }
+    uint32_t getMinFreeHeap () { return 0; }
+    uint32_t getHeapSize () { return 0; }
+    uint32_t getMaxAllocHeap () { return 0; }
+};
+inline EspClass ESP;
+
+#define RTC_NOINIT_ATTR
+#define RTC_DATA_ATTR
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
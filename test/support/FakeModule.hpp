@@ -0,0 +1,263 @@
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
+
+// A scripted RAK3272 on the other end of the UART, for host tests. It answers the RUI3 AT commands
+// the driver issues from a table of settings, raises the asynchronous events (JOINED, TX_DONE,
+// SEND_CONFIRMED_*, TXP2P DONE) after configurable delays, and puts each byte on the wire at the
+// time the baud rate allows: a test measures in simulated milliseconds what the module would cost.
+// Faults are injected by going silent, wedging until AT+RESET, or restarting unprompted.
+
+#pragma once
+
+#include "RakDeviceHost.hpp"
+
+#include <deque>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+class FakeModule : public Stream {
+public:
+    static inline constexpr const char *BANNER [] = { "RAKwireless RAK3272-SiP Example", "------------------------------------------------------", "Current Work Mode: LoRaWAN." };
+
+    uint32_t baudRate = 115200;        // the module's side of the UART
+    uint32_t hostBaudRate = 115200;    // the host's, as ConfigSerial::baudRateApply sets it: a mismatch is garbage both ways
+    uint32_t processing = 2;           // milliseconds from a command arriving to its response starting
+    uint32_t joinDelay = 6000, resetDelay = 500;
+    uint32_t transmitDelay = 1200, confirmDelay = 3000;    // AT+SEND until TX_DONE, or SEND_CONFIRMED_* when CFM=1
+    uint32_t p2pAirtime = 40;                              // AT+PSEND until TXP2P DONE
+    bool joinAccept = true, confirmAccept = true;
+    const char *joinFailure = "RX_TIMEOUT";    // +EVT:JOIN_FAILED_ reason when not accepted
+    uint64_t unresponsiveUntil = 0;            // simulated microseconds: lines are ignored until then
+    bool wedged = false;                       // lines are ignored until AT+RESET
+
+    std::map<std::string, std::string> settings {
+        { "VER", "4.1.0" }, { "HWMODEL", "rak3272-sip" }, { "HWID", "stm32wle5xx" }, { "SN", "12345678" }, { "APIVER", "3.2.6" },
+        { "NWM", "1" }, { "NJM", "1" }, { "CLASS", "A" }, { "BAND", "4" }, { "DEVEUI", "0000000000000000" }, { "APPEUI", "0000000000000000" }, { "APPKEY", "00000000000000000000000000000000" },
+        { "CFM", "0" }, { "DCS", "1" }, { "DR", "0" }, { "TXP", "0" }, { "ADR", "1" }, { "PNM", "1" }, { "RX1DL", "1" }, { "RX2DL", "2" }, { "RX2DR", "0" }, { "LPM", "0" },
+        { "MASK", "0001" }, { "DEVADDR", "26011234" }, { "RSSI", "-80" }, { "SNR", "7" }, { "ARSSI", "0:-110,1:-112,2:-108" }, { "LTIME", "04h36m00s on 11/27/2023" }, { "CFS", "0" }, { "PGSLOT", "2" }
+    };
+    bool p2pReceiving = false;
+
+    struct Received {
+        uint64_t at;    // simulated microseconds the line arrived
+        std::string line;
+    };
+    std::vector<Received> received;    // every line the module took in, garbage included
+    counter_t restarts = 0, busy = 0;
+
+    std::function<bool (FakeModule &, const std::string &)> script;    // consulted first, true when it has answered the line itself
+
+    // -------------------------------------------------------------------------------------------
+
+    uint64_t byteTime (const uint32_t rate) const { return 10000000ULL / rate; }    // 8N1: microseconds per byte
+    void emitAt (const std::string &line, const uint64_t at) {    // a line from the module, starting at that simulated microsecond or once the wire is free
+        auto position = _lines.end ();
+        while (position != _lines.begin () && std::prev (position)->at > at)
+            position--;
+        _lines.insert (position, { at, baudRate, line + "\r\n" });
+    }
+    void emit (const std::string &line, const uint32_t after = 0) { emitAt (line, host::clock + after * 1000ULL); }
+    void reply (const std::string &line, const uint32_t after = 0) { respond (line, _arrived, after); }    // from a script: as a response to the line it was given
+    void restart (const uint32_t after = 0) {    // the banner, as when the module resets, asked or not
+        _joinedAt = NEVER;
+        p2pReceiving = false;
+        restarts++;
+        for (const char *line : BANNER)
+            emit (line, after);
+    }
+    bool joined () const { return host::clock >= _joinedAt; }
+    void join () { _joinedAt = host::clock; }
+    size_t count (const std::string &prefix) const {
+        size_t n = 0;
+        for (const auto &r : received)
+            if (r.line.compare (0, prefix.size (), prefix) == 0)
+                n++;
+        return n;
+    }
+    bool pending () const { return ! _lines.empty () || ! _wire.empty (); }
+
+    // -------------------------------------------------------------------------------------------
+
+    int available () override {
+        transmit ();
+        size_t n = 0;
+        while (n < _wire.size () && _wire [n].at <= host::clock)
+            n++;
+        return static_cast<int> (n);
+    }
+    int read () override {
+        if (available () == 0)
+            return -1;
+        const char c = _wire.front ().c;
+        _wire.pop_front ();
+        return static_cast<unsigned char> (c);
+    }
+    int peek () override {
+        return available () > 0 ? static_cast<unsigned char> (_wire.front ().c) : -1;
+    }
+    size_t readBytes (uint8_t *buffer, size_t length) override {
+        transmit ();
+        size_t n = 0;
+        while (n < length && ! _wire.empty () && _wire.front ().at <= host::clock)
+            buffer [n++] = static_cast<uint8_t> (_wire.front ().c), _wire.pop_front ();
+        return n;
+    }
+    size_t write (const uint8_t c) override {
+        _inputBytes++;
+        if (c == '\n') {
+            const uint64_t arrived = std::max (host::clock, _inputFree) + _inputBytes * byteTime (hostBaudRate);
+            _inputFree = arrived;
+            _inputBytes = 0;
+            std::string line;
+            line.swap (_input);
+            if (! line.empty ())
+                command (line, arrived);
+        } else if (c != '\r')
+            _input += static_cast<char> (c);
+        return 1;
+    }
+    size_t write (const uint8_t *buffer, const size_t size) override {
+        for (size_t i = 0; i < size; i++)
+            write (buffer [i]);
+        return size;
+    }
+    using Print::write;
+
+private:
+    static inline constexpr uint64_t NEVER = std::numeric_limits<uint64_t>::max ();
+    struct Line {
+        uint64_t at;
+        uint32_t baudRate;    // the module's, when it was sent
+        std::string text;
+    };
+    struct Byte {
+        uint64_t at;
+        char c;
+    };
+    std::deque<Line> _lines;    // by start time, not yet on the wire
+    std::deque<Byte> _wire;
+    uint64_t _wireFree = 0, _inputFree = 0, _joinedAt = NEVER, _arrived = 0;
+    std::string _input;
+    size_t _inputBytes = 0;
+
+    void transmit () {    // onto the wire, a byte time each, whatever has started by now
+        while (! _lines.empty () && _lines.front ().at <= host::clock) {
+            const Line &line = _lines.front ();
+            const bool garbled = line.baudRate != hostBaudRate;
+            uint64_t at = std::max (line.at, _wireFree);
+            for (const char c : line.text)
+                _wire.push_back ({ at += byteTime (line.baudRate), garbled ? static_cast<char> (0xF0 | (c & 0x0F)) : c });
+            _wireFree = at;
+            _lines.pop_front ();
+        }
+    }
+    void respond (const std::string &line, const uint64_t arrived, const uint32_t after = 0) {
+        emitAt (line, arrived + (processing + after) * 1000ULL);
+    }
+    void command (const std::string &line, const uint64_t arrived) {
+        received.push_back ({ arrived, line });
+        _arrived = arrived;
+        if (baudRate != hostBaudRate || arrived < unresponsiveUntil)
+            return;
+        if (wedged && line != "AT+RESET")
+            return;
+        if (script && script (*this, line))
+            return;
+        if (line == "AT") {
+            respond ("OK", arrived);
+            return;
+        }
+        if (line == "AT+RESET") {
+            wedged = false;
+            _joinedAt = NEVER;
+            p2pReceiving = false;
+            restarts++;
+            for (const char *banner : BANNER)
+                respond (banner, arrived, resetDelay);
+            return;
+        }
+        if (line.compare (0, 3, "AT+") != 0) {
+            respond ("AT_ERROR", arrived);
+            return;
+        }
+        const size_t equals = line.find ('=');
+        const std::string key = line.substr (3, equals == std::string::npos ? std::string::npos : equals - 3), value = equals == std::string::npos ? std::string () : line.substr (equals + 1);
+        if (value == "?") {
+            if (key == "NJS")
+                respond ("AT+NJS=" + std::string (joined () ? "1" : "0"), arrived);
+            else if (key == "BAUD")
+                respond ("AT+BAUD=" + std::to_string (baudRate), arrived);
+            else if (settings.count (key) > 0)
+                respond ("AT+" + key + "=" + settings [key], arrived);
+            else {
+                respond ("AT_PARAM_ERROR", arrived);
+                return;
+            }
+            respond ("OK", arrived);
+            return;
+        }
+        if (key == "JOIN") {
+            respond ("OK", arrived);
+            respond (joinAccept ? "+EVT:JOINED" : "+EVT:JOIN_FAILED_" + std::string (joinFailure), arrived, joinDelay);
+            _joinedAt = joinAccept ? arrived + (processing + joinDelay) * 1000ULL : NEVER;
+        } else if (key == "SEND") {
+            if (! joined ()) {
+                respond ("AT_NO_NETWORK_JOINED", arrived);
+                return;
+            }
+            respond ("OK", arrived);
+            if (settings ["CFM"] == "1")
+                respond (confirmAccept ? "+EVT:SEND_CONFIRMED_OK" : "+EVT:SEND_CONFIRMED_FAILED", arrived, confirmDelay);
+            else
+                respond ("+EVT:TX_DONE", arrived, transmitDelay);
+        } else if (key == "PSEND") {
+            if (p2pReceiving) {
+                busy++;
+                respond ("AT_BUSY_ERROR", arrived);
+                return;
+            }
+            respond ("OK", arrived);
+            respond ("+EVT:TXP2P DONE", arrived, p2pAirtime);
+        } else if (key == "PRECV") {
+            p2pReceiving = value != "0";
+            respond ("OK", arrived);
+        } else if (key == "BAUD") {
+            respond ("OK", arrived);    // at the old rate, then the switch
+            baudRate = static_cast<uint32_t> (std::stoul (value));
+        } else {
+            if (! value.empty ())
+                settings [key] = value;
+            respond ("OK", arrived);
+        }
+    }
+};
+
+// -----------------------------------------------------------------------------------------------
+
+inline RakDeviceManager::Config managerConfig () {    // valid identifiers, otherwise the defaults
+    RakDeviceManager::Config config;
+    config.loraIdentifiers = { .devEUI = "AC1F09FFFE000001", .appEUI = "0000000000000000", .appKey = "2B7E151628AED2A6ABF7158809CF4F3C" };
+    return config;
+}
+inline void runFor (const interval_t duration, const std::function<void ()> &process, const interval_t slice = 10) {    // process () in a loop, as loop () would, for that much simulated time
+    const interval_t started = millis ();
+    while (millis () - started < duration) {
+        process ();
+        delay (slice);
+    }
+}
+inline bool runUntil (const std::function<bool ()> &condition, const interval_t timeout, const std::function<void ()> &process, const interval_t slice = 10) {
+    const interval_t started = millis ();
+    while (! condition ()) {
+        if (millis () - started >= timeout)
+            return false;
+        process ();
+        delay (slice);
+    }
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
@@ -0,0 +1,129 @@
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
+
+// What an application supplies ahead of the driver headers (see src/main.cpp), then the driver
+// itself: each test includes this, after any RAKDEVICE_ or DEBUG_RAKDEVICE defines of its own.
+
+#pragma once
+
+#include <Arduino.h>
+
+#include <vector>
+
+typedef unsigned long interval_t;
+typedef unsigned long counter_t;
+
+class ActivationTracker {
+    counter_t _count = 0;
+    interval_t _seconds = 0;
+
+public:
+    inline const interval_t &seconds () const {
+        return _seconds;
+    }
+    inline const counter_t &count () const {
+        return _count;
+    }
+    ActivationTracker &operator++ (int) {
+        _seconds = millis () / 1000;
+        _count++;
+        return *this;
+    }
+    ActivationTracker &operator= (const counter_t count) {
+        _seconds = millis () / 1000;
+        _count = count;
+        return *this;
+    }
+    inline operator counter_t () const {
+        return _count;
+    }
+};
+
+template <typename T>
+class TrackableValue {
+private:
+    T value;
+    bool updateResult { false };
+    interval_t updateTime { 0 };
+
+public:
+    TrackableValue () = default;
+    explicit TrackableValue (const T &initial) :
+        value (initial) { }
+
+    void update (const T &newValue) {
+        value = newValue;
+        updateResult = true;
+        updateTime = millis ();
+    }
+    TrackableValue &operator= (const T &newValue) {
+        update (newValue);
+        return *this;
+    }
+
+    void invalidate () {
+        updateResult = false;
+        updateTime = millis ();
+    }
+
+    const T &get () const { return value; }
+    operator const T & () const { return value; }
+
+    bool lastResult () const { return updateResult; }
+    interval_t lastTime () const { return updateTime; }
+};
+
+static String bytesToHexString (const uint8_t *data, size_t length) {
+    String result;
+    result.reserve (length * 2);
+    for (size_t i = 0; i < length; i++) {
+        const uint8_t byte = data [i];
+        result += "0123456789ABCDEF" [byte >> 4];
+        result += "0123456789ABCDEF" [byte & 0x0F];
+    }
+    return result;
+}
+
+static std::vector<uint8_t> hexStringToBytes (const String &data) {
+    auto hexDigitToInt = [] (char c) -> int {
+        if (c >= '0' && c <= '9')
+            return c - '0';
+        if (c >= 'A' && c <= 'F')
+            return c - 'A' + 10;
+        if (c >= 'a' && c <= 'f')
+            return c - 'a' + 10;
+        return 0;
+    };
+    std::vector<uint8_t> result;
+    size_t length = data.length () - (data.length () % 2);
+    result.reserve (length / 2);
+    for (size_t i = 0; i < length; i += 2)
+        result.push_back ((hexDigitToInt (data [i]) << 4) | hexDigitToInt (data [i + 1]));
+    return result;
+}
+
+template <typename... Args>
+static String join (const char delimiter, const Args &...args) {
+    const String values [] = { String (args)... };
+    String result;
+    for (size_t i = 0; i < sizeof...(args); i++) {
+        if (i > 0)
+            result += delimiter;
+        result += values [i];
+    }
+    return result;
+}
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
+
+#include "RakDeviceCommon.hpp"
+#include "RakDeviceCommands.hpp"
+#include "RakDeviceOptimiser.hpp"
+#include "RakDeviceManager.hpp"
+#include "RakDeviceMessenger.hpp"
+#include "RakDeviceFragmentation.hpp"
+#include "RakDeviceFragmenter.hpp"
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
@@ -0,0 +1,116 @@
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
+
+// RakDeviceCommander::issueBatch against FakeModule answering one command at a time, as the module
+// does: the round trip for a set of queries batched against issued one by one, in simulated
+// milliseconds, and a command slower than the rest that a batch must wait out as issue () would,
+// each command allowed RESPONSE_TIMEOUT from the answer before it.
+
+#include <unity.h>
+
+#include "FakeModule.hpp"
+
+void setUp () {
+    host::clock = 0;
+}
+void tearDown () { }
+
+// -----------------------------------------------------------------------------------------------
+
+struct InTurn {    // a commander to a module that answers queries in turn, one of them slower
+    FakeModule module;
+    RakDeviceTransceiver transceiver { module };
+    RakDeviceCommander commander { transceiver };
+    std::string slow;    // the setting whose query takes slowBy longer
+    uint32_t slowBy = 0;
+    uint64_t free = 0;    // simulated microseconds: the module is done with what it was given before
+
+    InTurn () {
+        module.script = [this] (FakeModule &module, const std::string &line) {
+            if (line.size () < 5 || line.compare (line.size () - 2, 2, "=?") != 0)
+                return false;
+            const std::string key = line.substr (3, line.size () - 5);
+            const uint64_t answered = std::max (module.received.back ().at, free) + (module.processing + (key == slow ? slowBy : 0)) * 1000ULL;
+            module.emitAt ("AT+" + key + "=" + module.settings [key], answered);
+            module.emitAt ("OK", answered);
+            free = answered;
+            return true;
+        };
+    }
+};
+
+struct Queries {
+    RakDeviceCommand_VERSION version;
+    RakDeviceCommand_DATARATE dataRate;
+    RakDeviceCommand_TX_POWER txPower;
+    RakDeviceCommand_ADR adr;
+    RakDeviceCommand_CONFIRM_MODE confirmMode;
+    RakDeviceCommand_DUTY_CYCLE dutyCycle;
+    static constexpr size_t COUNT = 6;
+    RakDeviceCommand *const list [COUNT] = { &version, &dataRate, &txPower, &adr, &confirmMode, &dutyCycle };
+};
+
+// -----------------------------------------------------------------------------------------------
+
+static void test_round_trip () {    // the same queries, one exchange each or written back to back
+    InTurn sequential, batched;
+    Queries queries;
+    interval_t started = millis ();
+    for (RakDeviceCommand *const command : queries.list)
+        TEST_ASSERT_TRUE (sequential.commander.issue (*command).success);
+    const interval_t one = millis () - started;
+    RakDeviceResult results [Queries::COUNT];
+    started = millis ();
+    TEST_ASSERT_TRUE (batched.commander.issueBatch (queries.list, Queries::COUNT, results).success);
+    const interval_t batch = millis () - started;
+    TEST_ASSERT_EQUAL_STRING ("4.1.0", queries.version.responseGet ().c_str ());
+    TEST_ASSERT_TRUE (queries.dutyCycle.getValue ());
+    TEST_ASSERT_LESS_THAN_UINT32 (one, batch);
+    char message [96];
+    snprintf (message, sizeof (message), "%zu queries: %lu ms one by one, %lu ms batched", Queries::COUNT, one, batch);
+    TEST_MESSAGE (message);
+}
+
+static void test_slow_command () {    // longer than a batch allowed all of its commands before, within what issue () allows one
+    InTurn serial;
+    serial.slow = "TXP";
+    serial.slowBy = 3000;
+    Queries queries;
+    RakDeviceResult results [Queries::COUNT];
+    const interval_t started = millis ();
+    TEST_ASSERT_TRUE (serial.commander.issueBatch (queries.list, Queries::COUNT, results).success);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32 (3000, millis () - started);
+    for (const RakDeviceResult &result : results)
+        TEST_ASSERT_TRUE (result.success);
+    TEST_ASSERT_EQUAL_UINT32 (0, serial.commander.timeouts ());
+    TEST_ASSERT_FALSE (serial.module.pending ());
+}
+
+static void test_silent_command () {    // past RESPONSE_TIMEOUT: that command and those behind it time out, once, and those before it stand
+    InTurn serial;
+    serial.slow = "TXP";
+    serial.slowBy = RakDeviceCommander::RESPONSE_TIMEOUT + 1000;
+    Queries queries;
+    RakDeviceResult results [Queries::COUNT];
+    const interval_t started = millis ();
+    TEST_ASSERT_FALSE (serial.commander.issueBatch (queries.list, Queries::COUNT, results).success);
+    TEST_ASSERT_LESS_THAN_UINT32 (RakDeviceCommander::RESPONSE_TIMEOUT + 1000, millis () - started);
+    TEST_ASSERT_TRUE (results [0].success);
+    TEST_ASSERT_TRUE (results [1].success);
+    for (size_t i = 2; i < Queries::COUNT; i++)
+        TEST_ASSERT_TRUE (results [i].details.indexOf ("response timeout") >= 0);
+    TEST_ASSERT_EQUAL_UINT32 (1, serial.commander.timeouts ());
+}
+
+// -----------------------------------------------------------------------------------------------
+
+int main () {
+    UNITY_BEGIN ();
+    RUN_TEST (test_round_trip);
+    RUN_TEST (test_slow_command);
+    RUN_TEST (test_silent_command);
+    return UNITY_END ();
+}
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
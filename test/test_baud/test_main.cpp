@@ -0,0 +1,126 @@
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
+
+// AT+BAUD against FakeModule: a rate outside Lora::BAUDRATES refused before it is sent, and refused
+// when the module reports one; a rate negotiated in begin (), retained, and probed first after a
+// warm restart of the host, the module still at it. And the UART time per uplink at each rate.
+
+#include <unity.h>
+
+#include "FakeModule.hpp"
+
+void setUp () {
+    host::clock = 0;
+    randomSeed (27);
+}
+void tearDown () { }
+
+// -----------------------------------------------------------------------------------------------
+
+struct Host {    // a manager whose host side of the UART is FakeModule's hostBaudRate, each rate applied recorded
+    std::vector<uint32_t> applied;
+    RakDeviceManager manager;
+
+    static RakDeviceManager::Config config (FakeModule &module, RakDeviceRetained &retained, const uint32_t baudRate, std::vector<uint32_t> &applied) {
+        RakDeviceManager::Config config = managerConfig ();
+        config.joinEngine.startJitter = 0;
+        config.loraParameters.confirmMode = false;
+        config.serial = { .baudRate = baudRate, .retained = &retained, .baudRateApply = [&module, &applied] (const uint32_t rate) { module.hostBaudRate = rate, applied.push_back (rate); } };
+        return config;
+    }
+    Host (FakeModule &module, RakDeviceRetained &retained, const uint32_t baudRate = 0) :
+        manager (config (module, retained, baudRate, applied), module) { }
+};
+
+// -----------------------------------------------------------------------------------------------
+
+static void test_rate_validated () {    // between the minimum and maximum is not enough: one of Lora::BAUDRATES, either way
+    FakeModule module;
+    RakDeviceTransceiver transceiver (module);
+    RakDeviceCommander commander (transceiver);
+    for (const int rate : { 100000, 115201, 2400, 1000000 }) {
+        RakDeviceCommand_BAUD set (rate);
+        const RakDeviceResult result = commander.issue (set);
+        TEST_ASSERT_FALSE (result.success);
+        TEST_ASSERT_TRUE (result.details.indexOf ("BAUD") >= 0);
+    }
+    TEST_ASSERT_EQUAL_size_t (0, module.count ("AT+BAUD"));    // none reached the module
+    for (const uint32_t rate : Lora::BAUDRATES) {
+        RakDeviceCommand_BAUD set (static_cast<int> (rate));
+        TEST_ASSERT_TRUE (commander.issue (set).success);
+        module.hostBaudRate = rate;
+    }
+    TEST_ASSERT_EQUAL_size_t (std::size (Lora::BAUDRATES), module.count ("AT+BAUD="));
+    module.script = [] (FakeModule &module, const std::string &line) {
+        if (line != "AT+BAUD=?")
+            return false;
+        module.reply ("AT+BAUD=100000");
+        module.reply ("OK");
+        return true;
+    };
+    RakDeviceCommand_BAUD query;
+    TEST_ASSERT_FALSE (commander.issue (query).success);
+}
+
+static void test_negotiated_and_retained () {    // begin () at 921600, then a warm restart: the retained rate is the first one probed
+    FakeModule module;
+    RakDeviceRetained retained {};
+    {
+        Host host (module, retained, 921600);
+        TEST_ASSERT_TRUE (host.manager.begin ());
+        TEST_ASSERT_EQUAL_UINT32 (921600, host.manager.status ().baudRate);
+        TEST_ASSERT_EQUAL_UINT32 (921600, module.baudRate);
+        TEST_ASSERT_EQUAL_UINT32 (RakDeviceRetained::MAGIC, retained.magic);
+        TEST_ASSERT_EQUAL_UINT32 (921600, retained.baudRate);
+        TEST_ASSERT_EQUAL_UINT32 (RakDeviceManager::BAUDRATE_DEFAULT, host.applied.front ());    // nothing retained yet: the default first
+    }
+    module.hostBaudRate = RakDeviceManager::BAUDRATE_DEFAULT;    // the host restarts, its UART at the default, the module carries on
+    const size_t negotiations = module.count ("AT+BAUD=");
+    Host host (module, retained, 921600);
+    TEST_ASSERT_TRUE (host.manager.begin ());
+    TEST_ASSERT_EQUAL_UINT32 (921600, host.applied.front ());
+    TEST_ASSERT_EQUAL_size_t (1, host.applied.size ());    // found at once, nothing else tried
+    TEST_ASSERT_EQUAL_UINT32 (921600, host.manager.status ().baudRate);
+    TEST_ASSERT_EQUAL_size_t (negotiations, module.count ("AT+BAUD="));    // and not negotiated again
+}
+
+static void test_transmit_timing () {    // the same uplinks at the default rate and at 921600: the UART's share of each, by rate
+    constexpr int UPLINKS = 5;
+    const String payload (String ("0123456789ABCDEF0123456789ABCDEF0123456789ABCDEF"));    // 48 bytes, 96 hex digits on the wire
+    uint32_t averages [2] = { 0 };
+    char message [160];
+    for (const uint32_t rate : { RakDeviceManager::BAUDRATE_DEFAULT, 921600U }) {
+        FakeModule module;
+        RakDeviceRetained retained {};
+        Host host (module, retained, rate);
+        TEST_ASSERT_TRUE (host.manager.begin ());
+        TEST_ASSERT_TRUE (runUntil ([&] { return host.manager.getState () == RakDeviceManager::State::JOIN_SUCCESS; }, 60 * 1000, [&] { host.manager.process (); }));
+        for (int uplink = 0; uplink < UPLINKS; uplink++) {
+            TEST_ASSERT_TRUE (host.manager.transmit (1, payload));
+            runFor (5 * 1000, [&] { host.manager.process (); });
+        }
+        const auto &timing = host.manager.status ().transmitTiming;
+        TEST_ASSERT_EQUAL_size_t (1, timing.size ());
+        for (const auto &[baudRate, at] : timing) {
+            TEST_ASSERT_EQUAL_UINT32 (rate, baudRate);
+            TEST_ASSERT_EQUAL_UINT32 (UPLINKS, at.count);
+            averages [rate == 921600] = at.total / at.count;
+            snprintf (message, sizeof (message), "baud=%lu: uplinks=%lu, AT+SEND to its response %lu ms average, %lu ms maximum", (unsigned long) baudRate, at.count, at.total / at.count, at.maximum);
+            TEST_MESSAGE (message);
+        }
+    }
+    TEST_ASSERT_LESS_THAN_UINT32 (averages [0], averages [1]);
+}
+
+// -----------------------------------------------------------------------------------------------
+
+int main () {
+    UNITY_BEGIN ();
+    RUN_TEST (test_rate_validated);
+    RUN_TEST (test_negotiated_and_retained);
+    RUN_TEST (test_transmit_timing);
+    return UNITY_END ();
+}
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
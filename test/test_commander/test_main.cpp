@@ -0,0 +1,147 @@
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
+
+// RakDeviceCommander against FakeModule: each response read through to its own terminator, so
+// nothing is left over to answer the next command, and unsolicited lines that arrive ahead of a
+// response delivered in the order they came, however many there are.
+
+#include <unity.h>
+
+#include "FakeModule.hpp"
+
+void setUp () {
+    host::clock = 0;
+}
+void tearDown () { }
+
+// -----------------------------------------------------------------------------------------------
+
+struct Commander {
+    FakeModule module;
+    RakDeviceTransceiver transceiver { module };
+    std::vector<String> events;    // type:args, as delivered
+    RakDeviceCommander commander { transceiver, [this] (const RakDeviceEvent &event) { events.push_back (event.type + ":" + event.args); } };
+};
+
+static bool answer (FakeModule &module, const std::vector<std::string> &lines) {    // as the script's reply, in place of the module's own
+    for (const auto &line : lines)
+        module.reply (line);
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------
+
+static void test_query_then_set () {    // configureSetting: the query's OK, slow to follow its value, must not be taken as the setter's answer
+    Commander c;
+    c.module.script = [] (FakeModule &module, const std::string &line) {
+        if (line == "AT+DR=?") {
+            module.reply ("AT+DR=0");
+            module.reply ("OK", 20);
+            return true;
+        }
+        return line == "AT+DR=3" && answer (module, { "AT_PARAM_ERROR" });
+    };
+    RakDeviceCommand_DATARATE query;
+    TEST_ASSERT_TRUE (c.commander.issue (query).success);
+    TEST_ASSERT_EQUAL_INT (0, query.getValue ());
+    RakDeviceCommand_DATARATE set (3);
+    const RakDeviceResult result = c.commander.issue (set);
+    TEST_ASSERT_FALSE (result.success);
+    TEST_ASSERT_FALSE (c.module.pending ());
+}
+
+static void test_query_terminated_by_error () {    // a value, then an error where OK should be: failed, and the error consumed
+    Commander c;
+    c.module.script = [] (FakeModule &module, const std::string &line) {
+        return line == "AT+DR=?" && answer (module, { "AT+DR=2", "AT_ERROR" });
+    };
+    RakDeviceCommand_DATARATE query;
+    const RakDeviceResult result = c.commander.issue (query);
+    TEST_ASSERT_FALSE (result.success);
+    TEST_ASSERT_TRUE (result.details.indexOf ("terminated by 'AT_ERROR'") >= 0);
+    c.module.script = nullptr;
+    RakDeviceCommand_DATARATE set (4);
+    TEST_ASSERT_TRUE (c.commander.issue (set).success);
+    TEST_ASSERT_EQUAL_STRING ("4", c.module.settings ["DR"].c_str ());
+}
+
+static void test_batch_terminators () {    // queries back to back, an error in place of one value: each answer goes to its own query, nothing left over
+    Commander c;
+    c.module.script = [] (FakeModule &module, const std::string &line) {
+        return line == "AT+TXP=?" && answer (module, { "AT_PARAM_ERROR" });
+    };
+    RakDeviceCommand_DATARATE dataRate;
+    RakDeviceCommand_TX_POWER txPower;
+    RakDeviceCommand_ADR adr;
+    RakDeviceCommand *const commands [] = { &dataRate, &txPower, &adr };
+    RakDeviceResult results [3];
+    TEST_ASSERT_FALSE (c.commander.issueBatch (commands, 3, results).success);
+    TEST_ASSERT_TRUE (results [0].success);
+    TEST_ASSERT_FALSE (results [1].success);
+    TEST_ASSERT_TRUE (results [1].details.indexOf ("AT_PARAM_ERROR") >= 0);
+    TEST_ASSERT_TRUE (results [2].success);
+    TEST_ASSERT_TRUE (adr.getValue ());
+    TEST_ASSERT_FALSE (c.module.pending ());
+    c.module.script = [] (FakeModule &module, const std::string &line) {
+        return line == "AT+CFM=1" && answer (module, { "AT_PARAM_ERROR" });
+    };
+    RakDeviceCommand_CONFIRM_MODE set (true);
+    TEST_ASSERT_FALSE (c.commander.issue (set).success);    // not the batch's last OK
+}
+
+static void test_unsolicited_in_order () {    // a burst ahead of the response, up to what the queue holds: all deferred, then delivered in order
+    Commander c;
+    constexpr size_t BURST = RAKDEVICE_UNSOLICITED_SIZE - 1;
+    c.module.script = [] (FakeModule &module, const std::string &line) {
+        if (line != "AT+VER=?")
+            return false;
+        for (size_t i = 0; i < BURST; i++)
+            module.reply ("+EVT:LINKCHECK:" + std::to_string (i));
+        return answer (module, { "AT+VER=4.1.0", "OK" });
+    };
+    RakDeviceCommand_VERSION version;
+    TEST_ASSERT_TRUE (c.commander.issue (version).success);
+    TEST_ASSERT_EQUAL_STRING ("4.1.0", version.responseGet ().c_str ());
+    TEST_ASSERT_EQUAL_UINT32 (BURST, c.events.size ());
+    for (size_t i = 0; i < BURST; i++)
+        TEST_ASSERT_EQUAL_STRING (("LINKCHECK:" + std::to_string (i)).c_str (), c.events [i].c_str ());
+    TEST_ASSERT_EQUAL_UINT32 (BURST, c.commander.interleaved ());
+}
+
+static void test_unsolicited_backlog () {    // more than the queue holds: the command gives up reading rather than deliver any out of order
+    Commander c;
+    constexpr size_t BURST = RAKDEVICE_UNSOLICITED_SIZE + 4;
+    c.module.script = [] (FakeModule &module, const std::string &line) {
+        if (line != "AT+VER=?")
+            return false;
+        for (size_t i = 0; i < BURST; i++)
+            module.reply ("+EVT:LINKCHECK:" + std::to_string (i));
+        return answer (module, { "AT+VER=4.1.0", "OK" });
+    };
+    RakDeviceCommand_VERSION version;
+    const RakDeviceResult result = c.commander.issue (version);
+    TEST_ASSERT_FALSE (result.success);
+    TEST_ASSERT_TRUE (result.details.indexOf ("unsolicited backlog") >= 0);
+    TEST_ASSERT_EQUAL_UINT32 (0, c.commander.timeouts ());    // the module did answer
+    c.commander.process ();    // the rest, from the stream
+    TEST_ASSERT_EQUAL_UINT32 (BURST, c.events.size ());
+    for (size_t i = 0; i < BURST; i++)
+        TEST_ASSERT_EQUAL_STRING (("LINKCHECK:" + std::to_string (i)).c_str (), c.events [i].c_str ());
+    c.module.script = nullptr;
+    TEST_ASSERT_TRUE (c.commander.issue (version).success);    // and the next command is answered by its own response
+}
+
+// -----------------------------------------------------------------------------------------------
+
+int main () {
+    UNITY_BEGIN ();
+    RUN_TEST (test_query_then_set);
+    RUN_TEST (test_query_terminated_by_error);
+    RUN_TEST (test_batch_terminators);
+    RUN_TEST (test_unsolicited_in_order);
+    RUN_TEST (test_unsolicited_backlog);
+    return UNITY_END ();
+}
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
@@ -0,0 +1,111 @@
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
+
+// The fixed capacity profile over a simulated day against FakeModule: joined, an uplink every five
+// minutes and the periodic status, link check, network time and health work in between. Every
+// allocation in the process is counted; the Strings of each exchange and event still take from the
+// heap, but what is live on the hour must not creep, nor the peak once the timers have all met.
+
+#define RAKDEVICE_FIXED_CAPACITY
+
+#include <unity.h>
+
+#include "FakeModule.hpp"
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+namespace heap {
+size_t live = 0, peak = 0, allocations = 0;
+}
+
+static void *allocate (const size_t size) {    // the size ahead of the block, so that delete can account for it
+    void *block = std::malloc (size + alignof (std::max_align_t));
+    if (block == nullptr)
+        throw std::bad_alloc ();
+    *static_cast<size_t *> (block) = size;
+    heap::live += size, heap::allocations++;
+    heap::peak = std::max (heap::peak, heap::live);
+    return static_cast<char *> (block) + alignof (std::max_align_t);
+}
+static void release (void *pointer) {
+    if (pointer == nullptr)
+        return;
+    void *block = static_cast<char *> (pointer) - alignof (std::max_align_t);
+    heap::live -= *static_cast<size_t *> (block);
+    std::free (block);
+}
+void *operator new (const size_t size) { return allocate (size); }
+void *operator new[] (const size_t size) { return allocate (size); }
+void operator delete (void *pointer) noexcept { release (pointer); }
+void operator delete[] (void *pointer) noexcept { release (pointer); }
+void operator delete (void *pointer, size_t) noexcept { release (pointer); }
+void operator delete[] (void *pointer, size_t) noexcept { release (pointer); }
+
+void setUp () {
+    host::clock = 0;
+    randomSeed (41);
+}
+void tearDown () { }
+
+// -----------------------------------------------------------------------------------------------
+
+static void test_sizes () {    // static size per subsystem, as reportFootprint () prints it on the device
+    char message [192];
+    snprintf (message, sizeof (message), "manager=%zu (status=%zu, scheduler=%zu), messenger=%zu, fragmenter=%zu, commander=%zu, transceiver=%zu", sizeof (RakDeviceManager), sizeof (RakDeviceManager::Status), sizeof (RakDeviceManager::Scheduler), sizeof (RakDeviceMessenger), sizeof (RakDeviceFragmenter), sizeof (RakDeviceCommander), sizeof (RakDeviceTransceiver));
+    TEST_MESSAGE (message);
+    TEST_ASSERT_TRUE (sizeof (RakDeviceEvent::Handler) == 2 * sizeof (void *));    // a function and its context
+}
+
+static void test_day () {    // live bytes on the hour, and the peak: no growth once every periodic path has run together
+    static constexpr interval_t HOUR = 60 * 60 * 1000, UPLINK = 5 * 60 * 1000, SLICE = 1000;
+    static constexpr int SETTLED = 4;    // hours: the timers' phases have all met by then
+    FakeModule module;
+    RakDeviceManager::Config config = managerConfig ();
+    config.joinEngine.startJitter = 0;
+    RakDeviceManager manager (config, module);
+    RakDeviceMessenger messenger (manager);
+    TEST_ASSERT_TRUE (manager.begin ());
+
+    size_t hourPeak = 0, hourLive = 0, settledPeak = 0, liveMaximum = 0;
+    counter_t uplinks = 0;
+    interval_t uplinkLast = 0;
+    for (int hour = 1; hour <= 24; hour++) {
+        runFor (HOUR, [&] {
+            manager.process ();
+            messenger.process ();
+            if (manager.getState () == RakDeviceManager::State::JOIN_SUCCESS && millis () - uplinkLast >= UPLINK) {
+                uplinkLast = millis ();
+                if (messenger.try_transmit ({ 1, "footprint " + String (uplinks), true, millis () }))
+                    uplinks++;
+            }
+            module.received.clear ();    // the module's own record, not the driver's
+        }, SLICE);
+        if (hour == 1)
+            hourPeak = heap::peak, hourLive = heap::live;
+        if (hour == SETTLED)
+            settledPeak = heap::peak;
+        liveMaximum = std::max (liveMaximum, heap::live);
+    }
+    TEST_ASSERT_TRUE (manager.getState () == RakDeviceManager::State::JOIN_SUCCESS);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32 (24 * 12 - 2, uplinks);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32 (24 * 12 - 4, messenger.stats ().transmitsSucceeded);
+    TEST_ASSERT_EQUAL_size_t (hourLive, liveMaximum);    // nothing retained from one hour to the next
+    TEST_ASSERT_EQUAL_size_t (settledPeak, heap::peak);    // nor anything reaching higher, once settled
+    char message [192];
+    snprintf (message, sizeof (message), "24 h: uplinks=%lu, allocations=%zu, live=%zu (on the hour, at most %zu), peak=%zu bytes (after hour 1: %zu)", uplinks, heap::allocations, heap::live, liveMaximum, heap::peak, hourPeak);
+    TEST_MESSAGE (message);
+}
+
+// -----------------------------------------------------------------------------------------------
+
+int main () {
+    UNITY_BEGIN ();
+    RUN_TEST (test_sizes);
+    RUN_TEST (test_day);
+    return UNITY_END ();
+}
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
@@ -0,0 +1,153 @@
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
+
+// RakDeviceFragmenter through the messenger and manager to FakeModule, each uplink lost on the way
+// to the network at a given rate, and what arrives handed to RakDeviceDefragmenter as the far end
+// would: the fraction of blobs recovered, and the bytes per second actually recovered against what
+// the fragmenter sent, by loss and redundancy. And the reassembler's held coded fragments bounded,
+// however often one is repeated.
+
+#include <unity.h>
+
+#include "FakeModule.hpp"
+
+void setUp () {
+    host::clock = 0;
+    randomSeed (29);
+}
+void tearDown () { }
+
+// -----------------------------------------------------------------------------------------------
+
+struct Link {    // joined, unconfirmed uplinks at SF9, the network receiving each with probability 1 - loss
+    FakeModule module;
+    RakDeviceManager manager;
+    RakDeviceMessenger messenger;
+    RakDeviceFragmenter fragmenter;
+    RakDeviceDefragmenter defragmenter;
+    int loss = 0;    // percent
+    size_t delivered = 0, lost = 0;
+
+    static RakDeviceManager::Config config () {
+        RakDeviceManager::Config config = managerConfig ();
+        config.loraParameters.confirmMode = false;
+        config.loraParameters.adaptiveDataRate = false;
+        config.loraParameters.dataRate = Lora::Datarate::SF9;
+        config.joinEngine.startJitter = 0;
+        return config;
+    }
+    explicit Link (const int redundancy) :
+        manager (config (), module),
+        messenger (manager),
+        fragmenter (messenger, manager, { .redundancy = redundancy, .pacing = 2000 }) {
+        module.script = [this] (FakeModule &, const std::string &line) {
+            static const std::string SEND = "AT+SEND=";
+            if (line.compare (0, SEND.size (), SEND) != 0)
+                return false;
+            if (random (100) < loss)
+                lost++;
+            else {
+                const std::vector<uint8_t> message = hexStringToBytes (String (line.substr (line.find (':') + 1).c_str ()));
+                defragmenter.process (message.data (), message.size ());
+                delivered++;
+            }
+            return false;    // and the module answers it as ever
+        };
+        TEST_ASSERT_TRUE (manager.begin ());
+        TEST_ASSERT_TRUE (runUntil ([this] { return manager.getState () == RakDeviceManager::State::JOIN_SUCCESS; }, 60 * 1000, [this] { manager.process (); }));
+    }
+    bool send (const std::vector<uint8_t> &blob) {    // one session, through to its last fragment: true if the far end has the blob
+        if (! fragmenter.send (blob.data (), blob.size ()))
+            return false;
+        runUntil ([this] { return ! fragmenter.isActive (); }, 10 * 60 * 1000, [this] { manager.process (); fragmenter.process (); }, 50);
+        runFor (5 * 1000, [this] { manager.process (); }, 50);    // the last one out
+        return defragmenter.isComplete () && defragmenter.size () == blob.size () && memcmp (defragmenter.data (), blob.data (), blob.size ()) == 0;
+    }
+};
+
+struct Outcome {
+    float recovered, sent, goodput;    // fraction of blobs, blob bytes/s the fragmenter sent, blob bytes/s the far end recovered
+};
+
+static Outcome run (const int loss, const int redundancy, const int sessions = 20, const size_t size = 1024) {
+    Link link (redundancy);
+    link.loss = loss;
+    std::vector<uint8_t> blob (size);
+    int recovered = 0;
+    const interval_t started = millis ();
+    for (int session = 0; session < sessions; session++) {
+        for (auto &byte : blob)
+            byte = static_cast<uint8_t> (random (256));
+        if (link.send (blob))
+            recovered++;
+    }
+    const interval_t elapsed = millis () - started;
+    TEST_ASSERT_EQUAL_UINT32 (sessions, link.fragmenter.stats ().sessions);
+    const Outcome outcome { .recovered = static_cast<float> (recovered) / sessions, .sent = link.fragmenter.stats ().throughput (), .goodput = static_cast<float> (recovered * size) * 1000.0f / elapsed };
+    char message [160];
+    snprintf (message, sizeof (message), "loss=%2d%% redundancy=%2d%%: recovered %5.1f%% of blobs, %6.2f bytes/s of %6.2f sent (fragments delivered %zu, lost %zu)", loss, redundancy, outcome.recovered * 100.0f, outcome.goodput, outcome.sent, link.delivered, link.lost);
+    TEST_MESSAGE (message);
+    return outcome;
+}
+
+// -----------------------------------------------------------------------------------------------
+
+static void test_lossless () {    // everything arrives: every blob, and the far end's rate is the sent rate less the coded overhead
+    for (const int redundancy : { 0, 20, 50 }) {
+        const Outcome outcome = run (0, redundancy, 5);
+        TEST_ASSERT_EQUAL_FLOAT (1.0f, outcome.recovered);
+        TEST_ASSERT_LESS_OR_EQUAL_FLOAT (outcome.sent, outcome.goodput);
+    }
+}
+
+static void test_loss () {    // by loss and redundancy: without coded fragments any loss costs the blob, with them it is recovered
+    constexpr int LOSSES [] = { 5, 10, 20, 30 }, REDUNDANCIES [] = { 0, 20, 50 };
+    Outcome outcomes [std::size (LOSSES)][std::size (REDUNDANCIES)];
+    for (size_t l = 0; l < std::size (LOSSES); l++)
+        for (size_t r = 0; r < std::size (REDUNDANCIES); r++) {
+            outcomes [l][r] = run (LOSSES [l], REDUNDANCIES [r]);
+            TEST_ASSERT_LESS_OR_EQUAL_FLOAT (outcomes [l][r].sent, outcomes [l][r].goodput);
+        }
+    for (size_t l = 0; l < std::size (LOSSES); l++) {
+        TEST_ASSERT_GREATER_OR_EQUAL_FLOAT (outcomes [l][0].recovered, outcomes [l][2].recovered);
+        TEST_ASSERT_GREATER_OR_EQUAL_FLOAT (outcomes [l][0].goodput, outcomes [l][2].goodput);
+    }
+    TEST_ASSERT_GREATER_OR_EQUAL_FLOAT (0.8f, outcomes [1][2].recovered);    // 10% loss, half again as many coded: nearly all
+    TEST_ASSERT_LESS_THAN_FLOAT (0.5f, outcomes [2][0].recovered);         // 20% loss, none coded: each of a dozen uplinks must arrive
+}
+
+static void test_coded_bounded () {    // a coded fragment repeated, or more of them than there are data fragments: never more rows than fragments
+    constexpr uint16_t FRAGMENTS = 8;
+    constexpr uint8_t FRAGMENT_SIZE = 16;
+    RakDeviceDefragmenter defragmenter;
+    uint8_t message [RakDeviceFragmentation::DATA_FRAGMENT_HEADER_SIZE + FRAGMENT_SIZE];
+    RakDeviceFragmentation::encodeSession (message, { .session = 1, .fragments = FRAGMENTS, .fragmentSize = FRAGMENT_SIZE });
+    TEST_ASSERT_TRUE (defragmenter.process (message, RakDeviceFragmentation::SESSION_SETUP_SIZE) == RakDeviceDefragmenter::Result::ACCEPTED);
+    auto coded = [&] (const uint16_t N) {
+        RakDeviceFragmentation::encodeFragmentHeader (message, 1, FRAGMENTS + N);
+        for (size_t i = RakDeviceFragmentation::DATA_FRAGMENT_HEADER_SIZE; i < sizeof (message); i++)
+            message [i] = static_cast<uint8_t> (random (256));
+        return defragmenter.process (message, sizeof (message));
+    };
+    for (int repeat = 0; repeat < 1000; repeat++)
+        TEST_ASSERT_TRUE (coded (1) == RakDeviceDefragmenter::Result::ACCEPTED);
+    TEST_ASSERT_EQUAL_size_t (1, defragmenter.fragmentsCoded ());
+    for (uint16_t N = 2; N < 200 && ! defragmenter.isComplete (); N++) {
+        coded (N);
+        TEST_ASSERT_LESS_OR_EQUAL_size_t (FRAGMENTS, defragmenter.fragmentsCoded ());
+    }
+    TEST_ASSERT_TRUE (defragmenter.isComplete ());    // solved from coded fragments alone, however many were dependent
+}
+
+// -----------------------------------------------------------------------------------------------
+
+int main () {
+    UNITY_BEGIN ();
+    RUN_TEST (test_lossless);
+    RUN_TEST (test_loss);
+    RUN_TEST (test_coded_bounded);
+    return UNITY_END ();
+}
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
@@ -0,0 +1,146 @@
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
+
+// Fault detection and tiered recovery against FakeModule: a probe that goes unanswered once is
+// recovered by the next probe, a module wedged until AT+RESET by the reset and re-initialisation,
+// and a banner in service by re-initialisation alone. Each is checked for its counters, its time
+// to recover, and that the device is joined again after.
+
+#include <unity.h>
+
+#include "FakeModule.hpp"
+
+void setUp () {
+    host::clock = 0;
+    randomSeed (38);
+}
+void tearDown () { }
+
+// -----------------------------------------------------------------------------------------------
+
+struct Joined {    // a manager joined to FakeModule, quiet but for the health checks
+    FakeModule module;
+    RakDeviceManager manager;
+    std::vector<String> health;    // STATUS_HEALTH, FAULT or the recovery tier
+
+    static RakDeviceManager::Config config () {
+        RakDeviceManager::Config config = managerConfig ();
+        config.statusInterval = config.linkCheckInterval = config.networkTimeInterval = 24 * 60 * 60 * 1000;
+        config.healthInterval = 10 * 1000;
+        config.joinEngine.startJitter = 0;
+        return config;
+    }
+    Joined () :
+        manager (config (), module) {
+        manager.addEventListener ([this] (const RakDeviceManager::Event event, const RakDeviceManager::EventArgs &args) {
+            if (event == RakDeviceManager::Event::STATUS_HEALTH)
+                health.push_back (args [0] == "FAULT" ? args [0] : args [1]);
+        });
+        TEST_ASSERT_TRUE (manager.begin ());
+        TEST_ASSERT_TRUE (runUntil ([this] { return joined (); }, 60 * 1000, [this] { process (); }));
+    }
+    void process () { manager.process (); }
+    bool joined () const { return manager.getState () == RakDeviceManager::State::JOIN_SUCCESS; }
+    const RakDeviceManager::Status::Health &stats () const { return manager.status ().health; }
+    bool recover (const interval_t timeout = 60 * 1000) {    // until recovered, or timeout
+        return runUntil ([this] { return stats ().recoveries > 0; }, timeout, [this] { process (); });
+    }
+};
+
+// -----------------------------------------------------------------------------------------------
+
+static void test_transient_silence () {    // the health probe goes unanswered, the module silent for half a second: the recovery probe finds it back
+    Joined device;
+    device.module.script = [] (FakeModule &module, const std::string &line) {
+        if (line != "AT" || module.unresponsiveUntil > 0)
+            return false;
+        module.unresponsiveUntil = host::clock + 500 * 1000;
+        return true;
+    };
+    const size_t joins = device.module.count ("AT+JOIN");
+    TEST_ASSERT_TRUE (device.recover ());
+    const auto &health = device.stats ();
+    TEST_ASSERT_EQUAL_UINT32 (1, health.faults);
+    TEST_ASSERT_EQUAL_UINT32 (1, health.probes);
+    TEST_ASSERT_EQUAL_UINT32 (0, health.resets);
+    TEST_ASSERT_EQUAL_UINT32 (0, health.reinitialisations);
+    TEST_ASSERT_EQUAL_UINT32 (0, health.failures);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32 (100, health.mttr ());    // a probe's round trip: the silence was over by the time it was noticed
+    TEST_ASSERT_EQUAL_UINT32 (health.mttr (), health.recoveryMaximum);
+    TEST_ASSERT_TRUE (device.joined ());
+    TEST_ASSERT_EQUAL_UINT32 (joins, device.module.count ("AT+JOIN"));    // the session was kept
+    TEST_ASSERT_EQUAL_UINT32 (2, device.health.size ());
+    TEST_ASSERT_EQUAL_STRING ("probe", device.health [1].c_str ());
+    char message [96];
+    snprintf (message, sizeof (message), "probe: mttr=%lu ms", health.mttr ());
+    TEST_MESSAGE (message);
+}
+
+static void test_wedged_until_reset () {    // nothing but AT+RESET is answered: probe, reset, re-initialise and rejoin
+    Joined device;
+    device.module.wedged = true;
+    TEST_ASSERT_TRUE (device.recover ());
+    const auto &health = device.stats ();
+    TEST_ASSERT_EQUAL_UINT32 (1, health.faults);
+    TEST_ASSERT_EQUAL_UINT32 (1, health.probes);
+    TEST_ASSERT_EQUAL_UINT32 (1, health.resets);
+    TEST_ASSERT_EQUAL_UINT32 (1, health.reinitialisations);
+    TEST_ASSERT_EQUAL_UINT32 (0, health.failures);
+    TEST_ASSERT_EQUAL_UINT32 (1, device.module.count ("AT+RESET"));
+    TEST_ASSERT_GREATER_THAN_UINT32 (0, health.settingsSkipped);    // the module kept its settings over the reset
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32 (RakDeviceManager::HEALTH_PROBE_TIMEOUT + RakDeviceManager::RESET_SETTLE_DELAY, health.mttr ());
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32 (10 * 1000, health.mttr ());
+    TEST_ASSERT_EQUAL_STRING ("reset", device.health.back ().c_str ());
+    TEST_ASSERT_TRUE (runUntil ([&] { return device.joined (); }, 60 * 1000, [&] { device.process (); }));
+    char message [96];
+    snprintf (message, sizeof (message), "reset: mttr=%lu ms", health.mttr ());
+    TEST_MESSAGE (message);
+}
+
+static void test_unexpected_banner () {    // the module restarted by itself, joined no longer: re-initialise without probing or resetting
+    Joined device;
+    delay (1000);
+    device.module.restart ();
+    TEST_ASSERT_TRUE (device.recover ());
+    const auto &health = device.stats ();
+    TEST_ASSERT_EQUAL_UINT32 (1, health.faults);
+    TEST_ASSERT_EQUAL_UINT32 (0, health.probes);
+    TEST_ASSERT_EQUAL_UINT32 (0, health.resets);
+    TEST_ASSERT_EQUAL_UINT32 (1, health.reinitialisations);
+    TEST_ASSERT_EQUAL_UINT32 (0, device.module.count ("AT+RESET"));
+    TEST_ASSERT_EQUAL_STRING ("module restarted", health.lastFault.c_str ());
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32 (RakDeviceManager::RESET_SETTLE_DELAY, health.mttr ());
+    TEST_ASSERT_EQUAL_STRING ("re-initialise", device.health.back ().c_str ());
+    TEST_ASSERT_TRUE (runUntil ([&] { return device.joined (); }, 60 * 1000, [&] { device.process (); }));
+    TEST_ASSERT_EQUAL_UINT32 (2, device.manager.joinEngine ().stats ().joins);
+    char message [96];
+    snprintf (message, sizeof (message), "re-initialise: mttr=%lu ms", health.mttr ());
+    TEST_MESSAGE (message);
+}
+
+static void test_recovery_failure () {    // wedged beyond AT+RESET: counted as a failure and retried a health interval later
+    Joined device;
+    device.module.script = [] (FakeModule &, const std::string &) { return true; };    // deaf, reset or not
+    TEST_ASSERT_TRUE (runUntil ([&] { return device.stats ().failures >= 2; }, 60 * 1000, [&] { device.process (); }));
+    TEST_ASSERT_EQUAL_UINT32 (0, device.stats ().recoveries);
+    TEST_ASSERT_EQUAL_UINT32 (1, device.stats ().faults);
+    TEST_ASSERT_EQUAL_UINT32 (2, device.stats ().resets);
+    device.module.script = nullptr;
+    TEST_ASSERT_TRUE (device.recover ());
+    TEST_ASSERT_EQUAL_UINT32 (device.stats ().recoveryMaximum, device.stats ().mttr ());
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32 (2 * 10 * 1000, device.stats ().mttr ());    // from detection, across the failed attempts
+}
+
+// -----------------------------------------------------------------------------------------------
+
+int main () {
+    UNITY_BEGIN ();
+    RUN_TEST (test_transient_silence);
+    RUN_TEST (test_wedged_until_reset);
+    RUN_TEST (test_unexpected_banner);
+    RUN_TEST (test_recovery_failure);
+    return UNITY_END ();
+}
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
@@ -0,0 +1,305 @@
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
+
+// RakDeviceJoinEngine on the simulated clock: backoff bounds and jitter spread, the duty cycle
+// ledger, the data rate walk and each JOIN_FAILED_ reason, then the manager driving it against
+// FakeModule, and a fleet powering up together against a lockstep baseline.
+
+#include <unity.h>
+
+#include "FakeModule.hpp"
+
+using Failure = RakDeviceJoinEngine::Failure;
+
+static const RakDeviceRegion &EU868 = RakDeviceRegion::of (Lora::Band::BAND_EU868);
+
+void setUp () {
+    host::clock = 0;
+    randomSeed (46);
+}
+void tearDown () { }
+
+// -----------------------------------------------------------------------------------------------
+
+static void test_backoff_bounds () {
+    const RakDeviceJoinEngine::Config config { .startJitter = 0, .backoffMinimum = 10 * 1000, .backoffMaximum = 60 * 60 * 1000, .dutyCycle = false };
+    RakDeviceJoinEngine engine (config, EU868);
+    TEST_ASSERT_EQUAL_UINT32 (0, engine.begin ());
+    for (int failures = 0; failures < 40; failures++) {    // well beyond the shift of 16
+        engine.attempt ();
+        const interval_t wait = engine.failure (Failure::RX_TIMEOUT);
+        const interval_t backoff = failures < 16 ? std::min<interval_t> (config.backoffMaximum, config.backoffMinimum << failures) : config.backoffMaximum;
+        TEST_ASSERT_GREATER_OR_EQUAL_UINT32 (backoff / 2, wait);
+        TEST_ASSERT_LESS_OR_EQUAL_UINT32 (backoff, wait);
+    }
+}
+
+static void test_backoff_overflow () {    // a minimum whose shift passes the width of interval_t: clamped to the maximum, not wrapped to nothing
+    constexpr interval_t maximum = std::numeric_limits<interval_t>::max ();
+    const RakDeviceJoinEngine::Config config { .startJitter = 0, .backoffMinimum = maximum / 8 + 1, .backoffMaximum = maximum / 4, .dutyCycle = false };
+    RakDeviceJoinEngine engine (config, EU868);
+    (void) engine.begin ();
+    for (int failures = 0; failures < 20; failures++) {
+        engine.attempt ();
+        const interval_t wait = engine.failure (Failure::RX_TIMEOUT);
+        TEST_ASSERT_GREATER_OR_EQUAL_UINT64 (config.backoffMinimum / 2, wait);
+        TEST_ASSERT_LESS_OR_EQUAL_UINT64 (config.backoffMaximum, wait);
+    }
+}
+
+static void test_jitter_spread () {    // devices powering up together: the first attempt and the first backoff each spread across their range
+    constexpr int DEVICES = 1000, BUCKETS = 10;
+    const RakDeviceJoinEngine::Config config { .startJitter = 5 * 1000, .backoffMinimum = 10 * 1000, .dutyCycle = false };
+    int starts [BUCKETS] = {}, backoffs [BUCKETS] = {};
+    for (int i = 0; i < DEVICES; i++) {
+        RakDeviceJoinEngine engine (config, EU868);
+        const interval_t start = engine.begin ();
+        TEST_ASSERT_LESS_THAN_UINT32 (config.startJitter, start);
+        starts [start * BUCKETS / config.startJitter]++;
+        engine.attempt ();
+        const interval_t backoff = engine.failure (Failure::RX_TIMEOUT) - config.backoffMinimum / 2;    // [0, half] above the floor
+        TEST_ASSERT_LESS_OR_EQUAL_UINT32 (config.backoffMinimum / 2, backoff);
+        backoffs [std::min<interval_t> (backoff * BUCKETS / (config.backoffMinimum / 2), BUCKETS - 1)]++;
+    }
+    for (int b = 0; b < BUCKETS; b++) {    // uniform would be 100 each
+        TEST_ASSERT_INT_WITHIN (40, DEVICES / BUCKETS, starts [b]);
+        TEST_ASSERT_INT_WITHIN (40, DEVICES / BUCKETS, backoffs [b]);
+    }
+}
+
+// -----------------------------------------------------------------------------------------------
+
+struct Sent {
+    interval_t time, airtime;
+};
+static void checkDutyCycle (const std::vector<Sent> &sent) {    // the aggregate budget of each phase, from the first attempt: 36 s in the first hour, 36 s in the next ten, 8.7 s in any 24 hours after
+    constexpr interval_t HOUR = RakDeviceJoinEngine::HOUR;
+    const interval_t started = sent.front ().time;
+    interval_t first = 0, second = 0;
+    for (const auto &s : sent) {
+        const interval_t since = s.time - started;
+        if (since < HOUR)
+            first += s.airtime;
+        else if (since < 11 * HOUR)
+            second += s.airtime;
+        else {
+            interval_t window = 0;
+            for (const auto &t : sent)
+                if (t.time - started >= 11 * HOUR && t.time <= s.time && s.time - t.time < 24 * HOUR)
+                    window += t.airtime;
+            TEST_ASSERT_LESS_OR_EQUAL_UINT32 (8700, window);
+        }
+    }
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32 (36000, first);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32 (36000, second);
+}
+static std::vector<Sent> failForever (RakDeviceJoinEngine &engine, const interval_t duration) {    // every attempt unanswered, until duration has passed
+    std::vector<Sent> sent;
+    delay (engine.begin ());
+    while (millis () < duration) {
+        engine.attempt ();
+        sent.push_back ({ millis (), EU868.timeOnAir (engine.dataRate (), RakDeviceJoinEngine::JOIN_REQUEST_SIZE) });
+        delay (engine.failure (Failure::RX_TIMEOUT));
+    }
+    return sent;
+}
+
+static void test_duty_cycle_budget () {    // walked down to SF12 within a few attempts, ~1.2 s each: budget limited, about 30 fit in the first hour
+    RakDeviceJoinEngine engine ({ .startJitter = 0, .backoffMinimum = 1000, .backoffMaximum = 2000, .attemptsPerDataRate = 1 }, EU868);
+    const auto sent = failForever (engine, 36 * RakDeviceJoinEngine::HOUR);
+    TEST_ASSERT_EQUAL_INT (EU868.uplinkMinimum, static_cast<int> (engine.dataRate ()));
+    TEST_ASSERT_GREATER_THAN_UINT32 (0, engine.stats ().dutyCycleDeferrals);
+    checkDutyCycle (sent);
+    char message [96];
+    snprintf (message, sizeof (message), "budget: %u attempts in 36 h, %lu deferred", static_cast<unsigned> (sent.size ()), engine.stats ().dutyCycleDeferrals);
+    TEST_MESSAGE (message);
+}
+
+static void test_duty_cycle_ledger () {    // SF7 requests at ~60 ms, short backoffs: more attempts fit the budget than the ledger holds, so the ledger refuses until its oldest ages out
+    RakDeviceJoinEngine engine ({ .startJitter = 0, .backoffMinimum = 100, .backoffMaximum = 200, .attemptsPerDataRate = 1000000 }, EU868);
+    const auto sent = failForever (engine, 36 * RakDeviceJoinEngine::HOUR);
+    TEST_ASSERT_GREATER_THAN_UINT32 (0, engine.stats ().dutyCycleDeferrals);
+    checkDutyCycle (sent);
+    size_t inFirstHour = 0;
+    for (const auto &s : sent)
+        inFirstHour += s.time - sent.front ().time < RakDeviceJoinEngine::HOUR ? 1 : 0;
+    TEST_ASSERT_EQUAL_UINT32 (RakDeviceJoinEngine::LEDGER_SIZE, inFirstHour);    // every one of them still counts within the hour
+}
+
+// -----------------------------------------------------------------------------------------------
+
+static void test_data_rate_walk () {
+    RakDeviceJoinEngine engine ({ .startJitter = 0, .backoffMinimum = 1000, .attemptsPerDataRate = 2, .dutyCycle = false }, EU868);
+    (void) engine.begin ();
+    TEST_ASSERT_EQUAL_INT (EU868.uplinkMaximum, static_cast<int> (engine.dataRate ()));
+    const auto fail = [&] (const Failure failure) {
+        engine.attempt ();
+        (void) engine.failure (failure);
+        return static_cast<int> (engine.dataRate ());
+    };
+    TEST_ASSERT_EQUAL_INT (5, fail (Failure::RX_TIMEOUT));
+    TEST_ASSERT_EQUAL_INT (4, fail (Failure::RX_TIMEOUT));    // two unanswered at DR5
+    TEST_ASSERT_EQUAL_INT (4, fail (Failure::UNRESOLVED));
+    TEST_ASSERT_EQUAL_INT (3, fail (Failure::UNRESOLVED));    // unresolved counts the same
+    const interval_t airtime = engine.stats ().airtime;
+    TEST_ASSERT_EQUAL_INT (3, fail (Failure::TX_TIMEOUT));    // nothing went out: no step, no airtime
+    TEST_ASSERT_EQUAL_INT (3, fail (Failure::TX_TIMEOUT));
+    TEST_ASSERT_EQUAL_UINT32 (airtime, engine.stats ().airtime);
+    TEST_ASSERT_EQUAL_INT (3, fail (Failure::ERROR));
+    TEST_ASSERT_EQUAL_INT (3, fail (Failure::ERROR));
+    for (int i = 0; i < 20; i++)
+        (void) fail (Failure::RX_TIMEOUT);
+    TEST_ASSERT_EQUAL_INT (EU868.uplinkMinimum, static_cast<int> (engine.dataRate ()));    // and no further
+    const auto &stats = engine.stats ();
+    TEST_ASSERT_EQUAL_UINT32 (22, stats.rxTimeouts);
+    TEST_ASSERT_EQUAL_UINT32 (2, stats.unresolved);
+    TEST_ASSERT_EQUAL_UINT32 (2, stats.txTimeouts);
+    TEST_ASSERT_EQUAL_UINT32 (2, stats.errors);
+    TEST_ASSERT_EQUAL_UINT32 (28, stats.attempts);
+
+    (void) engine.begin ();    // a session under way carries on where it was
+    TEST_ASSERT_EQUAL_INT (EU868.uplinkMinimum, static_cast<int> (engine.dataRate ()));
+    engine.attempt ();
+    delay (1000);
+    engine.success ();
+    TEST_ASSERT_FALSE (engine.active ());
+    TEST_ASSERT_EQUAL_UINT32 (1, engine.stats ().joins);
+    (void) engine.begin ();    // a new session starts again at the fastest
+    TEST_ASSERT_EQUAL_INT (EU868.uplinkMaximum, static_cast<int> (engine.dataRate ()));
+}
+
+static void test_failure_reasons () {
+    TEST_ASSERT_TRUE (RakDeviceJoinEngine::toFailure ("RX_TIMEOUT") == Failure::RX_TIMEOUT);
+    TEST_ASSERT_TRUE (RakDeviceJoinEngine::toFailure ("TX_TIMEOUT") == Failure::TX_TIMEOUT);
+    TEST_ASSERT_TRUE (RakDeviceJoinEngine::toFailure ("8") == Failure::ERROR);
+    TEST_ASSERT_TRUE (RakDeviceJoinEngine::toFailure ("") == Failure::ERROR);
+}
+
+// -----------------------------------------------------------------------------------------------
+
+static void test_manager_join_failed () {    // +EVT:JOIN_FAILED_RX_TIMEOUT from the module: a JOIN_FAILURE event, still pending, and the next request a data rate down
+    FakeModule module;
+    module.joinAccept = false;
+    RakDeviceManager::Config config = managerConfig ();
+    config.joinEngine = { .startJitter = 0, .backoffMinimum = 2000, .backoffMaximum = 4000, .attemptsPerDataRate = 1 };
+    RakDeviceManager manager (config, module);
+    std::vector<String> failures;
+    manager.addEventListener ([&] (const RakDeviceManager::Event event, const RakDeviceManager::EventArgs &args) {
+        if (event == RakDeviceManager::Event::JOIN_FAILURE)
+            failures.push_back (args [0]);
+    });
+    TEST_ASSERT_TRUE (manager.begin ());
+    const auto process = [&] { manager.process (); };
+    TEST_ASSERT_TRUE (runUntil ([&] { return manager.joinEngine ().stats ().rxTimeouts >= 2; }, 60 * 1000, process));
+    TEST_ASSERT_TRUE (manager.getState () == RakDeviceManager::State::JOIN_PENDING);
+    TEST_ASSERT_EQUAL_UINT32 (2, failures.size ());
+    TEST_ASSERT_EQUAL_STRING ("RX_TIMEOUT", failures [0].c_str ());
+    std::vector<int> dataRates;
+    for (const auto &r : module.received)
+        if (r.line.compare (0, 6, "AT+DR=") == 0)
+            dataRates.push_back (std::stoi (r.line.substr (6)));
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32 (2, dataRates.size ());
+    TEST_ASSERT_EQUAL_INT (dataRates [dataRates.size () - 2] - 1, dataRates.back ());
+
+    module.joinAccept = true;    // and once accepted
+    TEST_ASSERT_TRUE (runUntil ([&] { return manager.getState () == RakDeviceManager::State::JOIN_SUCCESS; }, 60 * 1000, process));
+    TEST_ASSERT_EQUAL_UINT32 (1, manager.joinEngine ().stats ().joins);
+}
+
+// -----------------------------------------------------------------------------------------------
+
+// A fleet powering up together, e.g. after a mains outage: each device joins through its own
+// engine; requests that overlap in time on the same channel at the same spreading factor collide,
+// and a device out of reach at the faster data rates must walk down to be heard. Lockstep is the
+// baseline without start jitter or backoff jitter, as fixed retry intervals have it.
+
+struct FleetResult {
+    float median, p90;
+    size_t joined;
+};
+static FleetResult fleet (const bool jitter) {
+    constexpr int DEVICES = 100, CHANNELS = 3;
+    constexpr interval_t LIMIT = 4 * RakDeviceJoinEngine::HOUR, ANSWER = 6000, LOCKSTEP = 10 * 1000;    // JOIN_ACCEPT_DELAY2 and after, as the module reports it
+    const RakDeviceJoinEngine::Config config { .startJitter = jitter ? 5000UL : 0UL, .backoffMinimum = 10 * 1000, .backoffMaximum = 10 * 60 * 1000, .attemptsPerDataRate = 2 };
+    struct Device {
+        RakDeviceJoinEngine engine;
+        int reach;    // the fastest data rate the gateway hears
+        interval_t next = 0;
+        bool waiting = false, joined = false;
+    };
+    struct Request {
+        int device, channel, dataRate;
+        interval_t start, end;
+    };
+    std::vector<Device> devices;
+    devices.reserve (DEVICES);
+    for (int i = 0; i < DEVICES; i++)
+        devices.push_back ({ RakDeviceJoinEngine (config, EU868), static_cast<int> (random (EU868.uplinkMaximum + 1)) });
+    for (auto &device : devices)
+        device.next = jitter ? device.engine.begin () : (device.engine.begin (), 0);
+    std::vector<Request> air;    // in time order, each decided ANSWER after it started, by which time all that overlapped it have started
+    size_t decided = 0;
+    std::vector<float> times;
+    while (times.size () < devices.size ()) {
+        interval_t now = decided < air.size () ? air [decided].start + ANSWER : LIMIT;
+        int starting = -1;
+        for (int i = 0; i < DEVICES; i++)
+            if (! devices [i].joined && ! devices [i].waiting && devices [i].next < now)
+                now = devices [i].next, starting = i;
+        if (now >= LIMIT)
+            break;
+        host::clock = static_cast<uint64_t> (now) * 1000;
+        if (starting >= 0) {
+            auto &device = devices [starting];
+            air.push_back ({ starting, static_cast<int> (random (CHANNELS)), static_cast<int> (device.engine.dataRate ()), now, now + EU868.timeOnAir (device.engine.dataRate (), RakDeviceJoinEngine::JOIN_REQUEST_SIZE) });
+            device.engine.attempt ();
+            device.waiting = true;
+            continue;
+        }
+        const Request &request = air [decided++];
+        bool collided = false;
+        for (size_t j = 0; j < air.size () && ! collided; j++)
+            collided = j != decided - 1 && air [j].channel == request.channel && air [j].dataRate == request.dataRate && air [j].start < request.end && request.start < air [j].end;
+        auto &device = devices [request.device];
+        device.waiting = false;
+        if (! collided && request.dataRate <= device.reach) {
+            device.engine.success ();
+            device.joined = true;
+            times.push_back (static_cast<float> (now));
+        } else {
+            const interval_t wait = device.engine.failure (Failure::RX_TIMEOUT);
+            device.next = now + (jitter ? wait : LOCKSTEP);
+        }
+    }
+    std::sort (times.begin (), times.end ());
+    const auto at = [&] (const float q) { return times.empty () ? 0.0f : times [std::min (times.size () - 1, static_cast<size_t> (q * times.size ()))]; };
+    return { at (0.5f), at (0.9f), times.size () };
+}
+
+static void test_fleet () {
+    const FleetResult jittered = fleet (true), lockstep = fleet (false);
+    char message [160];
+    snprintf (message, sizeof (message), "fleet of 100: joined %u, median %.0f s, p90 %.0f s (lockstep: joined %u, median %.0f s, p90 %.0f s)", static_cast<unsigned> (jittered.joined), jittered.median / 1000, jittered.p90 / 1000, static_cast<unsigned> (lockstep.joined), lockstep.median / 1000, lockstep.p90 / 1000);
+    TEST_MESSAGE (message);
+    TEST_ASSERT_EQUAL_UINT32 (100, jittered.joined);
+    TEST_ASSERT_TRUE (jittered.p90 < lockstep.p90 || lockstep.joined < jittered.joined);
+}
+
+// -----------------------------------------------------------------------------------------------
+
+int main () {
+    UNITY_BEGIN ();
+    RUN_TEST (test_backoff_bounds);
+    RUN_TEST (test_backoff_overflow);
+    RUN_TEST (test_jitter_spread);
+    RUN_TEST (test_duty_cycle_budget);
+    RUN_TEST (test_duty_cycle_ledger);
+    RUN_TEST (test_data_rate_walk);
+    RUN_TEST (test_failure_reasons);
+    RUN_TEST (test_manager_join_failed);
+    RUN_TEST (test_fleet);
+    return UNITY_END ();
+}
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
@@ -0,0 +1,122 @@
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
+
+// The P2P pipeline against FakeModule: receive stopped for each PSEND and re-armed after TXP2P DONE,
+// the messenger's next packet going out ahead of the re-arm, and a peer at irregular intervals whose
+// packets are heard only while the module is receiving, one arriving as receive is stopped. Checked
+// that no PSEND meets a module still receiving, and measured for packets and bytes per second each
+// way and the turnaround back to receiving.
+
+#include <unity.h>
+
+#include "FakeModule.hpp"
+
+void setUp () {
+    host::clock = 0;
+    randomSeed (32);
+}
+void tearDown () { }
+
+// -----------------------------------------------------------------------------------------------
+
+struct P2P {
+    FakeModule module;
+    RakDeviceManager manager;
+    RakDeviceMessenger messenger;
+    size_t heard = 0, missed = 0;    // the peer's packets, by whether the module was receiving when each arrived
+
+    static RakDeviceManager::Config config () {
+        RakDeviceManager::Config config = managerConfig ();
+        config.loraOperation.mode = Lora::Mode::MODE_P2PLORA;
+        return config;
+    }
+    P2P () :
+        manager (config (), module),
+        messenger (manager) {
+        TEST_ASSERT_TRUE (manager.begin ());
+        TEST_ASSERT_TRUE (manager.getState () == RakDeviceManager::State::P2P_READY);
+        TEST_ASSERT_TRUE (module.p2pReceiving);
+    }
+    void process () {
+        manager.process ();
+        RakDeviceManager::Downlink downlink;
+        while (manager.receive (downlink))
+            manager.release (downlink);
+    }
+    void peer (const size_t length) {    // a packet from the other end, heard only if receiving, which it ends
+        if (! module.p2pReceiving) {
+            missed++;
+            return;
+        }
+        module.p2pReceiving = false;
+        module.emit ("+EVT:RXP2P:-60:7:" + std::string (length * 2, 'A'));
+        heard++;
+    }
+    void report (const char *name, const interval_t elapsed) {
+        const auto &p2p = manager.status ().p2p;
+        char message [256];
+        snprintf (message, sizeof (message), "%s: %lu sent, %.1f packets/s, %.0f bytes/s; %lu received of %zu, %zu missed, %.0f bytes/s; airtime %lu ms, turnaround %lu ms mean, %lu ms maximum (%lu)",
+                  name, p2p.transmits, p2p.transmits * 1000.0f / elapsed, p2p.bytesTransmitted * 1000.0f / elapsed, p2p.receives, heard + missed, missed, p2p.bytesReceived * 1000.0f / elapsed,
+                  p2p.transmits > 0 ? p2p.airtimeTotal / p2p.transmits : 0, p2p.turnarounds > 0 ? p2p.turnaroundTotal / p2p.turnarounds : 0, p2p.turnaroundMaximum, p2p.turnarounds);
+        TEST_MESSAGE (message);
+    }
+};
+
+// -----------------------------------------------------------------------------------------------
+
+static void test_burst () {    // a queue of packets sent back to back: each after the last's TXP2P DONE, receive re-armed once at the end
+    P2P device;
+    constexpr int PACKETS = 20;
+    for (int packet = 0; packet < PACKETS; packet++)
+        TEST_ASSERT_TRUE (device.messenger.try_transmit ({ 1, String ("packet ") + String (packet) + " of the burst", false, millis () }));
+    const interval_t started = millis ();
+    TEST_ASSERT_TRUE (runUntil ([&] { return device.messenger.transmit_queue_size () == 0 && device.module.p2pReceiving; }, 60 * 1000, [&] { device.process (); }, 1));
+    const interval_t elapsed = millis () - started;
+    const auto &p2p = device.manager.status ().p2p;
+    TEST_ASSERT_EQUAL_UINT32 (0, device.module.busy);
+    TEST_ASSERT_EQUAL_UINT32 (PACKETS, p2p.transmits);
+    TEST_ASSERT_EQUAL_UINT32 (PACKETS, device.messenger.stats ().transmitsSucceeded);
+    TEST_ASSERT_EQUAL_UINT32 (PACKETS, device.module.count ("AT+PSEND="));
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32 (PACKETS, p2p.turnarounds);    // the next packet went ahead of the re-arm
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32 (1, p2p.turnarounds);
+    TEST_ASSERT_LESS_THAN_UINT32 (PACKETS * device.module.p2pAirtime * 2, elapsed);    // mostly airtime: the exchanges around each PSEND are the rest
+    device.report ("burst", elapsed);
+}
+
+static void test_duplex () {    // sending every half second while the peer sends every 100 to 250 ms: what it hears is received, and nothing sent meets a receive
+    P2P device;
+    constexpr interval_t DURATION = 60 * 1000, SEND = 500;
+    interval_t sent = 0, peered = 0, gap = 0;
+    int packets = 0;
+    const interval_t started = millis ();
+    runFor (DURATION, [&] {
+        if (millis () - sent >= SEND && device.messenger.try_transmit ({ 1, String ("status ") + String (packets), false, millis () }))
+            sent = millis (), packets++;
+        if (millis () - peered >= gap)
+            device.peer (24), peered = millis (), gap = random (100, 250);
+        device.process ();
+    }, 1);
+    runFor (1000, [&] { device.process (); }, 1);
+    const interval_t elapsed = millis () - started;
+    const auto &p2p = device.manager.status ().p2p;
+    TEST_ASSERT_EQUAL_UINT32 (0, device.module.busy);
+    TEST_ASSERT_EQUAL_UINT32 (packets, p2p.transmits);
+    TEST_ASSERT_EQUAL_UINT32 (device.heard, p2p.receives);
+    TEST_ASSERT_EQUAL_size_t (device.heard * 24, p2p.bytesReceived);
+    TEST_ASSERT_GREATER_THAN_UINT32 (device.missed, device.heard);    // receiving most of the time
+    TEST_ASSERT_EQUAL_UINT32 (p2p.transmits, p2p.turnarounds);    // spaced out: every send re-armed before the next
+    TEST_ASSERT_TRUE (device.module.p2pReceiving);
+    device.report ("duplex", elapsed);
+}
+
+// -----------------------------------------------------------------------------------------------
+
+int main () {
+    UNITY_BEGIN ();
+    RUN_TEST (test_burst);
+    RUN_TEST (test_duplex);
+    return UNITY_END ();
+}
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
@@ -0,0 +1,123 @@
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
+
+// RakDeviceTransceiver's line throughput, in wall clock nanoseconds per received line, over an
+// in-memory stream that has every line ready: the byte at a time reading it replaced (available,
+// read and a peek at each terminator, all through Stream), the chunked reading through Stream, and
+// the same with the stream's own type, as the example's RakDeviceManagerT<HardwareSerial> has it.
+
+#include <unity.h>
+
+#include "FakeModule.hpp"
+
+#include <chrono>
+
+void setUp () {
+    host::clock = 0;
+}
+void tearDown () { }
+
+// -----------------------------------------------------------------------------------------------
+
+class LineStream final : public Stream {    // what was written, read back
+    std::string _data;
+    size_t _position = 0;
+
+public:
+    void load (const std::string &data) { _data = data, _position = 0; }
+    int available () override { return static_cast<int> (_data.size () - _position); }
+    int read () override { return _position < _data.size () ? static_cast<unsigned char> (_data [_position++]) : -1; }
+    int peek () override { return _position < _data.size () ? static_cast<unsigned char> (_data [_position]) : -1; }
+    size_t readBytes (uint8_t *buffer, size_t length) override {
+        length = std::min (length, _data.size () - _position);
+        memcpy (buffer, _data.data () + _position, length);
+        _position += length;
+        return length;
+    }
+    size_t write (const uint8_t c) override { return _data.push_back (static_cast<char> (c)), 1; }
+    using Print::write;
+};
+
+static constexpr size_t LINES = 100000;
+static const char *const RESPONSES [] = { "OK", "AT+DR=5", "+EVT:TX_DONE", "+EVT:RX_1:-70:8:UNICAST:1:48656C6C6F", "AT+LTIME=04h36m00s on 11/27/2023", "+EVT:SEND_CONFIRMED_OK" };
+
+static std::string lines () {
+    std::string data;
+    for (size_t i = 0; i < LINES; i++)
+        data += std::string (RESPONSES [i % std::size (RESPONSES)]) + "\r\n";
+    return data;
+}
+
+static String readLinePerByte (Stream &stream) {    // as the transceiver read before it was chunked
+    String buffer;
+    if (stream.available ()) {
+        int r = -1;
+        do {
+            if ((r = stream.read ()) >= 0 && r != '\r' && r != '\n')
+                buffer += static_cast<char> (r);
+        } while (! (r == '\r' || r == '\n' || r < 0));
+        while ((r = stream.peek ()) >= 0 && (r == '\r' || r == '\n'))
+            (void) stream.read ();
+        buffer.trim ();
+    }
+    return buffer;
+}
+
+template <typename Read>
+static double measure (LineStream &stream, const char *name, Read &&read) {    // ns per line, every line checked
+    const std::string data = lines ();
+    double best = 0;
+    for (int round = 0; round < 5; round++) {    // the best of a few, against the host's noise
+        stream.load (data);
+        size_t received = 0, matched = 0;
+        const auto started = std::chrono::steady_clock::now ();
+        for (String line; ! (line = read ()).isEmpty (); received++)
+            if (line == RESPONSES [received % std::size (RESPONSES)])
+                matched++;
+        const double elapsed = std::chrono::duration<double, std::nano> (std::chrono::steady_clock::now () - started).count () / LINES;
+        TEST_ASSERT_EQUAL_size_t (LINES, received);
+        TEST_ASSERT_EQUAL_size_t (LINES, matched);
+        best = round == 0 ? elapsed : std::min (best, elapsed);
+    }
+    char message [96];
+    snprintf (message, sizeof (message), "%s: %.0f ns/line", name, best);
+    TEST_MESSAGE (message);
+    return best;
+}
+
+// -----------------------------------------------------------------------------------------------
+
+static void test_line_throughput () {
+    LineStream stream;
+    Stream *volatile opaque = &stream;    // so that nothing sees through to the type behind Stream
+    const double perByte = measure (stream, "per byte, Stream", [&] { return readLinePerByte (*opaque); });
+    RakDeviceTransceiverT<Stream> virtualised (*opaque);
+    const double chunked = measure (stream, "chunked, Stream", [&] { return virtualised.readLine (); });
+    RakDeviceTransceiverT<LineStream> direct (stream);
+    const double devirtualised = measure (stream, "chunked, LineStream", [&] { return direct.readLine (); });
+    TEST_ASSERT_LESS_THAN_FLOAT (perByte, chunked);
+    TEST_ASSERT_LESS_THAN_FLOAT (perByte, devirtualised);
+}
+
+static void test_lines_across_chunks () {    // lines longer than a chunk, and terminators split across two: read whole either way
+    LineStream stream;
+    const std::string longer (150, 'A');
+    stream.load ("+EVT:RX_1:" + longer + "\r\nOK\r\n\r\nAT+DR=5\r");
+    RakDeviceTransceiverT<LineStream> transceiver (stream);
+    TEST_ASSERT_EQUAL_STRING (("+EVT:RX_1:" + longer).c_str (), transceiver.readLine ().c_str ());
+    TEST_ASSERT_EQUAL_STRING ("OK", transceiver.readLine ().c_str ());
+    TEST_ASSERT_EQUAL_STRING ("AT+DR=5", transceiver.readLine ().c_str ());
+    TEST_ASSERT_FALSE (transceiver.available ());
+}
+
+// -----------------------------------------------------------------------------------------------
+
+int main () {
+    UNITY_BEGIN ();
+    RUN_TEST (test_line_throughput);
+    RUN_TEST (test_lines_across_chunks);
+    return UNITY_END ();
+}
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
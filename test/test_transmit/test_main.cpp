@@ -0,0 +1,89 @@
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
+
+// An awaited transmit against FakeModule, while the messenger's timer runs inside the wait and
+// sends uplinks of its own: the caller is told the outcome of its own uplink, or SUPERSEDED when
+// the module stopped reporting on it, never the outcome of another.
+
+#include <unity.h>
+
+#include "FakeModule.hpp"
+
+void setUp () {
+    host::clock = 0;
+    randomSeed (45);
+}
+void tearDown () { }
+
+// -----------------------------------------------------------------------------------------------
+
+using Confirmation = RakDeviceManager::Confirmation;
+
+struct Joined {
+    FakeModule module;
+    RakDeviceManager manager;
+    RakDeviceMessenger messenger;
+
+    static RakDeviceManager::Config config () {
+        RakDeviceManager::Config config = managerConfig ();
+        config.loraParameters.confirmMode = true;
+        config.joinEngine.startJitter = 0;
+        return config;
+    }
+    Joined () :
+        manager (config (), module),
+        messenger (manager) {
+        TEST_ASSERT_TRUE (manager.begin ());
+        TEST_ASSERT_TRUE (runUntil ([this] { return manager.getState () == RakDeviceManager::State::JOIN_SUCCESS; }, 60 * 1000, [this] { manager.process (); }));
+    }
+};
+
+// -----------------------------------------------------------------------------------------------
+
+static void test_awaited () {    // nothing else sending: the uplink's own confirmation
+    Joined device;
+    TEST_ASSERT_TRUE (device.manager.transmit (1, "first", true));
+    TEST_ASSERT_TRUE (device.manager.uplink ().confirmation == Confirmation::CONFIRMED);
+    device.module.confirmAccept = false;
+    TEST_ASSERT_FALSE (device.manager.transmit (1, "second", true));
+    TEST_ASSERT_TRUE (device.manager.confirmationOf (device.manager.uplink ().sequence) == Confirmation::FAILED);
+}
+
+static void test_resolved_then_superseded () {    // confirmed, and in the same process () the messenger sends, which then fails: still the caller's CONFIRMED
+    Joined device;
+    device.manager.addEventListener ([&] (const RakDeviceManager::Event event, const RakDeviceManager::EventArgs &) {
+        if (event == RakDeviceManager::Event::TRANSMIT_SUCCESS && device.messenger.stats ().transmitsAttempted == 0) {
+            device.module.confirmAccept = false;
+            TEST_ASSERT_TRUE (device.messenger.try_transmit ({ 2, "other", true, millis () }));
+        }
+    });
+    TEST_ASSERT_TRUE (device.manager.transmit (1, "mine", true));
+    const counter_t mine = device.manager.uplink ().sequence - 1;
+    TEST_ASSERT_EQUAL_UINT32 (1, device.messenger.stats ().transmitsAttempted);
+    TEST_ASSERT_TRUE (device.manager.confirmationOf (mine) == Confirmation::CONFIRMED);
+    TEST_ASSERT_EQUAL_UINT32 (0, device.manager.status ().confirmations.superseded);
+}
+
+static void test_superseded_while_pending () {    // the messenger sends before the caller's uplink resolves: SUPERSEDED, not the messenger's outcome
+    Joined device;
+    TEST_ASSERT_TRUE (device.messenger.try_transmit ({ 2, "other", true, millis () }));    // due at once, so sent from within the wait
+    TEST_ASSERT_FALSE (device.manager.transmit (1, "mine", true));
+    const counter_t mine = device.manager.uplink ().sequence - 1;
+    TEST_ASSERT_TRUE (device.manager.confirmationOf (mine) == Confirmation::SUPERSEDED);
+    TEST_ASSERT_EQUAL_UINT32 (1, device.manager.status ().confirmations.superseded);
+    TEST_ASSERT_TRUE (device.manager.confirmationWait (mine, 1000) == Confirmation::SUPERSEDED);    // at once, however long it is allowed
+    TEST_ASSERT_TRUE (device.manager.confirmationWait (device.manager.uplink ().sequence, 30 * 1000) == Confirmation::CONFIRMED);    // the messenger's, its own
+}
+
+// -----------------------------------------------------------------------------------------------
+
+int main () {
+    UNITY_BEGIN ();
+    RUN_TEST (test_awaited);
+    RUN_TEST (test_resolved_then_superseded);
+    RUN_TEST (test_superseded_while_pending);
+    return UNITY_END ();
+}
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------